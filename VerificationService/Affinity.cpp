@@ -0,0 +1,267 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Affinity.cpp
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+#include "Affinity.h"
+
+namespace Affinity {
+
+namespace filesystem = std::experimental::filesystem;
+
+CoreSet::CoreSet() : numaNode(-1), owned(true) {
+  CPU_ZERO(&mask);
+}
+
+CoreSet::CoreSet(CpuIDs&& cpus, int numaNode, bool owned) : cpus(std::move(cpus)), numaNode(numaNode), owned(owned) {
+  CPU_ZERO(&mask);
+  for (Nat cpu : this->cpus)
+    CPU_SET(cpu, &mask);
+}
+
+CoreSet::CoreSet(CoreSet&& other) noexcept : CoreSet() {
+  *this = std::move(other);
+}
+
+CoreSet& CoreSet::operator=(CoreSet&& other) noexcept {
+  release();
+  cpus = std::move(other.cpus);
+  other.cpus.clear();
+  numaNode = other.numaNode;
+  owned = other.owned;
+  mask = other.mask;
+  return *this;
+}
+
+CoreSet::~CoreSet() {
+  release();
+}
+
+void CoreSet::release() {
+  if (cpus.empty())
+    return;
+  if (owned)
+    CoreAllocator::instance().release(cpus);
+  cpus.clear();
+  CPU_ZERO(&mask);
+}
+
+String CoreSet::to_string() const {
+  String result;
+  bbb::vector_print(cpus, ",", result, [] (Nat cpu) { return std::to_string(cpu); });
+  if (numaNode >= 0)
+    result += " (NUMA node " + std::to_string(numaNode) + ")";
+  return result;
+}
+
+void CoreSet::apply() const {
+  if (cpus.empty())
+    return;
+  sched_setaffinity(0, sizeof(mask), &mask);
+  if (numaNode >= 0 && numaNode < static_cast<int>(8 * sizeof(unsigned long))) {
+    unsigned long nodeMask = 1UL << numaNode;
+    syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodeMask, 8 * sizeof(nodeMask)); // Fails harmlessly without NUMA support
+  }
+}
+
+void CoreSet::apply_to(pid_t pid) const {
+  if (!cpus.empty())
+    sched_setaffinity(pid, sizeof(mask), &mask);
+}
+
+/// Processes of the group are found by the process group ID (field 5 of /proc/[pid]/stat)
+void CoreSet::apply_to_group(pid_t group) const {
+  if (cpus.empty())
+    return;
+  std::error_code error;
+  for (const auto& entry : filesystem::directory_iterator("/proc", error)) {
+    const String name = entry.path().filename().string();
+    if (name.empty() || !isdigit(name[0]))
+      continue;
+    Strings lines;
+    if (!bbb::read_file(entry.path().string() + "/stat", lines) || lines.empty())
+      continue;
+    size_t end = lines[0].rfind(')');
+    int pgrp = 0;
+    if (end == String::npos || sscanf(lines[0].c_str() + end + 1, " %*c %*d %d", &pgrp) != 1 || pgrp != group)
+      continue;
+    std::error_code taskError;
+    for (const auto& task : filesystem::directory_iterator(entry.path() / "task", taskError))
+      sched_setaffinity(std::atoi(task.path().filename().c_str()), sizeof(mask), &mask);
+  }
+}
+
+
+CoreAllocator& CoreAllocator::instance() {
+  static CoreAllocator allocator;
+  return allocator;
+}
+
+CoreAllocator::CoreAllocator() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    for (Nat cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+      CPU_SET(cpu, &allowed);
+  }
+
+  try {
+    for (const auto& entry : filesystem::directory_iterator("/sys/devices/system/node")) {
+      String name = entry.path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || !isdigit(name[4]))
+        continue;
+      String cpuList;
+      if (!bbb::read_file((entry.path() / "cpulist").string(), cpuList))
+        continue;
+      NumaNode node{std::atoi(name.c_str() + 4), {}, {}};
+      for (Nat cpu : parse_cpu_list(cpuList))
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+          node.cpus.insert(cpu);
+      node.free = node.cpus;
+      if (!node.cpus.empty())
+        nodes.push_back(std::move(node));
+    }
+  }
+  catch (const filesystem::filesystem_error& e) {
+    DEB("NUMA topology not available: " << e.what());
+  }
+
+  if (nodes.empty()) { // No NUMA information, treat the machine as a single node
+    NumaNode node{-1, {}, {}};
+    for (Nat cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowed))
+        node.cpus.insert(cpu);
+    node.free = node.cpus;
+    nodes.push_back(std::move(node));
+  }
+  std::sort(nodes.begin(), nodes.end(), [] (const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+  DEB("CPU topology: " << nodes.size() << " NUMA node(s), " << size() << " core(s)");
+}
+
+/// Parses lists as in /sys/devices/system/node/node0/cpulist, e.g. "0-3,8-11"
+CpuIDs CoreAllocator::parse_cpu_list(const String& list) {
+  CpuIDs result;
+  Strings ranges;
+  bbb::split_by(list, ranges, ",");
+  for (const String& range : ranges) {
+    char* end;
+    Nat first = std::strtoul(range.c_str(), &end, 10);
+    if (end == range.c_str())
+      continue;
+    Nat last = (*end == '-' ? std::strtoul(end + 1, nullptr, 10) : first);
+    for (Nat cpu = first; cpu <= last; cpu++)
+      result.push_back(cpu);
+  }
+  return result;
+}
+
+void CoreAllocator::reserve_for_server(Nat count) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (count == 0 || !serverCpus.empty())
+    return;
+  cpu_set_t serverMask;
+  CPU_ZERO(&serverMask);
+  for (NumaNode& node : nodes) { // The lowest cores, usually the ones interrupts are routed to
+    while (count > 0 && !node.free.empty() && size_nomutex() > 1) {
+      Nat cpu = *node.free.begin();
+      node.free.erase(node.free.begin());
+      node.cpus.erase(cpu);
+      serverCpus.push_back(cpu);
+      CPU_SET(cpu, &serverMask);
+      count--;
+    }
+  }
+  if (serverCpus.empty())
+    return;
+  sched_setaffinity(0, sizeof(serverMask), &serverMask);
+  String cpus;
+  bbb::vector_print(serverCpus, ",", cpus, [] (Nat cpu) { return std::to_string(cpu); });
+  DEB("Server threads bound to cores " << cpus);
+}
+
+CoreSet CoreAllocator::allocate(Nat count) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  count = std::max<Nat>(1, std::min(count, size_nomutex())); // A run demanding more than the machine gets all of it
+
+  // Best fit within a single NUMA node:
+  NumaNode* best = nullptr;
+  for (NumaNode& node : nodes)
+    if (node.free.size() >= count && (!best || node.free.size() < best->free.size()))
+      best = &node;
+
+  CpuIDs cpus;
+  if (best) {
+    auto it = best->free.begin();
+    for (Nat i = 0; i < count; i++)
+      cpus.push_back(*it++);
+    best->free.erase(best->free.begin(), it);
+    return CoreSet(std::move(cpus), best->id);
+  }
+
+  // Span several nodes, emptiest nodes first:
+  Nat freeCores = 0;
+  for (const NumaNode& node : nodes)
+    freeCores += node.free.size();
+  if (freeCores < count)
+    return CoreSet();
+  std::vector<NumaNode*> order;
+  for (NumaNode& node : nodes)
+    order.push_back(&node);
+  std::sort(order.begin(), order.end(), [] (NumaNode* a, NumaNode* b) { return a->free.size() > b->free.size(); });
+  for (NumaNode* node : order) {
+    while (cpus.size() < count && !node->free.empty()) {
+      cpus.push_back(*node->free.begin());
+      node->free.erase(node->free.begin());
+    }
+  }
+  return CoreSet(std::move(cpus), -1);
+}
+
+void CoreAllocator::release(const CpuIDs& cpus) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  for (Nat cpu : cpus)
+    for (NumaNode& node : nodes)
+      if (node.cpus.count(cpu))
+        node.free.insert(cpu);
+}
+
+Nat CoreAllocator::size() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return size_nomutex();
+}
+
+Nat CoreAllocator::size_nomutex() const {
+  Nat result = 0;
+  for (const NumaNode& node : nodes)
+    result += node.cpus.size();
+  return result;
+}
+
+Nat CoreAllocator::free() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  Nat result = 0;
+  for (const NumaNode& node : nodes)
+    result += node.free.size();
+  return result;
+}
+
+}
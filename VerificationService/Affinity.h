@@ -0,0 +1,141 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Affinity.h
+ */
+
+#pragma once
+
+#include <mutex>
+#include <sched.h>
+#include <set>
+#include <sys/types.h>
+#include <vector>
+
+#include "bbb.h"
+
+namespace Affinity {
+
+using namespace Basics;
+
+using CpuIDs = std::vector<Nat>;
+
+/**
+ * CPU cores granted to a single run. The cores are returned to the CoreAllocator on destruction.
+ */
+class CoreSet {
+public:
+  CoreSet();
+  /**
+   * @param owned Whether the cores come from this process's CoreAllocator and are returned to it;
+   *              false for cores allocated by another process (the zygote gets them from the server)
+   */
+  CoreSet(CpuIDs&& cpus, int numaNode, bool owned = true);
+  CoreSet(const CoreSet& other) = delete;
+  CoreSet(CoreSet&& other) noexcept;
+  CoreSet& operator=(const CoreSet& other) = delete;
+  CoreSet& operator=(CoreSet&& other) noexcept;
+  virtual ~CoreSet();
+
+  bool empty() const { return cpus.empty(); }
+  Nat size() const { return cpus.size(); }
+  const CpuIDs& get_cpus() const { return cpus; }
+  int get_numa_node() const { return numaNode; }
+  String to_string() const;
+
+  /**
+   * Binds the calling process to the cores and prefers memory of their NUMA node.
+   * Only performs system calls, so it is safe to call between fork and exec.
+   * Does nothing for an empty set.
+   */
+  void apply() const;
+
+  /**
+   * Binds another process (its main thread) to the cores, e.g. a session process serving the run.
+   * The memory policy of another process cannot be changed.
+   */
+  void apply_to(pid_t pid) const;
+
+  /**
+   * Binds all threads of all processes of the process group to the cores, e.g. a run moved to other cores.
+   */
+  void apply_to_group(pid_t group) const;
+
+  /**
+   * Returns the cores to the allocator. Safe to call repeatedly.
+   */
+  void release();
+
+private:
+  CpuIDs cpus;
+  int numaNode; // -1 if the cores span several NUMA nodes
+  bool owned;
+  cpu_set_t mask;
+};
+
+/**
+ * Process-wide assignment of disjoint sets of CPU cores to runs.
+ *
+ * The topology is read from /sys/devices/system/node and restricted to the cores the server was started with
+ * (so that cpusets of containers are respected). A run gets all its cores from a single NUMA node whenever some node
+ * has enough free cores; the fullest such node is used to keep larger blocks free for bigger runs.
+ */
+class CoreAllocator {
+public:
+  static CoreAllocator& instance();
+
+  CoreAllocator(const CoreAllocator& other) = delete;
+  CoreAllocator& operator=(const CoreAllocator& other) = delete;
+
+  /**
+   * Keeps count cores for the server's own threads and binds the calling process to them.
+   * Must be called before the server starts its threads, they inherit the binding.
+   * At least one core is always left for the runs.
+   * @param count
+   */
+  void reserve_for_server(Nat count);
+
+  /**
+   * Takes count free cores.
+   * @return The cores, or an empty set if there are not enough free cores at the moment.
+   */
+  CoreSet allocate(Nat count);
+
+  /**
+   * @return Number of cores that can be given to runs
+   */
+  Nat size() const;
+
+  /**
+   * @return Number of cores not given to any run
+   */
+  Nat free() const;
+
+private:
+  friend class CoreSet;
+
+  struct NumaNode {
+    int id;
+    std::set<Nat> cpus; // Cores of the node available to runs
+    std::set<Nat> free;
+  };
+
+  CoreAllocator();
+  void release(const CpuIDs& cpus);
+  Nat size_nomutex() const;
+  static CpuIDs parse_cpu_list(const String& list);
+
+  mutable std::mutex mutex;
+  std::vector<NumaNode> nodes;
+  CpuIDs serverCpus;
+};
+
+}
@@ -60,6 +60,15 @@ void OSLCReporter::build_oslc_perf(const String& automationPlan, const std::stri
                xml.perf_item(localAddress, "Memory Usage (rss)", "pm:MemoryMetrics",
                            "http://open-services.net/ns/ems/unit#Bytes",
                            "http://www.w3.org/2001/XMLSchema#integer", rssNode),
+               xml.perf_item(localAddress, "Disk Usage (run)", "pm:StorageMetrics",
+                           "http://open-services.net/ns/ems/unit#Bytes",
+                           "http://www.w3.org/2001/XMLSchema#integer", diskNode),
+               xml.perf_item(localAddress, "Disk Usage (workspace)", "pm:StorageMetrics",
+                           "http://open-services.net/ns/ems/unit#Bytes",
+                           "http://www.w3.org/2001/XMLSchema#integer", workspaceDiskNode),
+               xml.perf_item(localAddress, "Expected Time Remaining", "pm:ResponseTimeMetrics",
+                           "http://open-services.net/ns/ems/unit#Second",
+                           "http://www.w3.org/2001/XMLSchema#integer", etaNode),
                xml.ii("oslc_auto", "AutomationResult",
                     {   xml.ip("rdf", "about", "http://example.org/autoresults/3456")
                     },
@@ -95,6 +104,9 @@ std::string OSLCReporter::getOSLC(const ReportInformation& info) {
   xml.subs[rssNode].value = xml.insert_token(info.rss);
   xml.subs[freeNode].value = xml.insert_token(info.memFree);
   xml.subs[percNode].value = xml.insert_token(info.memPerc);
+  xml.subs[diskNode].value = xml.insert_token(info.disk);
+  xml.subs[workspaceDiskNode].value = xml.insert_token(std::to_string(info.workspaceDisk));
+  xml.subs[etaNode].value = xml.insert_token(std::to_string(info.eta));
   xml.subs[stdOutNode].value = xml.insert_token(info.stdOut);
   xml.subs[errOutNode].value = xml.insert_token(info.errOut);
   xml.subs[verResultNode].value = xml.insert_token(info.verResult);
@@ -111,7 +123,7 @@ std::string OSLCReporter::getOSLC(const ReportInformation& info) {
 }
 
   
-Report::Report(ToolKit::Tool& t, const Strings& params,
+Report::Report(const ToolKit::SharedTool& t, const Strings& params,
                const std::vector<FileID>& inputs,
                const String& automationPlanName,
                const String& localAddress,
@@ -122,7 +134,11 @@ Report::Report(ToolKit::Tool& t, const Strings& params,
     automationPlanName(automationPlanName),
     oslcReporter(automationPlanName, localAddress),
     returnCode(-9999), // Dummy value for debugging
+    terminatedEarly(false),
+    suspendedTime(Dur::zero()),
     runningResult("Not started."),
+    running(false),
+    finalising(false),
     pid(-9999), // Dummy value for debugging
     valid(false) {
   assert(stdOutput.empty());
@@ -153,11 +169,17 @@ Report::Report(ToolKit::Tool& t, const Strings& params,
     partVerResult(other.partVerResult),
     returnCode(other.returnCode),
     parsedOutput(other.parsedOutput),
+    decidedBy(other.decidedBy),
+    terminatedEarly(other.terminatedEarly),
+    suspendedTime(other.suspendedTime),
+    outputFiles(other.outputFiles),
     stdOutput(other.stdOutput),
     errOutput(other.errOutput),
     runningResult(other.runningResult),
     resources(other.resources),
     running(other.running),
+    expectedEnd(other.expectedEnd),
+    finalising(other.finalising),
     pid(other.pid),
     lastMonitored(other.lastMonitored),
     valid(other.valid),
@@ -178,19 +200,25 @@ void Report::to_string(String& out) {
   out += "\nstOutput = " + stdOutput;
   out += "\nerOutput = " + errOutput;
   out += "\nrunningResult = " + runningResult;
+  if (!decidedBy.empty())
+    out += "\ndecidedBy = " + decidedBy;
+  if (terminatedEarly)
+    out += "\nterminatedEarly = true";
+  if (suspendedTime > Dur::zero())
+    out += "\nsuspendedTime = " + std::to_string(suspendedTime.count()) + " ms";
   out += "\npid = " + std::to_string(pid);
   out += "\nautomation_plan = " + automationPlanName;
   out += "\nparameters = " + std::accumulate(parameters.begin(), parameters.end(), std::string(","));
   out += "\ninputFiles = " + std::accumulate(inputFiles.begin(), inputFiles.end(), std::string(","), [] (std::string& s, FileID fid) -> std::string {return s + std::to_string(fid);});
   out += "\noutputNames = " + std::accumulate(outputNames.begin(), outputNames.end(), std::string(","));
-  tool.to_string(strTmp);
+  tool->to_string(strTmp);
   out += "\ntool :  " + strTmp;
   return;
 }
 
 void Report::write(std::iostream& f) {
   bbb::write_enclosed(f, subSize, '-', "ToolName");
-  f << "\n" + tool.get_name() + "\n";
+  f << "\n" + tool->get_name() + "\n";
   bbb::write_enclosed(f, subSize, '-', "Parameters");
   f << "\n";
   bbb::write_separated(f, parameters, "\n");
@@ -206,7 +234,7 @@ void Report::write(std::iostream& f) {
 }
 
 void Report::update_hash() {
-  id = tool.hash();
+  id = tool->hash();
   for (size_t i=0; i<inputFiles.size(); i++)
     id ^= hash_fn_fileID(inputFiles[i]) ^ hash_fn_size_t(i);
   for (size_t i=0; i<parameters.size(); i++)
@@ -223,7 +251,7 @@ bool Report::operator==(const Report& other) const {
     return false;
   if (parameters != other.parameters)
     return false;
-  if (tool.hash() != other.tool.hash())
+  if (tool->hash() != other.tool->hash())
     return false;
   if (automationPlanName != other.automationPlanName)
     return false;
@@ -242,11 +270,15 @@ bool Report::operator==(const Report& other) const {
     info.parsedOutput = parsedOutput;
     info.planName = automationPlanName;
     info.runningResult = runningResult;
+    if (running && expectedEnd != TimePoint()) // Past the expected end, the run is expected to end any moment
+      info.eta = std::max<long>(0, std::chrono::duration_cast<std::chrono::seconds>(expectedEnd - SClock::now()).count());
     return info;
   }
     
-  std::string Report::getMonitoringOSLC() {
-    return oslcReporter.getOSLC(getMonitoringInformation());
+  std::string Report::getMonitoringOSLC(uint64_t workspaceDisk) {
+    ReportInformation info = getMonitoringInformation();
+    info.workspaceDisk = workspaceDisk;
+    return oslcReporter.getOSLC(info);
   }
 
 
@@ -271,6 +303,7 @@ std::pair<bool, FileID> Archive::checkin_file(const String& content) {
   auto answer = fileStore.insert(hs);
   if (!answer.first)
     return answer;
+  fileDigests.push_back({content.size(), hs.hash()}); // IDs are given in order
   String path = filePath / formatArchivedFileName(answer.second);
   DEB("Storing the content into: " + path);
   std::ofstream s(path);
@@ -286,7 +319,36 @@ std::pair<bool, FileID> Archive::checkin_file(const String& content) {
     return "FILE_UNAVAILABLE";
   }
 
-  BorrowedReport Archive::borrow_report(ReportID id) {
+  FileDigest Archive::get_file_digest(FileID id) const {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    return (id < fileDigests.size() ? fileDigests[id] : FileDigest());
+  }
+
+  bool Archive::restore_report(ReportID id, const Report& report) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  Report lost(report); // Of no verification: never valid, nor taken for a run of the report's tool or inputs
+  lost.tool.reset();
+  lost.parameters.clear();
+  lost.inputFiles.clear();
+  lost.outputNames.clear();
+  lost.outputFiles.clear();
+  lost.automationPlanName.clear();
+  lost.callCommand.clear();
+  lost.parsedOutput.clear();
+  lost.partVerResult.clear();
+  lost.decidedBy.clear();
+  lost.stdOutput.clear();
+  lost.errOutput.clear();
+  lost.returnCode = -1;
+  lost.pid = -1;
+  lost.running = false;
+  lost.finalising = false;
+  lost.valid = false;
+  lost.runningResult = "Lost in a restart of the server.";
+  return reportStore.restore(id, report, lost);
+}
+
+BorrowedReport Archive::borrow_report(ReportID id) {
     std::unique_lock<decltype(mutex)> archiveLock(mutex);
     return {get_report_nomutex(id), std::move(archiveLock)};
   }
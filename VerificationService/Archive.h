@@ -49,6 +49,14 @@ struct m_hashable_string {
   }
 };
 
+/**
+ * Size and digest of the content of an archived file
+ */
+struct FileDigest {
+  uint64_t size = 0;
+  Hash digest = 0;
+};
+
 const uint8_t subSize = 10;
 const uint8_t secSize = 20;
 
@@ -63,6 +71,7 @@ struct ResourceInformation {
   std::string rss;
   std::string memFree;
   std::string memPerc;
+  std::string disk = "0"; // Bytes the run's outputs take (see Workspace::DiskAccount)
 };
 //CPU Usage user time (%) -- double precision
 //CPU Usage system time (%) -- double precision
@@ -85,6 +94,8 @@ struct ReportInformation : public ResourceInformation {
   std::string parsedOutput;
   std::string planName;
   std::string runningResult;
+  uint64_t workspaceDisk = 0; // Bytes the report's workspace takes
+  long eta = -1; // Seconds until the run is expected to end (see RunHistory), -1 if unknown
 };
 
 /**
@@ -116,7 +127,7 @@ private:
   
   XMLSupport::Xml xml;
   XMLSupport::Index pidNode, utimeNode, stimeNode, vsizeNode, rssNode,
-    bResultNode, freeNode, percNode;
+    bResultNode, freeNode, percNode, diskNode, workspaceDiskNode, etaNode;
   XMLSupport::Index stdOutNode, errOutNode, verResultNode, retCodeNode, parsedOutputNode;
 };
 
@@ -126,14 +137,14 @@ private:
  * updated during verification execution
  * and returned with a monitoring request
  *
- * It contains reference to the verification tool
- * to mark is as busy/free
+ * It shares the verification tool,
+ * which stays with the report if the toolkit is reloaded
  */
 class Report {
 public:
   //permanent
   mutable std::recursive_mutex mutex;
-  ToolKit::Tool& tool;
+  ToolKit::SharedTool tool;
   Strings parameters;
   std::vector<FileID> inputFiles;
   Strings outputNames;
@@ -149,6 +160,10 @@ public:
   String partVerResult;
   int returnCode;
   String parsedOutput;
+  String decidedBy; // Tool whose verdict decided a portfolio verification
+  bool terminatedEarly; // The tool was stopped once its output showed a definitive verdict
+  Dur suspendedTime;    // How long the run was suspended to lend its cores to interactive verifications
+  std::map<Nat, FileID> outputFiles; // Archived contents of the outputs the run wrote, by their index in outputNames
 
   //while running
   String stdOutput;
@@ -157,6 +172,8 @@ public:
   //Files outputFiles;
   Resources resources;
   bool running;
+  TimePoint expectedEnd; // Of the run, predicted when it started (see RunHistory); TimePoint() if unknown
+  bool finalising; // The process ended, the outputs are being parsed; the report becomes valid next
   int pid;
   TimePoint lastMonitored;
   bool valid;
@@ -176,12 +193,11 @@ public:
    * @param localAddress Local web address of the server
    * @param oCount Number of the tool's output files according to its schema
    */
-  Report(ToolKit::Tool& tool, const Strings& params,
+  Report(const ToolKit::SharedTool& tool, const Strings& params,
          const std::vector<FileID>& inputs,
          const String& automationPlanName,
          const String& localAddress,
          size_t oCount);
-  // TODO: Tool should be kept as a shared pointer. It is not safe to rely on the reference.
     
   Report(const Report& other);
   
@@ -195,11 +211,12 @@ public:
   bool operator==(const Report& other) const;
 
   ReportInformation getMonitoringInformation();
-  std::string getMonitoringOSLC();
+  std::string getMonitoringOSLC(uint64_t workspaceDisk);
   TimePoint getLastMonitored() {std::lock_guard<decltype(mutex)> lockGuard(mutex); return lastMonitored;}
   void updateLastMonitored() {std::lock_guard<decltype(mutex)> lockGuard(mutex); lastMonitored = SClock::now(); }
   void validate() {std::lock_guard<decltype(mutex)> lockGuard(mutex); valid = true; }
   bool is_valid() const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return valid; }
+  bool in_progress() const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return running || finalising; }
   
 private:
   Report(const Report& other, const std::lock_guard<decltype(mutex)>& lockGuardOther);
@@ -207,7 +224,8 @@ private:
 
 /**
  * This class allows user to safely "borrow" a report from the Archive with exclusive access to both Archive and the report.
- * BorrowedReport holds a lock to Archive's mutex and to the Report's mutex and can only exist on a stack.
+ * BorrowedReport holds a lock to Archive's mutex and to the Report's mutex (only the latter if borrowed
+ * through Archive::borrow) and can only exist on a stack.
  * This ensures that the borrowed Report will not get deallocated/moved in memory
  * while holding a pointer/reference to it.
  * * and -> operators are overloaded, so that report can be accessed easily.
@@ -255,6 +273,7 @@ public:
   filesystem::path reportPath;
 
   bbb::UHash<m_hashable_string> fileStore;
+  std::vector<FileDigest> fileDigests; // By FileID, computed once when the file is checked in
   filesystem::path filePath;
 
   Archive() {};
@@ -270,11 +289,36 @@ public:
   }
 
   BorrowedReport borrow_report(ReportID id);
+
+  /**
+   * Puts a report of an earlier server back under its ID, for a run taken over from it (see Zygote::held()).
+   * Reports are restored before any other is checked in, in ascending order of their IDs; the IDs in between
+   * were reports the restart lost, they are filled with ended, invalid reports of no tool and no inputs saying so.
+   * @return false if the ID is used already
+   */
+  bool restore_report(ReportID id, const Report& report);
+
+  /**
+   * Reports never move in memory once checked in, so a report can be kept by reference and borrowed
+   * with the report's lock alone (see borrow()). The archive is locked only for the lookup.
+   */
+  Report& get_report(ReportID id) {std::lock_guard<decltype(mutex)> lockGuard(mutex); return get_report_nomutex(id); }
+
+  /**
+   * Borrows a report without locking the archive, for frequent updates of a running report (monitoring).
+   * The archive must not be locked while holding such a borrow, the lock order is archive -> report.
+   */
+  static BorrowedReport borrow(Report& report) { return {report, std::unique_lock<std::recursive_mutex>()}; }
   bool has_report(ReportID id) const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return reportStore.has_id(id); }
 
   std::pair<bool, FileID> checkin_file(const String& content);
   bool has_file(FileID id) const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return fileStore.has_id(id);}
   std::string get_file_path(FileID id) const;
+
+  /**
+   * @return Size and digest of the file's content, zeros if there is no such file
+   */
+  FileDigest get_file_digest(FileID id) const;
 private:
   Report& get_report_nomutex(ReportID id) { return reportStore.decode_mod(id); }
   static std::string formatArchivedFileName(FileID id);
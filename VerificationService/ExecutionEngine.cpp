@@ -14,15 +14,93 @@
  * Author: Petr Bauch <petr.bauch at honeywell.com>
  */
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <functional>
 #include <iostream>
 
 #include "ExecutionEngine.h"
+#include "SolverPool.h"
 #include "Workspace.h"
+#include "Zygote.h"
 //#include "DataStore.h"
 
 namespace ExecutionEngine {
 
+namespace {
+
+const char recordSeparator = '\x1f';
+const String recordMark = "run1"; // First field of a run record, changes with the format
+
+}
+
+/// Fields end with the separator; lists are written as the number of items followed by the items
+String RunRecord::to_tag() const {
+  Strings fields = {recordMark, std::to_string(reportID), std::to_string(monitoredReportID), workspaceDirectory, workspaceTool,
+                    tool, tenant, directory, callCommand, automationPlanName, std::to_string(priority),
+                    std::to_string(timeLimit.count()),
+                    std::to_string(std::chrono::duration_cast<Dur>(startTime.time_since_epoch()).count())};
+  fields.push_back(std::to_string(parameters.size()));
+  fields.insert(fields.end(), parameters.begin(), parameters.end());
+  fields.push_back(std::to_string(inputFiles.size()));
+  for (Archive::FileID file : inputFiles)
+    fields.push_back(std::to_string(file));
+  fields.push_back(std::to_string(outputNames.size()));
+  fields.insert(fields.end(), outputNames.begin(), outputNames.end());
+  String tag;
+  for (const String& field : fields) {
+    for (char c : field)
+      tag += (c == '\n' || c == recordSeparator ? ' ' : c);
+    tag += recordSeparator;
+  }
+  return tag;
+}
+
+bool RunRecord::from_tag(const String& tag) {
+  Strings fields;
+  size_t begin = 0;
+  for (size_t end = tag.find(recordSeparator); end != String::npos; end = tag.find(recordSeparator, begin)) {
+    fields.push_back(tag.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  size_t next = 0;
+  auto field = [&] () -> const String& { return fields.at(next++); };
+  auto list = [&] (Strings& items) {
+    size_t count = std::stoul(field());
+    items.clear();
+    for (size_t i = 0; i < count; i++)
+      items.push_back(field());
+  };
+  try {
+    if (field() != recordMark)
+      return false;
+    reportID = std::stoull(field());
+    monitoredReportID = std::stoull(field());
+    workspaceDirectory = field();
+    workspaceTool = field();
+    tool = field();
+    tenant = field();
+    directory = field();
+    callCommand = field();
+    automationPlanName = field();
+    priority = std::stoi(field());
+    timeLimit = Dur(std::stoll(field()));
+    startTime = TimePoint(std::chrono::duration_cast<TimePoint::duration>(Dur(std::stoll(field()))));
+    list(parameters);
+    Strings files;
+    list(files);
+    inputFiles.clear();
+    for (const String& file : files)
+      inputFiles.push_back(std::stoull(file));
+    list(outputNames);
+  }
+  catch (const std::exception& e) { // std::out_of_range for missing fields, std::invalid_argument for malformed numbers
+    return false;
+  }
+  return next == fields.size();
+}
+
 /// Initialize the "table" map.
 /// in .. the input to the initilializer; e.g. "i1,p22,o333" sets the map to {0 |-> 1, 1 |-> 333, 2 |-> 22}
 ParMap::ParMap(const String& in) {
@@ -62,35 +140,59 @@ bbb::Maybe<ParMap::IdPair> ParMap::mapping(Nat index) {
   return {};
 }
 
-Run::Run(Archive::ReportID reportID, Archive::Archive& archive, Workspace::SharedWorkspace& workspace) : 
-      Run(archive.borrow_report(reportID), reportID, archive, workspace) { }
-
-Run::Run(Archive::BorrowedReport&& borrowedReport, Archive::ReportID reportID, Archive::Archive& archive, Workspace::SharedWorkspace& workspace):
+Run::Run(const Scheduler::Job& job, Archive::Archive& archive, Launcher::Process&& process, const Launcher::Request& request,
+         Scheduler::Allocation&& allocation, bool preemptible, const std::shared_ptr<Remote::Assignment>& remote):
     archive(archive),
+    report(archive.get_report(job.reportID)),
+    monitoredReport(archive.get_report(job.monitored_report())),
     startTime(SClock::now()),
-    outFileName(workspace->getCanonicalPath() + "/" + "out"),
-    errFileName(workspace->getCanonicalPath() + "/" + "err"),
+    directory(request.workingDirectory),
+    outFileName(request.outFileName),
+    errFileName(request.errFileName),
 //    outFileName(workspace->getCanonicalPath() + "/" + bbb::time_to_string(startTime,"%F_%T") + "-out"),
 //    errFileName(workspace->getCanonicalPath() + "/" + bbb::time_to_string(startTime,"%F_%T") + "-err"),
-    procHandle(borrowedReport->callCommand,
-                  subprocess::cwd{workspace->getCanonicalPath()},
-                  subprocess::output{outFileName.c_str()},
-                  subprocess::error{errFileName.c_str()},
-                  subprocess::preexec_func{std::bind(&Run::prepareStdOutputFiles, this)}), // Make sure we are appending output to an empty file (and not last run's output)
-    pid(procHandle.pid()),
-    reportID(reportID),
-    workspace(workspace),
+    allocation(std::move(allocation)),
+    process(std::move(process)),
+    pid(this->process.pid()),
+    reader(this->process.pid()),
+    storageReader(this->process.pid()),
+    storageWritten(0),
+    storageMeasured(0),
+    directoryUsage(0),
+    diskUsage(0),
+    remote(remote),
+    reportID(job.reportID),
+    workspace(job.workspace),
+    group(job.group),
+    outOffset(0),
+    errOffset(0),
+    earlyTermination(false),
     prevUTime(0),
-    prevSTime(0) {
-  DEB("Starting process: " + borrowedReport->callCommand + " , PID: " + std::to_string(pid) + " , erFileName = " + errFileName);
+    prevSTime(0),
+    peakMemory(0),
+    peakResident(0),
+    partResultTime{0, 0},
+    partResultSize(-1),
+    priority(job.priority),
+    timeLimit(job.timeLimit),
+    preemptible(preemptible),
+    held(!request.tag.empty()),
+    suspended(false),
+    suspendedTime(Dur::zero()),
+    history(job.features),
+    interrupted(false) {
+  auto borrowedReport = borrowReport();
+  parser = OutputParser::Registry::instance().create(borrowedReport->tool->get_output_parser());
+  earlyTermination = borrowedReport->tool->get_early_termination();
+  DEB("Started process: " + borrowedReport->callCommand + " , PID: " + std::to_string(pid) + " , erFileName = " + errFileName
+      + (remote ? " , worker agent: " + remote->get_worker()->get_name() : " , cores: " + this->allocation.getCores().to_string()));
   borrowedReport->running = true;
   borrowedReport->pid = pid;
+  borrowedReport->stdOutput.clear(); // Filled in as the process writes it
+  borrowedReport->errOutput.clear();
+  borrowedReport->terminatedEarly = false;
   borrowedReport->runningResult = "Started.";
-  }
-
-  void Run::prepareStdOutputFiles() {
-    std::ofstream emptyFile1(outFileName, std::ios_base::trunc);
-    std::ofstream emptyFile2(errFileName, std::ios_base::trunc);
+  borrowedReport->expectedEnd = (job.expected.known() ? startTime + job.expected.runTime : TimePoint());
   }
 
                   
@@ -98,17 +200,19 @@ Run::Run(Archive::BorrowedReport&& borrowedReport, Archive::ReportID reportID, A
 /// and if the child process is not a zombie.
 bool Run::is_running() {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
-  auto poll_status = procHandle.poll();
+  auto poll_status = process.poll();
   if (poll_status != -2) {// && poll_status != 0) {	// ; -2 .. child process still running.
-    kill("Killed (poll_status " + std::to_string(poll_status) + ").");
+    stop("Killed (poll_status " + std::to_string(poll_status) + ").");
     return false;
   }
-  if (!get_stats(pid)) {
-    kill("Failed to read process stats.");
+  if (remote)
+    return true; // The agent samples the process, poll() sees its end
+  if (!reader.sample(sample)) {
+    stop("Failed to read process stats.");
     return false;
   }
-  if (values[2] == "Z") {
-    kill("Process is a zombie.");
+  if (sample.state == 'Z') {
+    stop("Process is a zombie.");
     return false;
   }
   return true;
@@ -129,139 +233,264 @@ void Run::print_output() {
     << " and er. output " << report->errOutput << std::endl;
 }
 
-double Run::cpu_usage(Nat l1, Nat l2, Nat g1, Nat g2) {
+double Run::cpu_usage(unsigned long long l1, unsigned long long l2, unsigned long long g1, unsigned long long g2) {
+  if (g2 <= g1 || l2 < l1)
+    return 0.0;
   double locDif = l2 - l1;
   double globDif = g2 - g1;
   return (100.0 * (locDif / globDif));
 }
 
-/// Read process statistics from /proc/[pid]/stat;
-/// file structure is explained in http://man7.org/linux/man-pages/man5/proc.5.html
-/// Returns whether the statistics could be read.
-bool Run::get_stats(int pid) {
+/// Reads process statistics from /proc/[pid]/stat (see Monitor::ProcessReader) and appends them to the report.
+/// VSize and RSS are stored in kB, free memory comes from the host sample shared by all runs.
+/// A run on a worker agent takes the statistics the agent sent last, of the process and of the agent's host.
+void Run::try_update_stats(TimePoint time, const Monitor::HostSample& host) {
+  static const unsigned long long pageSizeKB = sysconf(_SC_PAGESIZE) / 1024;
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
-  Strings lines;
-  if (!bbb::read_file("/proc/" + std::to_string(pid) + "/stat", lines))
-    return false;
-  assert(!lines.empty());
-  bbb::remove_ws(lines.back(), values);
-  return true;
+  Monitor::HostSample agentHost;
+  if (remote ? !remote->sample(sample, agentHost) : !reader.sample(sample))
+    return;
+  const Monitor::HostSample& hostSample = (remote ? agentHost : host); // Usage is relative to the host the process runs on
+  Archive::ResourceInformation resources;
+  resources.utime = cpu_usage(prevUTime, sample.utime, hostSample.previousTotalTime, hostSample.totalTime);
+  resources.stime = cpu_usage(prevSTime, sample.stime, hostSample.previousTotalTime, hostSample.totalTime);
+  long vsize = sample.vsize / 1024;
+  peakMemory = std::max(peakMemory, vsize);
+  resources.vsize = std::to_string(vsize);
+  long rss = (sample.rss > 0 ? sample.rss * pageSizeKB : 0);
+  peakResident = std::max(peakResident, rss);
+  resources.rss = std::to_string(rss);
+  resources.memFree = std::to_string(hostSample.memFreeMB);
+  resources.memPerc = std::to_string(hostSample.memFreePercent);
+  resources.disk = std::to_string(diskUsage);
+  borrowReport()->resources.emplace_back(time, std::move(resources));
+  prevUTime = sample.utime;
+  prevSTime = sample.stime;
+}
+
+/// Reads what was appended to the file since the last call
+void Run::read_new_output(const String& fileName, std::streamoff& offset, String& chunk) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open())
+    return;
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size <= offset)
+    return;
+  chunk.resize(size - offset);
+  file.seekg(offset);
+  file.read(&chunk[0], chunk.size());
+  chunk.resize(file.gcount());
+  offset += chunk.size();
 }
 
-std::pair<String, String> Run::get_free_mem() {
-  struct sysinfo info;
-  sysinfo(&info);
-  auto fRam = info.freeram * info.mem_unit;
-  auto tRam = info.totalram * info.mem_unit;
-  DEB("Free RAM: " + std::to_string(bbb::b2mb(fRam)) + " Total RAM: " + std::to_string(bbb::b2mb(tRam)));
-  return { std::to_string(bbb::b2mb(fRam)),
-           std::to_string(fRam / (tRam / 100)) };
+/// Passes the output written since the last call to the output parser and to the report.
+void Run::tail_outputs() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  String outChunk, errChunk;
+  read_new_output(outFileName, outOffset, outChunk);
+  read_new_output(errFileName, errOffset, errChunk);
+  if (outChunk.empty() && errChunk.empty())
+    return;
+  parser->feed(OutputParser::Stream::out, outChunk.data(), outChunk.size());
+  parser->feed(OutputParser::Stream::err, errChunk.data(), errChunk.size());
+  auto report = borrowReport();
+  report->stdOutput += outChunk;
+  report->errOutput += errChunk;
 }
 
-void Run::try_update_stats(TimePoint time, uint32_t prevTTime, uint32_t curTTime) {
+bool Run::account_disk() {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
-  get_stats(pid);
-  if (values.size() > 25) {
-    curUTime = std::stol(values[15]);
-    curSTime = std::stol(values[16]);
-    auto mem = get_free_mem();
-    borrowReport()->resources.push_back(
-      {time,
-        {   cpu_usage(prevUTime, curUTime, prevTTime, curTTime),
-            cpu_usage(prevUTime, curUTime, prevTTime, curTTime),
-            values[24],
-            values[25],
-            mem.first,
-            mem.second
-        }
-      });
-    print_stats();
-    prevUTime = curUTime;
-    prevSTime = curSTime;
+  if (!remote) { // The agent writes the outputs into the run directory, its processes write elsewhere
+    storageReader.sample(storageWritten);
+    if (storageWritten >= storageMeasured + measureStep) {
+      storageMeasured = storageWritten;
+      directoryUsage = Workspace::Workspace::measureDirectory(directory);
+    }
   }
-  values.clear();
+  unsigned long long usage = std::max<unsigned long long>(outOffset + errOffset + std::max<off_t>(partResultSize, 0), directoryUsage);
+  if (usage <= diskUsage)
+    return false;
+  diskUsage = usage;
+  if (workspace)
+    workspace->setRunDiskUsage(reportID, diskUsage);
+  return true;
+}
+
+/// Stops the process if early termination is enabled for the tool and the output seen so far gives a definitive verdict.
+/// The tool may still be writing statistics or tearing down at that point.
+void Run::check_early_verdict() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!earlyTermination || !earlyVerdict.empty())
+    return;
+  auto verdict = parser->verdict_so_far();
+  if (!verdict || !Portfolio::is_definitive(verdict.value()))
+    return;
+  earlyVerdict = verdict.value();
+  kill("Definitive verdict found, stopping the process early.");
 }
 
-void Run::update_report() {
-  bbb::read_file(workspace->getCanonicalPath()+"/"+"partVerResult.txt", borrowReport()->partVerResult); // TODO: should be a suitable tmp file but wrappers generate this one
+/// Reads partVerResult.txt again only if it changed since the last read (or if forced).
+void Run::update_report(bool force) {
+  String fileName = directory+"/"+"partVerResult.txt"; // TODO: should be a suitable tmp file but wrappers generate this one
+  struct stat info;
+  if (stat(fileName.c_str(), &info) != 0)
+    return;
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!force && info.st_size == partResultSize && info.st_mtim.tv_sec == partResultTime.tv_sec
+      && info.st_mtim.tv_nsec == partResultTime.tv_nsec)
+    return;
+  partResultTime = info.st_mtim;
+  partResultSize = info.st_size;
+  String content;
+  if (bbb::read_file(fileName, content))
+    borrowReport()->partVerResult = std::move(content);
 }
   
+/// Marks the report as finalising once the process ended, the output is parsed afterwards by the Finaliser.
+void Run::begin_finalisation() {
+  auto report = borrowReport();
+  report->running = false;
+  report->finalising = true;
+  report->runningResult = "Finalising.";
+}
+
+/// The outputs are read and parsed without the report's lock, so that monitoring requests are answered meanwhile.
 void Run::finalise_report() {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
-  auto report = borrowReport();
-  report->returnCode = procHandle.retcode();
+  int returnCode = process.retcode();
   DEB("Finalising report.");
-  try {
-    // Read output files. If any of them do not exist, create empty file. (subprocess does not create file if there is no output)
-    if (!bbb::read_file(outFileName, report->stdOutput)) {
-      DEB("Out file " << outFileName << " does not exist. Creating empty file.");
-      std::ofstream emptyFile(outFileName);
-    }
-    if (!bbb::read_file(errFileName, report->errOutput)) {
-      DEB("Err file " << outFileName << " does not exist. Creating empty file.");
-      std::ofstream emptyFile(errFileName);
-    }
-    // TODO: escape possible spaces in the following (quoting did not work):
-    report->parsedOutput = subprocess::check_output("./" + report->tool.get_output_parser() + " " + outFileName + " " + errFileName + " " + std::to_string(report->returnCode)).buf.data();
-  } catch (const subprocess::OSError& e) {
-    report->parsedOutput = "ERROR";
+  // If any of the output files do not exist (e.g. they were removed while the process ran), create empty file.
+  if (!std::ifstream(outFileName).is_open()) {
+    DEB("Out file " << outFileName << " does not exist. Creating empty file.");
+    std::ofstream emptyFile(outFileName);
+  }
+  if (!std::ifstream(errFileName).is_open()) {
+    DEB("Err file " << errFileName << " does not exist. Creating empty file.");
+    std::ofstream emptyFile(errFileName);
   }
+  tail_outputs(); // The rest of the output
+  // Output written after an early verdict does not change it:
+  String parsedOutput = (earlyVerdict.empty() ? parser->finish(outFileName, errFileName, returnCode) : earlyVerdict);
   DEB("After output.");
-  report->runTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-  report->peakMemory = 0;
-  for (auto& vs : report->resources) {
-    auto answer = bbb::s2u(vs.second.vsize);
-    assert(answer);
-    if (answer.value() > report->peakMemory)
-      report->peakMemory = answer.value();
+  update_report(true);
+  allocation.release();
+  if (workspace) { // The estimate of the monitoring is settled by what the run left
+    diskUsage = Workspace::Workspace::measureDirectory(directory);
+    workspace->setRunDiskUsage(reportID, diskUsage);
+  }
+  // The declared outputs go to the archive, so that later steps of a plan can use them as inputs:
+  Strings outputNames = borrowReport()->outputNames;
+  std::map<Nat, Archive::FileID> outputFiles;
+  for (Nat i = 0; i < outputNames.size(); i++) {
+    String content;
+    if (bbb::read_file(directory + "/" + outputNames[i], content))
+      outputFiles[i] = archive.checkin_file(content).second;
   }
+  auto report = borrowReport();
+  report->outputFiles = std::move(outputFiles);
+  report->returnCode = returnCode;
+  report->parsedOutput = parsedOutput;
+  report->terminatedEarly = !earlyVerdict.empty();
+  report->runTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+  report->peakMemory = peakMemory;
+  report->suspendedTime = suspendedTime + (suspended ? std::chrono::duration_cast<Dur>(endTime - suspendedSince) : Dur::zero());
   report->date = startTime;
-  update_report();
   report->running = false;
-  report->runningResult = "Verification finished.";
+  report->finalising = false;
+  report->runningResult = (earlyVerdict.empty() ? "Verification finished." : "Verification finished early: the tool was stopped once its output gave the verdict.");
+  if (report->suspendedTime > Dur::zero())
+    report->runningResult += " The run was suspended for "
+                             + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(report->suspendedTime).count()) + " s.";
+  report->expectedEnd = TimePoint();
   DEB("Finalised report: " + report->callCommand + "\n");
   report->validate();
+  if (!interrupted || !earlyVerdict.empty()) // A run stopped for its verdict took what such a run takes
+    RunHistory::RunHistory::instance().record(history, {wall_time(endTime), static_cast<Nat>(peakResident / 1024), parsedOutput});
 }
 
 void Run::kill(const String& debug_message) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  interrupted = true;
+  stop(debug_message);
+}
+
+void Run::stop(const String& debug_message) {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
   DEB(debug_message);
-  procHandle.kill(9);
+  process.kill(9);
   endTime = SClock::now();
 }
 
-/// Get the sum of numbers in the first "cpu" line in the /pros/stat file.
-/// These numbers are user/nice/system/idle/... CPU times in USER_HZ/Jiffies units (usually 1/100 s).
-void ExecutionWindow::update_ttime() {
+bool Run::suspend() {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
-  Strings lines;
-  bbb::read_file("/proc/stat", lines);
-  Strings gVals;
-  assert(!lines.empty());
-  bbb::remove_ws(lines[0], gVals);
-  assert(!gVals.empty() && gVals[0] == "cpu");
-  previousTtime = currentTtime;
-  currentTtime = 0;
-  for (size_t i = 1; i < gVals.size(); i++) {
-    currentTtime += std::stol(gVals[i]);
-  }
+  if (!preemptible || suspended)
+    return false;
+  process.kill(SIGSTOP);
+  allocation.suspend();
+  suspended = true;
+  suspendedSince = SClock::now();
+  DEB("Suspended report " << reportID << " (PID " << pid << ")");
+  borrowReport()->runningResult = "Suspended: its cores are lent to an interactive verification.";
+  return true;
 }
 
-void ExecutionWindow::start_new_run(Archive::ReportID reportID, Archive::Archive& archive, Workspace::SharedWorkspace workspace, const String& call_schema) {
-  try {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+bool Run::resume() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!suspended)
+    return true;
+  if (!allocation.resume())
+    return false;
+  allocation.getCores().apply_to_group(pid);
+  process.kill(SIGCONT);
+  suspended = false;
+  suspendedTime += std::chrono::duration_cast<Dur>(SClock::now() - suspendedSince);
+  DEB("Resumed report " << reportID << " on cores " << allocation.getCores().to_string());
+  auto report = borrowReport();
+  report->suspendedTime = suspendedTime;
+  report->runningResult = "Running (suspended for " + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(suspendedTime).count())
+                          + " s so far).";
+  return true;
+}
+
+Dur Run::wall_time(TimePoint now) const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  Dur result = std::chrono::duration_cast<Dur>(now - startTime) - suspendedTime;
+  if (suspended)
+    result -= std::chrono::duration_cast<Dur>(now - suspendedSince);
+  return result;
+}
+
+/// The process is spawned without holding any lock (the report is borrowed only to build the command),
+/// the run is published to the window once the process and the run exist.
+void ExecutionWindow::start_new_run(const Scheduler::Job& job, Archive::Archive& archive, Scheduler::Allocation&& allocation,
+                                    Remote::Slot&& slot) {
+  const Archive::ReportID reportID = job.reportID;
+  const Workspace::SharedWorkspace& workspace = job.workspace;
+  Launcher::Request request;
+  ToolKit::SessionSettings session;
+  String toolName, toolPath, sessionCommand;
+  Strings inputPaths;
+  RunRecord record; // Tags the process if the supervisor holds it
+  try { // Runs of one workspace (e.g. portfolio members, or checks of several properties) must not share outputs
+    request.workingDirectory = workspace->createRunDirectory(reportID);
+  }
+  catch (const Workspace::filesystem::filesystem_error& e) {
+    throw std::runtime_error("Creating the run directory failed: " + std::string(e.what()));
+  }
+  {
     auto report = archive.borrow_report(reportID);
     // print debugging info
     String reportStr;
     report->to_string(reportStr);
     DEB("Report:\n" + reportStr);
 
-    String com = report->tool.get_path() + " ";
+    String com = report->tool->get_path() + " ";
     Strings iFiles;
     for (const Archive::FileID fid : report->inputFiles) {
       iFiles.push_back(workspace->getWorkspaceRelativeFilePath(fid));
     }
-    ParMap pm(call_schema);
+    ParMap pm(job.callSchema);
     // TODO: Verify that lengths of iFiles and parameters are sufficient, otherwise risking segfault
     bbb::zip_schema(
       {   iFiles,
@@ -275,54 +504,288 @@ void ExecutionWindow::start_new_run(Archive::ReportID reportID, Archive::Archive
     while (isspace(com.back()))
       com.pop_back();
     report->callCommand = com;
-    DEB("Starting verification process \"" + com + "\"");
-    running.emplace_back(reportID, archive, workspace);
+    report->updateLastMonitored(); // Time spent in the queue does not count towards the monitor timeout
+    request.command = com;
+    request.outFileName = request.workingDirectory + "/out";
+    request.errFileName = request.workingDirectory + "/err";
+    request.cores = &allocation.getCores(); // Leave the server's cores and the other runs' cores alone
+    toolName = report->tool->get_name();
+    toolPath = report->tool->get_path();
+    if (!slot) // A worker agent starts the tool as an ordinary process
+      session = report->tool->get_session();
+    if (!session.protocol.empty()) {
+      sessionCommand = report->tool->get_path() + " " + session.arguments;
+      for (const String& iFile : iFiles)
+        inputPaths.push_back(request.workingDirectory + "/" + iFile);
+    }
+    record.reportID = reportID;
+    record.monitoredReportID = job.monitored_report();
+    record.workspaceDirectory = workspace->getCanonicalPath();
+    record.workspaceTool = workspace->getToolName();
+    record.tool = toolName;
+    record.tenant = job.tenant;
+    record.directory = request.workingDirectory;
+    record.callCommand = com;
+    record.automationPlanName = report->automationPlanName;
+    record.parameters = report->parameters;
+    record.inputFiles = report->inputFiles;
+    record.outputNames = report->outputNames;
+    record.priority = job.priority;
+    record.timeLimit = job.timeLimit;
+    record.startTime = SClock::now();
   }
-  catch (const subprocess::OSError& e) {
+  Zygote::Zygote* zygote = Zygote::Zygote::instance();
+  if (!slot && session.protocol.empty() && zygote && zygote->is_supervisor())
+    request.tag = record.to_tag();
+  Launcher::Process process;
+  std::shared_ptr<Remote::Assignment> remote;
+  try {
+    if (slot) {
+      DEB("Starting verification process \"" + request.command + "\" on worker agent " + slot.get_worker()->get_name());
+      process = Remote::WorkerPool::instance().start(std::move(slot), toolName, toolPath, request, remote);
+    }
+    else if (session.protocol.empty()) {
+      DEB("Starting verification process \"" + request.command + "\"");
+      process = Zygote::spawn(request);
+    }
+    else { // Parameters of the call schema do not apply, the session process was started without them
+      DEB("Sending " << inputPaths.size() << " input file(s) to a session of " << toolName);
+      process = SolverPool::Pool::instance().submit(toolName, sessionCommand, session, std::move(inputPaths), request);
+      if (process.pid() <= 0) { // All session processes of the tool are busy
+        DEB("Starting verification process \"" + request.command + "\"");
+        session = ToolKit::SessionSettings();
+        if (zygote && zygote->is_supervisor())
+          request.tag = record.to_tag();
+        process = Zygote::spawn(request);
+      }
+    }
+  }
+  catch (const Launcher::LaunchError& e) {
     throw std::runtime_error("Launching verification process failed: " + std::string(e.what()));
   }
+  catch (const Remote::RemoteError& e) {
+    throw std::runtime_error("Launching verification process on a worker agent failed: " + std::string(e.what()));
+  }
+  // A session process serves other runs too, so it must not be stopped for one of them.
+  // A run on a worker agent holds no cores of this node that it could lend.
+  auto run = std::make_shared<Run>(job, archive, std::move(process), request, std::move(allocation),
+                                   session.protocol.empty() && !remote, remote);
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  running.push_back(std::move(run));
 }
 
 /// For each verification task update statistics, update report.
 /// Kill the tasks that reached the timeout.
-/// Finalize reports for not running tasks.
+/// Hand the not running tasks to the Finaliser.
+/// The runs are sampled in parallel shards without the window's lock, the reports are borrowed without the archive's lock.
 void ExecutionWindow::update_stats() {
-  std::lock_guard<decltype(mutex)> lockGuard(mutex);
   DEB("Updating stats.");
   TimePoint now = SClock::now();
-  update_ttime();
-  std::for_each(running.begin(), running.end(),
-                [&] (Run& run)
+  std::vector<SharedRun> runs;
+  Monitor::HostSample host;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    runs.assign(running.begin(), running.end());
+    host = hostSampler.sample();
+  }
+  std::vector<char> ended(runs.size(), false);
+  Monitor::ShardPool::instance().for_each(runs.size(),
+                [&] (size_t i)
                 {
-                  run.try_update_stats(now, previousTtime, currentTtime);
+                  Run& run = *runs[i];
+                  run.try_update_stats(now, host);
                   run.update_report();
+                  run.tail_outputs();
+                  run.check_early_verdict();
+                  bool writing = run.account_disk();
+                  if (run.workspace && run.workspace->isOverDiskQuota()) {
+                    run.kill("Disk quota of the workspace of report " + std::to_string(run.reportID) + " exceeded.");
+                  }
+                  else if (writing && Workspace::DiskAccount::instance().isOverTotalQuota()) { // Stops the runs still writing
+                    run.kill("Disk quota of all workspaces exceeded, stopping report " + std::to_string(run.reportID) + ".");
+                  }
                   if (now - run.getLastMonitored() > monitorTimeout) {
                     run.kill();
                   }
+                  if (run.timeLimit > Dur::zero() && run.wall_time(now) > run.timeLimit) {
+                    run.kill("Wall-time limit of report " + std::to_string(run.reportID) + " reached.");
+                  }
+                  ended[i] = !run.is_running();
                 }
                );
   DEB("Stats updated.");
 
-  running.remove_if([&] (Run& run)
-                    {
-                      if (run.is_running())
-                        return false;
-                      else {
-                        run.finalise_report();
-                        return true;
-                      }
-                    }
-                   );
+  std::vector<SharedRun> finished;
+  for (size_t i = 0; i < runs.size(); i++)
+    if (ended[i])
+      finished.push_back(std::move(runs[i]));
+  if (finished.empty())
+    return;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    running.remove_if([&] (const SharedRun& run)
+                      { return std::find(finished.begin(), finished.end(), run) != finished.end(); });
+  }
+  for (const SharedRun& run : finished)
+    finalise(run);
   DEB("Zombies removed.");
 }
 
+/// Hands the ended run to the Finaliser. A portfolio member that decides its portfolio stops the other members.
+void ExecutionWindow::finalise(const SharedRun& run) {
+  run->begin_finalisation();
+  {
+    std::lock_guard<decltype(finalisingMutex)> lockGuard(finalisingMutex);
+    finalising++;
+  }
+  Finaliser::instance().submit([this, run] ()
+                               {
+                                 try {
+                                   run->finalise_report();
+                                   if (run->group && run->group->member_finished(run->reportID, run->archive))
+                                     kill_group(run->group, "Another tool of the portfolio decided the verification.");
+                                 }
+                                 catch (const std::exception& e) {
+                                   DEB("Finalising report " << run->reportID << " failed: " << e.what());
+                                 }
+                                 std::lock_guard<decltype(finalisingMutex)> lockGuard(finalisingMutex);
+                                 if (--finalising == 0)
+                                   finalisingDone.notify_all();
+                               });
+}
+
+void ExecutionWindow::adopt_run(const Scheduler::Job& job, Archive::Archive& archive, Launcher::Process&& process,
+                                const RunRecord& record, Scheduler::Allocation&& allocation) {
+  Launcher::Request request;
+  request.workingDirectory = record.directory;
+  request.outFileName = record.directory + "/out";
+  request.errFileName = record.directory + "/err";
+  request.tag = record.to_tag();
+  {
+    auto report = archive.borrow_report(job.reportID);
+    report->callCommand = record.callCommand;
+    report->updateLastMonitored();
+  }
+  archive.borrow_report(job.monitored_report())->updateLastMonitored(); // The client has the monitor timeout to come back
+  auto run = std::make_shared<Run>(job, archive, std::move(process), request, std::move(allocation), true);
+  run->startTime = record.startTime; // Wall time and the time limit count from the original start
+  run->allocation.getCores().apply_to_group(run->pid); // The cores of the earlier server may be given to other runs now
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  running.push_back(std::move(run));
+}
+
+ExecutionWindow::~ExecutionWindow() {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    for (const SharedRun& run : running)
+      if (run->held) // The next server takes the run over and needs its directory
+        run->workspace->retainDirectory();
+  }
+  std::unique_lock<decltype(finalisingMutex)> lock(finalisingMutex);
+  finalisingDone.wait(lock, [this] () { return finalising == 0; });
+}
+
 bool ExecutionWindow::kill_process(Nat pid) {
   std::lock_guard<decltype(mutex)> lockGuard(mutex);
   for (auto &run : running)
-    if (run.pid == pid) {
-      run.kill();
+    if (run->pid == pid) {
+      run->kill();
       return true;
     }
   return false;
 }
+
+Nat ExecutionWindow::suspend_runs(Nat cores, int maxPriority) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  std::vector<SharedRun> candidates;
+  for (const SharedRun& run : running)
+    if (run->preemptible && !run->suspended && run->priority <= maxPriority)
+      candidates.push_back(run);
+  std::stable_sort(candidates.begin(), candidates.end(), [] (const SharedRun& a, const SharedRun& b) {
+    return a->priority != b->priority ? a->priority < b->priority : a->startTime > b->startTime;
+  });
+  Nat lent = 0;
+  for (const SharedRun& run : candidates) {
+    if (lent >= cores)
+      break;
+    Nat runCores = run->allocation.getDemand().cores;
+    if (run->suspend())
+      lent += runCores;
+  }
+  return lent;
+}
+
+void ExecutionWindow::resume_runs() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  std::vector<SharedRun> suspendedRuns;
+  for (const SharedRun& run : running)
+    if (run->suspended)
+      suspendedRuns.push_back(run);
+  std::stable_sort(suspendedRuns.begin(), suspendedRuns.end(), [] (const SharedRun& a, const SharedRun& b) {
+    return a->priority != b->priority ? a->priority > b->priority : a->startTime < b->startTime;
+  });
+  for (const SharedRun& run : suspendedRuns)
+    if (!run->resume())
+      break; // Keeps the order: a later run does not overtake one that waits for more cores
+}
+
+bool ExecutionWindow::has_suspended() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return std::any_of(running.begin(), running.end(), [] (const SharedRun& run) { return run->suspended; });
+}
+
+void ExecutionWindow::kill_group(const Portfolio::SharedGroup& group, const String& debug_message) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  for (const SharedRun& run : running)
+    if (run->group == group)
+      run->kill(debug_message);
+}
+
+
+Finaliser& Finaliser::instance() {
+  static Finaliser finaliser;
+  return finaliser;
+}
+
+Finaliser::Finaliser() : stopping(false) {
+  for (Nat i = 0; i < threadCount; i++)
+    threads.emplace_back(&Finaliser::serve, this);
+}
+
+/// Finishes the submitted jobs first
+Finaliser::~Finaliser() {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+void Finaliser::submit(std::function<void()>&& job) {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    jobs.push_back(std::move(job));
+  }
+  wakeUp.notify_one();
+}
+
+void Finaliser::serve() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<decltype(mutex)> lock(mutex);
+      wakeUp.wait(lock, [this] () { return stopping || !jobs.empty(); });
+      if (jobs.empty())
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+const Nat Finaliser::threadCount;
+
 }
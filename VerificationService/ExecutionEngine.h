@@ -21,12 +21,24 @@
 #include <chrono>
 #include <list>
 #include <cstdio>//remove
-#include <sys/sysinfo.h>//sysconf
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <sys/stat.h>
 
 #include "bbb.h"
 #include "subprocess.hpp"
 #include "Archive.h"
+#include "Launcher.h"
+#include "Monitor.h"
+#include "OutputParser.h"
+#include "Portfolio.h"
+#include "Remote.h"
+#include "RunHistory.h"
 #include "Workspace.h"
+#include "Scheduler.h"
 
 namespace ExecutionEngine {
 
@@ -42,24 +54,83 @@ struct ParMap {
   bbb::Maybe<IdPair> mapping(Nat index);
 };
 
+/**
+ * What a restarted server needs to take over a run the supervisor held (see Zygote::held()).
+ * Travels as the tag of the run's process; newlines in the fields become spaces.
+ */
+struct RunRecord {
+  Archive::ReportID reportID;
+  Archive::ReportID monitoredReportID; // Differs for members of a portfolio, a sweep or a step
+  String workspaceDirectory;           // Canonical path of the run's workspace
+  String workspaceTool;
+  String tool;
+  String tenant;
+  String directory;                    // Scratch directory of the run
+  String callCommand;
+  String automationPlanName;
+  Strings parameters;
+  std::vector<Archive::FileID> inputFiles;
+  Strings outputNames;
+  int priority = 0;
+  Dur timeLimit = Dur::zero();
+  TimePoint startTime;
+
+  String to_tag() const;
+
+  /**
+   * @return false if the tag is not a run record
+   */
+  bool from_tag(const String& tag);
+};
+
 class Run {
 public:
   mutable std::recursive_mutex mutex;
   Archive::Archive& archive;
+  Archive::Report& report;          // Borrowed without the archive's lock, see Archive::borrow()
+  Archive::Report& monitoredReport; // Holds the monitor timeout: the report itself, or the portfolio's parent report
   TimePoint startTime;
+  String directory; // Scratch directory of the run (see Workspace::createRunDirectory()), its working directory
   String outFileName;
   String errFileName;
-  subprocess::Popen procHandle;
+  Scheduler::Allocation allocation; // Resources held by the run until it is finalised
+  Launcher::Process process;
   Nat pid;
+  Monitor::ProcessReader reader; // Keeps /proc/[pid]/stat open
+  Monitor::ProcessSample sample; // The last sample read by reader, or sent by the worker agent
+  Monitor::StorageReader storageReader; // Keeps /proc/[pid]/io open
+  unsigned long long storageWritten; // What the process wrote to storage when it was sampled last
+  unsigned long long storageMeasured; // storageWritten when the run directory was last measured
+  unsigned long long directoryUsage; // Bytes the run directory took when it was last measured
+  unsigned long long diskUsage; // Bytes of the run directory charged to the workspace
+  std::shared_ptr<Remote::Assignment> remote; // Set for a run on a worker agent, its pid is not of this host
   TimePoint endTime;
 
   Archive::ReportID reportID;
   Workspace::SharedWorkspace workspace;
-  Strings values;	// temporary statistics, read by get_stats() from /proc/[pid]/stat
-  Nat prevUTime, curUTime, prevSTime, curSTime;
+  Portfolio::SharedGroup group; // Set for members of a portfolio verification
+  std::unique_ptr<OutputParser::Parser> parser;
+  std::streamoff outOffset, errOffset; // How much of the output files was already passed to the parser
+  bool earlyTermination; // Stop the process once the parser finds a definitive verdict
+  String earlyVerdict;   // The verdict the process was stopped for, empty if it was not
+  unsigned long long prevUTime, prevSTime;
+  long peakMemory; // Largest VSize sampled so far (kB)
+  long peakResident; // Largest RSS sampled so far (kB); what the run is recorded to need, VSize counts reserved address space
+  struct timespec partResultTime; // Modification time and size of partVerResult.txt when it was read last
+  off_t partResultSize;
+  int priority;
+  Dur timeLimit;          // Wall-time limit without the time the run was suspended, zero for none
+  bool preemptible;       // May be suspended to lend its cores; not a run answered by a session process
+  bool held;              // Started through the supervisor, the run outlives the server (see Zygote::held())
+  bool suspended;
+  TimePoint suspendedSince;
+  Dur suspendedTime;      // Time the run was suspended, without the current suspension
+  RunHistory::Features history; // What the run is recorded under in the RunHistory once it ends, empty for none
+  bool interrupted;       // Killed before it ended on its own (limits, quotas, clients), its run time is not recorded
 
   Run() = delete;
-  Run(Archive::ReportID reportID, Archive::Archive& archive, Workspace::SharedWorkspace& workspace);
+  Run(const Scheduler::Job& job, Archive::Archive& archive, Launcher::Process&& process, const Launcher::Request& request,
+      Scheduler::Allocation&& allocation, bool preemptible, const std::shared_ptr<Remote::Assignment>& remote = nullptr);
   Run(const Run& other) = delete;
   Run(Run&& other) = delete;
   ~Run() { }
@@ -71,37 +142,139 @@ public:
   void print_stats();
   void print_output();
 
-  static double cpu_usage(Nat l1, Nat l2, Nat g1, Nat g2);
+  static double cpu_usage(unsigned long long l1, unsigned long long l2, unsigned long long g1, unsigned long long g2);
+
+  void try_update_stats(TimePoint time, const Monitor::HostSample& host);
+  void update_report(bool force = false);
+  void tail_outputs();
+  void check_early_verdict();
 
-  bool get_stats(int pid);
-  static std::pair<String, String> get_free_mem();
-  void try_update_stats(TimePoint time, Nat prevTTime, Nat curTTime);
-  void update_report();
-  TimePoint getLastMonitored() {return borrowReport()->lastMonitored;}
+  /**
+   * Charges the run's outputs to its workspace: what the run wrote to its output files, or what the run directory
+   * takes if that is more (files other than the outputs, e.g. counterexample traces). What the process wrote to storage
+   * is not charged, it counts rewrites and files elsewhere (e.g. /tmp); once it grew by measureStep since the
+   * directory was measured last, the directory is measured again.
+   * @return true if the usage grew since the last call
+   */
+  bool account_disk();
+  static const unsigned long long measureStep = 64ull << 20;
+  TimePoint getLastMonitored() {return monitoredReport.getLastMonitored();}
+  void begin_finalisation();
   void finalise_report();
 
+  /**
+   * Kills the run before it ends on its own
+   */
   void kill(const String& debug_message = "");
+
+  /**
+   * Stops the run's processes (SIGSTOP to the process group) and lends its cores to other runs.
+   * @return false if the run is not preemptible or suspended already
+   */
+  bool suspend();
+
+  /**
+   * Continues a suspended run on cores it takes again, which may differ from the ones it had.
+   * @return false if there are not enough free cores at the moment
+   */
+  bool resume();
+
+  /**
+   * @return Time the run ran, without the time it was suspended
+   */
+  Dur wall_time(TimePoint now) const;
+
 private:
-  Run(Archive::BorrowedReport&& borrowedReport, Archive::ReportID reportID, Archive::Archive& archive, Workspace::SharedWorkspace& workspace);
-  Archive::BorrowedReport borrowReport() {return archive.borrow_report(reportID);}
-  void prepareStdOutputFiles();
+  Archive::BorrowedReport borrowReport() {return Archive::Archive::borrow(report);}
+
+  /// Kills what is left of the process once it ended or cannot be monitored
+  void stop(const String& debug_message);
+  static void read_new_output(const String& fileName, std::streamoff& offset, String& chunk);
 };
 
+using SharedRun = std::shared_ptr<Run>;
+
+/**
+ * Process-wide threads that finalise the reports of ended runs (read the outputs, run the output parser),
+ * so that a run with a large output does not hold up the monitoring of the other runs.
+ * Jobs are taken in the order they were submitted.
+ */
+class Finaliser {
+public:
+  static const Nat threadCount = 2;
+
+  static Finaliser& instance();
+
+  Finaliser(const Finaliser& other) = delete;
+  Finaliser& operator=(const Finaliser& other) = delete;
+  ~Finaliser();
+
+  void submit(std::function<void()>&& job);
+
+private:
+  Finaliser();
+  void serve();
+
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::deque<std::function<void()>> jobs;
+  bool stopping;
+  std::vector<std::thread> threads;
+};
+
+/**
+ * Runs are monitored without the window's lock, in shards spread over Monitor::ShardPool;
+ * the lock only guards the list of runs. A run on a worker agent is monitored like a local one,
+ * the agent streams its output into the run directory (see Remote::Assignment). Ended runs leave the window and are finalised by the Finaliser,
+ * their reports go from running to finalising to valid.
+ */
 struct ExecutionWindow {
   mutable std::recursive_mutex mutex;
-  std::list<Run> running;
-  Nat currentTtime, previousTtime;
+  std::list<SharedRun> running;
+  Monitor::HostSampler hostSampler; // CPU time and free memory of the host, sampled once per update_stats()
   Dur monitorTimeout;
 
-  ExecutionWindow() : currentTtime(0), monitorTimeout(1min) { update_ttime(); }
+  ExecutionWindow() : monitorTimeout(1min), finalising(0) { }
+  ~ExecutionWindow(); // Keeps the directories of held runs, waits for the window's runs that are being finalised
+
+  /**
+   * Starts the job on this node with the allocation, or on a worker agent if the slot is set.
+   * Throws std::runtime_error.
+   */
+  void start_new_run(const Scheduler::Job& job, Archive::Archive& archive, Scheduler::Allocation&& allocation,
+                     Remote::Slot&& slot = Remote::Slot());
 
-  void update_ttime();
-  void start_new_run(Archive::ReportID report, Archive::Archive& archive, Workspace::SharedWorkspace workspace,
-                    const String& call_schema);
+  /**
+   * Monitors a run started by an earlier server, as recorded when it was started. The job's report has to be
+   * restored (see Archive::restore_report()); its outputs are read again from the start.
+   */
+  void adopt_run(const Scheduler::Job& job, Archive::Archive& archive, Launcher::Process&& process, const RunRecord& record,
+                 Scheduler::Allocation&& allocation);
   void update_stats();
   bool empty() const  {std::lock_guard<decltype(mutex)> lockGuard(mutex); return running.empty(); }
   size_t size() const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return running.size(); }
   bool kill_process(Nat pid);
+  void kill_group(const Portfolio::SharedGroup& group, const String& debug_message);
+
+  /**
+   * Suspends preemptible runs of priority at most maxPriority, lowest priority and latest started first,
+   * until they lent at least cores cores.
+   * @return Number of cores lent
+   */
+  Nat suspend_runs(Nat cores, int maxPriority);
+
+  /**
+   * Resumes suspended runs, highest priority and earliest started first, while there are free cores for them.
+   */
+  void resume_runs();
+  bool has_suspended() const;
+
+private:
+  void finalise(const SharedRun& run);
+
+  std::mutex finalisingMutex;
+  std::condition_variable finalisingDone;
+  Nat finalising; // Runs of the window handed to the Finaliser and not finalised yet
 };
 
 }
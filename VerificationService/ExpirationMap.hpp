@@ -21,26 +21,50 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
-#include <condition_variable>
+#include <cstdint>
 #include <experimental/optional>
 #include <functional>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <set>
-#include <thread>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "Timers.h"
 
 
 namespace ExpirationMap {
   using Duration = std::chrono::duration<long, std::ratio<1,1000>>;
   using TimePoint = std::chrono::steady_clock::time_point;
 
-  template<typename K, typename V>
-  class ExpirationMap : public std::enable_shared_from_this<ExpirationMap<K, V>> {
+  /// Granularity of expiration times of a map that is not given another one
+  const Duration defaultTick = std::chrono::milliseconds{100};
+
+  /**
+   * Map of items that expire unless they are kept alive.
+   *
+   * Expiration times are kept in a hierarchical timing wheel: wheelLevels levels of wheelSlots slots, a slot of level l
+   * spans wheelSlots^l ticks. An item sits in the slot of its expiration time on the lowest level that reaches that far
+   * and moves one level down each time the wheel reaches its slot. Inserting, keeping alive and erasing an item take
+   * constant time (the item is moved between slot lists), pop_expired() takes time proportional to the expired items
+   * and the ticks since it was called last. Expiration times are rounded up to whole ticks, so an item expires
+   * up to one tick late and items that expire within one tick are popped as one batch; keeping an item alive
+   * again within the same tick does not move it at all.
+   */
+  template<typename K, typename V, typename Hash = std::hash<K>>
+  class ExpirationMap : public std::enable_shared_from_this<ExpirationMap<K, V, Hash>> {
   public:
     using ExpiredValues = std::map<K, V>;
     
-    ExpirationMap() {}
+    explicit ExpirationMap(Duration tick = defaultTick) :
+        tick(std::max(tick, Duration{1})),
+        origin(std::chrono::steady_clock::now()),
+        currentTick(0) {}
     ExpirationMap(const ExpirationMap& other) = delete;
     ExpirationMap(ExpirationMap&& other) = delete;
 
@@ -52,19 +76,10 @@ namespace ExpirationMap {
      */
     void insert(const K& key, const V& value, Duration duration) {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-//      TimePoint expirationTime = std::chrono::steady_clock::now() + expiration;
-      auto valIt = expirableItems.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value, expirableTimes.end()));
+      auto valIt = items.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value));
       if (!valIt.second) {
-        // cppreference.com: The element may be constructed even if there already is an element with the key in the container, in which case the newly constructed element will be destroyed immediately.
         throw std::runtime_error("Attempt to replace a key in ExpirationMap. Not implemented yet."); // TODO: implement if needed
       }
-//      if (valIt.second) {
-//        // The value was already present, delete old expiration time:
-//        expirableTimes.erase(valIt.first->second.expirationTimeIt);
-//      }
-//      // Update expiration time:
-//      auto timeIt = expirableTimes.emplace(expirationTime, &(valIt.first->first));
-//      valIt.first->second.expirationTimeIt = timeIt;
       keepAlive_nomutex(valIt.first, duration);
     }
     
@@ -74,7 +89,7 @@ namespace ExpirationMap {
      */
     void erase(const K& key) {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      auto itemIt = expirableItems.find(key);
+      auto itemIt = items.find(key);
       erase_nomutex(itemIt);
     }
     
@@ -85,8 +100,8 @@ namespace ExpirationMap {
      */
     typename std::experimental::optional<V> get(const K& key) {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      auto it = expirableItems.find(key);
-      if (it != expirableItems.end()) {
+      auto it = items.find(key);
+      if (it != items.end()) {
         return std::experimental::make_optional(it->second.value);
       }
       return {};
@@ -100,22 +115,46 @@ namespace ExpirationMap {
      */
     typename std::experimental::optional<V> get(const K& key, Duration expirationDuration) {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      auto itemIt = expirableItems.find(key);
+      auto itemIt = items.find(key);
       if (keepAlive_nomutex(itemIt, expirationDuration)) {
         return std::experimental::make_optional(itemIt->second.value);
       }
       return {};
     }
+
+    /**
+     * Get stored element. If the item exists, reset expiration to now() + the duration the item was inserted
+     * or last kept alive with; one lookup for the usual "use and keep alive"
+     * @param key
+     * @return 
+     */
+    typename std::experimental::optional<V> getAndKeepAlive(const K& key) {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      auto itemIt = items.find(key);
+      if (itemIt == items.end())
+        return {};
+      keepAlive_nomutex(itemIt, itemIt->second.duration);
+      return std::experimental::make_optional(itemIt->second.value);
+    }
     
     /**
-     * The nearest TimePoint at which an item will expire (can be in the past if the map contains expired items)
+     * A time not later than the nearest expiration: the start of the first non-empty slot of the wheel
+     * (can be in the past if the map contains expired items)
      * @return 
      */
     const TimePoint getNextExpirationTime() {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      if (expirableTimes.empty())
+      if (items.empty())
         return TimePoint::max();
-      return expirableTimes.begin()->expirationTime;
+      for (size_t level = 0; level < wheelLevels; level++) {
+        const unsigned shift = slotBits * level;
+        for (uint64_t step = 1; step <= wheelSlots; step++) {
+          uint64_t slotStart = ((currentTick >> shift) + step) << shift;
+          if (!wheel[level][(slotStart >> shift) & slotMask].empty())
+            return time_of(level == 0 ? slotStart : std::max(slotStart, currentTick + 1));
+        }
+      }
+      return time_of(currentTick + 1);
     }
     
     /**
@@ -126,7 +165,7 @@ namespace ExpirationMap {
      */
     bool keepAlive(const K& key, Duration dur) {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      auto itemIt = expirableItems.find(key);
+      auto itemIt = items.find(key);
       return keepAlive_nomutex(itemIt, dur);
     }
 
@@ -137,47 +176,85 @@ namespace ExpirationMap {
     ExpiredValues pop_expired() {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
       ExpiredValues expired;
-      auto endIt = expirableTimes.upper_bound({std::chrono::steady_clock::now(), {}}); // TODO: optimize constructor overhead
-      for (auto it = expirableTimes.begin(); it != endIt; ) {
-        const K& key = *(it->itemKey);
-        ++it; // advance to next expirableTime before deletion of the current one
-        auto itemIt = expirableItems.find(key);
-        expired.insert({key, std::move(itemIt->second.value)});
-        erase_nomutex(itemIt);
+      const uint64_t target = ticks_since_origin(std::chrono::steady_clock::now());
+      while (currentTick < target) {
+        if (items.empty()) { // Nothing to cascade or expire, the wheel may skip ahead
+          currentTick = target;
+          break;
+        }
+        currentTick++;
+        // Slots of the higher levels that start at this tick move their items down:
+        for (size_t level = 1; level < wheelLevels && (currentTick & ((uint64_t(1) << (slotBits * level)) - 1)) == 0; level++) {
+          Slot& slot = wheel[level][(currentTick >> (slotBits * level)) & slotMask];
+          while (!slot.empty())
+            place_nomutex(*slot.front());
+        }
+        Slot& due = wheel[0][currentTick & slotMask];
+        while (!due.empty()) {
+          auto itemIt = items.find(due.front()->first);
+          expired.emplace(itemIt->first, std::move(itemIt->second.value));
+          erase_nomutex(itemIt);
+        }
       }
       return expired;
     }
 
+    size_t size() const {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      return items.size();
+    }
 
   private:
-    struct ExpirableTime {
-      ExpirableTime(const TimePoint& expirationTime, const K* itemKey) :
-          expirationTime(expirationTime), itemKey(itemKey) {}
-      TimePoint expirationTime;
-      const K* itemKey;
-    };
-    struct ExpirableTimeComparator {
-      bool operator()(const ExpirableTime& lhs, const ExpirableTime& rhs) const {
-        return lhs.expirationTime < rhs.expirationTime;
-      }
-    };
-    using ExpirableTimes = typename std::multiset<ExpirableTime, ExpirableTimeComparator>;
+    static constexpr unsigned slotBits = 6;
+    static constexpr uint64_t wheelSlots = uint64_t(1) << slotBits;
+    static constexpr uint64_t slotMask = wheelSlots - 1;
+    static constexpr size_t wheelLevels = 4; // 2^24 ticks, almost 20 days with the default tick; later items wait on the last level
+    static constexpr uint64_t maxDelta = (uint64_t(1) << (slotBits * wheelLevels)) - 1;
+
+    struct ExpirableValue;
+    using ExpirableItems = typename std::unordered_map<K, ExpirableValue, Hash>; // Nodes never move, the slots point to them
+    using Slot = std::list<std::pair<const K, ExpirableValue>*>; // Elements of items
 
     struct ExpirableValue {
-      ExpirableValue(const V& value, const typename ExpirableTimes::iterator& expirationTime) :
-          value(value), expirationTimeIt(expirationTime) {}
+      ExpirableValue(const V& value) : value(value), duration(0), expirationTick(0), slot(nullptr) {}
       V value;
-      typename ExpirableTimes::iterator expirationTimeIt;
+      Duration duration;        // Kept alive for this long (see getAndKeepAlive())
+      uint64_t expirationTick;
+      Slot* slot;               // The slot the item waits in, nullptr before it is placed
+      typename Slot::iterator position;
     };
-    using ExpirableItems = typename std::map<K, ExpirableValue>;
 
-  private:
+    uint64_t ticks_since_origin(TimePoint time) const {
+      return time <= origin ? 0 : std::chrono::duration_cast<Duration>(time - origin).count() / tick.count();
+    }
+
+    TimePoint time_of(uint64_t tickNumber) const {
+      return origin + tick * tickNumber;
+    }
+
     void erase_nomutex(typename ExpirableItems::iterator itemIt) {
-      if (itemIt == expirableItems.end())
+      if (itemIt == items.end())
         return;
-      auto timeIt = itemIt->second.expirationTimeIt;
-      expirableTimes.erase(timeIt);
-      expirableItems.erase(itemIt);
+      itemIt->second.slot->erase(itemIt->second.position);
+      items.erase(itemIt);
+    }
+
+    /**
+     * Moves the item to the slot of its expiration time, relative to the current tick
+     */
+    void place_nomutex(typename ExpirableItems::value_type& item) {
+      ExpirableValue& expirable = item.second;
+      const uint64_t expiration = std::max(expirable.expirationTick, currentTick + 1);
+      const uint64_t delta = std::min(expiration - currentTick, maxDelta);
+      size_t level = 0;
+      while (level + 1 < wheelLevels && delta >> (slotBits * (level + 1)) != 0)
+        level++;
+      Slot& slot = wheel[level][((currentTick + delta) >> (slotBits * level)) & slotMask];
+      if (expirable.slot)
+        slot.splice(slot.end(), *expirable.slot, expirable.position);
+      else
+        expirable.position = slot.insert(slot.end(), &item);
+      expirable.slot = &slot;
     }
 
     /**
@@ -187,29 +264,89 @@ namespace ExpirationMap {
      * @return true if item exists
      */
     bool keepAlive_nomutex(typename ExpirableItems::iterator itemIt, Duration dur) {
-      if (itemIt != expirableItems.end()) {
-        TimePoint expirationTime = std::chrono::steady_clock::now() + dur;
-        auto expirationTimeIt = itemIt->second.expirationTimeIt;
-        if (expirationTimeIt != expirableTimes.end()) {
-          expirableTimes.erase(expirationTimeIt);
-        }
-        expirationTimeIt = expirableTimes.emplace(expirationTime, &(itemIt->first));
-        itemIt->second.expirationTimeIt = expirationTimeIt;
+      if (itemIt == items.end())
+        return false;
+      TimePoint expirationTime = std::chrono::steady_clock::now() + dur;
+      uint64_t expirationTick = ticks_since_origin(expirationTime) + 1; // Rounded up
+      ExpirableValue& expirable = itemIt->second;
+      expirable.duration = dur;
+      if (expirable.slot && expirable.expirationTick == expirationTick)
         return true;
-      }
-      return false;
+      expirable.expirationTick = expirationTick;
+      place_nomutex(*itemIt);
+      return true;
     }
     
     mutable std::mutex mutex;
-    ExpirableItems expirableItems;
-    ExpirableTimes expirableTimes;
+    const Duration tick;
+    const TimePoint origin; // Tick 0
+    uint64_t currentTick;   // The wheel expired the items of all ticks up to this one
+    ExpirableItems items;
+    std::array<std::array<Slot, wheelSlots>, wheelLevels> wheel;
   };
 
-  template <typename K, typename V>
+  /**
+   * ExpirationMap split into shards by the hash of the key, each with its own lock,
+   * for maps used by many threads at once. Expired items are popped from all shards.
+   */
+  template<typename K, typename V, size_t Shards = 16, typename Hash = std::hash<K>>
+  class ShardedExpirationMap {
+  public:
+    using Shard = ExpirationMap<K, V, Hash>;
+    using ExpiredValues = typename Shard::ExpiredValues;
+
+    explicit ShardedExpirationMap(Duration tick = defaultTick) {
+      for (auto& shard : shards)
+        shard.reset(new Shard(tick));
+    }
+    ShardedExpirationMap(const ShardedExpirationMap& other) = delete;
+    ShardedExpirationMap(ShardedExpirationMap&& other) = delete;
+
+    void insert(const K& key, const V& value, Duration duration) { shard(key).insert(key, value, duration); }
+    void erase(const K& key) { shard(key).erase(key); }
+    typename std::experimental::optional<V> get(const K& key) { return shard(key).get(key); }
+    typename std::experimental::optional<V> get(const K& key, Duration expirationDuration) { return shard(key).get(key, expirationDuration); }
+    typename std::experimental::optional<V> getAndKeepAlive(const K& key) { return shard(key).getAndKeepAlive(key); }
+    bool keepAlive(const K& key, Duration dur) { return shard(key).keepAlive(key, dur); }
+
+    const TimePoint getNextExpirationTime() {
+      TimePoint next = TimePoint::max();
+      for (auto& shard : shards)
+        next = std::min(next, shard->getNextExpirationTime());
+      return next;
+    }
+
+    ExpiredValues pop_expired() {
+      ExpiredValues expired;
+      for (auto& shard : shards) {
+        ExpiredValues shardExpired = shard->pop_expired();
+        expired.insert(std::make_move_iterator(shardExpired.begin()), std::make_move_iterator(shardExpired.end()));
+      }
+      return expired;
+    }
+
+    size_t size() const {
+      size_t result = 0;
+      for (const auto& shard : shards)
+        result += shard->size();
+      return result;
+    }
+
+  private:
+    Shard& shard(const K& key) { return *shards[Hash()(key) % Shards]; }
+
+    std::array<std::unique_ptr<Shard>, Shards> shards;
+  };
+
+  /**
+   * Pops the expired items of a map periodically, on the process-wide Timers::TimerService.
+   * Parks while the map is empty, wake() it after inserting into the map.
+   */
+  template <typename K, typename V, typename Map = ExpirationMap<K,V>>
   class PeriodicExpirator {
     public:
-      using SharedExpirationMap = std::shared_ptr<ExpirationMap<K,V>>;
-      using ExpirationCallback = std::function<void(std::map<K,V>&&)>; // TODO: use defined types
+      using SharedExpirationMap = std::shared_ptr<Map>;
+      using ExpirationCallback = std::function<void(typename Map::ExpiredValues&&)>;
       /**
        * 
        * @param sharedExpirationMap The set to check for expired elements
@@ -219,45 +356,36 @@ namespace ExpirationMap {
       PeriodicExpirator(SharedExpirationMap sharedExpirationMap, Duration checkInterval, ExpirationCallback callback) :
               sharedExpirationMap(sharedExpirationMap),
               checkInterval(checkInterval),
-              stopFlag(false),
-              callback(callback),
-              worker(std::bind(&PeriodicExpirator::workerLoop, this)) {
+              callback(callback) {
         if (!this->callback)
           throw std::runtime_error("Invalid callback supplied");
+        // The check may be late by half the interval to share a wake-up with other periodic work:
+        task = Timers::TimerService::instance().schedule(checkInterval, [this] () { return expire(); }, checkInterval / 2);
       }
       virtual ~PeriodicExpirator() {
-        stopWorker();
+        Timers::TimerService::instance().cancel(task);
       }
 
-    private:
-      void workerLoop() {
-        std::unique_lock<decltype(mutex)> lock(mutex);
-        while (!stopFlag) {
-          // Check if there are expired values in the expiration set:
-          if(sharedExpirationMap->getNextExpirationTime() <= std::chrono::steady_clock::now()) {
-            callback(std::move(sharedExpirationMap->pop_expired()));
-          }
-          stopCondition.wait_for(lock, checkInterval);
-        }
+      /**
+       * Checks the map periodically again if it parked
+       */
+      void wake() {
+        Timers::TimerService::instance().wake(task);
       }
-      
-      void stopWorker(bool waitUntilStopped = true) {
-        {
-          std::lock_guard<decltype(mutex)> lockGuard(mutex);
-          stopFlag = true;
-          stopCondition.notify_one();
-        }
-        if (waitUntilStopped)
-          worker.join(); // Wait for the thread 
+
+    private:
+      bool expire() {
+        // Popping is cheap when nothing expired, the wheel only advances:
+        typename Map::ExpiredValues expired = sharedExpirationMap->pop_expired();
+        if (!expired.empty())
+          callback(std::move(expired));
+        return sharedExpirationMap->size() > 0;
       }
       
-      mutable std::mutex mutex;
       SharedExpirationMap sharedExpirationMap;
       Duration checkInterval;
-      bool stopFlag;
       ExpirationCallback callback;
-      std::condition_variable stopCondition;
-      std::thread worker;
+      Timers::TaskID task;
   };
   
 } // namespace
@@ -0,0 +1,208 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Launcher.cpp
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Launcher.h"
+#include "subprocess.hpp"
+
+extern char** environ;
+
+namespace Launcher {
+
+namespace {
+
+/// Shared by the parent and the child, which runs in the parent's memory until exec
+struct ChildSetup {
+  const char* path;
+  char* const* argv;
+  const char* workingDirectory;
+  int in, out, err;
+  const Affinity::CoreSet* cores;
+  sigset_t signalMask;
+  volatile int error;
+  const char* volatile failedStep;
+};
+
+/// Runs in the child on its own small stack; only system calls from here on.
+int child_main(void* argument) {
+  ChildSetup* setup = static_cast<ChildSetup*>(argument);
+  // The server's signal handlers must not run in the child, they would share the server's memory:
+  struct sigaction defaultAction;
+  memset(&defaultAction, 0, sizeof(defaultAction));
+  defaultAction.sa_handler = SIG_DFL;
+  for (int signal = 1; signal < NSIG; signal++)
+    sigaction(signal, &defaultAction, nullptr);
+  setpgid(0, 0);
+  if (chdir(setup->workingDirectory) != 0 ||
+      dup2(setup->in, STDIN_FILENO) < 0 || dup2(setup->out, STDOUT_FILENO) < 0 || dup2(setup->err, STDERR_FILENO) < 0) {
+    setup->error = errno;
+    setup->failedStep = "prepare";
+    _exit(127);
+  }
+  if (setup->cores)
+    setup->cores->apply();
+  sigprocmask(SIG_SETMASK, &setup->signalMask, nullptr);
+  execve(setup->path, setup->argv, environ);
+  setup->error = errno;
+  setup->failedStep = "execute";
+  _exit(127);
+}
+
+/// Finds the executable like execvp would, but before the child is created
+String resolve_executable(const String& name) {
+  if (name.find('/') != String::npos)
+    return name; // Relative paths are resolved against the working directory of the child
+  const char* path = getenv("PATH");
+  Strings directories;
+  bbb::split_by(path ? path : "/usr/local/bin:/usr/bin:/bin", directories, ":");
+  for (const String& directory : directories) {
+    String candidate = (directory.empty() ? "." : directory) + "/" + name;
+    if (access(candidate.c_str(), X_OK) == 0)
+      return candidate;
+  }
+  return "";
+}
+
+}
+
+FileDescriptor::~FileDescriptor() {
+  if (fd >= 0)
+    close(fd);
+}
+
+Process::Process() : processID(-1), reaper(nullptr), returnCode(-1), finished(true) { }
+
+Process::Process(pid_t pid, const std::shared_ptr<Reaper>& reaper) : processID(pid), reaper(reaper), returnCode(-1), finished(false) { }
+
+Process::Process(Process&& other) noexcept : Process() {
+  *this = std::move(other);
+}
+
+Process& Process::operator=(Process&& other) noexcept {
+  processID = other.processID;
+  reaper = std::move(other.reaper);
+  returnCode = other.returnCode;
+  finished = other.finished;
+  other.processID = -1;
+  other.finished = true;
+  return *this;
+}
+
+int Process::poll() {
+  if (finished)
+    return returnCode;
+  int status;
+  pid_t result = (reaper ? reaper->wait(processID, &status) : waitpid(processID, &status, WNOHANG));
+  if (result == 0)
+    return -2;
+  finished = true;
+  if (result == processID) {
+    if (WIFSIGNALED(status))
+      returnCode = WTERMSIG(status);
+    else if (WIFEXITED(status))
+      returnCode = WEXITSTATUS(status);
+    else
+      returnCode = 255;
+  }
+  else {
+    returnCode = 0; // SIGCHLD is ignored or the child was collected elsewhere, its status is lost
+  }
+  return returnCode;
+}
+
+void Reaper::kill(pid_t pid, int signal) {
+  kill_group(pid, signal);
+}
+
+void Process::kill(int signal) {
+  if (processID <= 0 || finished)
+    return;
+  if (reaper)
+    reaper->kill(processID, signal);
+  else
+    kill_group(processID, signal);
+}
+
+Process spawn(const Request& request) {
+  String path;
+  Strings arguments;
+  parse_command(request.command, path, arguments);
+  FileDescriptor in(open("/dev/null", O_RDONLY | O_CLOEXEC));
+  if (in.fd < 0)
+    throw LaunchError(String("Cannot open /dev/null: ") + strerror(errno));
+  FileDescriptor out(open_output(request.outFileName));
+  FileDescriptor err(open_output(request.errFileName));
+  return Process(start(path, arguments, request.workingDirectory, in.fd, out.fd, err.fd, request.cores));
+}
+
+void kill_group(pid_t pid, int signal) {
+  if (::kill(-pid, signal) != 0)
+    ::kill(pid, signal);
+}
+
+void parse_command(const String& command, String& path, Strings& arguments) {
+  try {
+    arguments = subprocess::util::split_wordexp(command);
+  }
+  catch (const subprocess::OSError& e) {
+    throw LaunchError("Cannot parse command \"" + command + "\"");
+  }
+  if (arguments.empty())
+    throw LaunchError("Empty command");
+  path = resolve_executable(arguments[0]);
+  if (path.empty())
+    throw LaunchError("Executable not found: " + arguments[0]);
+}
+
+int open_output(const String& fileName) {
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw LaunchError("Cannot open " + fileName + ": " + strerror(errno));
+  return fd;
+}
+
+pid_t start(const String& path, Strings& arguments, const String& workingDirectory, int in, int out, int err,
+            const Affinity::CoreSet* cores) {
+  std::vector<char*> argv;
+  for (String& argument : arguments)
+    argv.push_back(&argument[0]);
+  argv.push_back(nullptr);
+
+  ChildSetup setup{path.c_str(), argv.data(), workingDirectory.c_str(), in, out, err, cores, {}, 0, nullptr};
+  std::vector<char> stack(64 * 1024); // The parent is suspended until the child calls exec, so its stack may live here
+
+  sigset_t allSignals;
+  sigfillset(&allSignals);
+  pthread_sigmask(SIG_SETMASK, &allSignals, &setup.signalMask); // No handler may run in the child before it resets them
+  pid_t pid = clone(child_main, stack.data() + stack.size(), CLONE_VM | CLONE_VFORK | SIGCHLD, &setup);
+  int cloneError = errno;
+  pthread_sigmask(SIG_SETMASK, &setup.signalMask, nullptr);
+
+  if (pid < 0)
+    throw LaunchError(String("Cannot create process: ") + strerror(cloneError));
+  if (setup.error != 0) {
+    waitpid(pid, nullptr, 0);
+    throw LaunchError(String("Cannot ") + setup.failedStep + " " + path + " in " + workingDirectory + ": " + strerror(setup.error));
+  }
+  return pid;
+}
+
+}
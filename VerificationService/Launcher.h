@@ -0,0 +1,149 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Launcher.h
+ */
+
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+
+#include "bbb.h"
+#include "Affinity.h"
+
+namespace Launcher {
+
+using namespace Basics;
+
+class LaunchError : public std::runtime_error {
+public:
+  LaunchError(const std::string& __arg) : runtime_error(__arg) { }
+};
+
+/**
+ * Closes the descriptor on destruction
+ */
+struct FileDescriptor {
+  int fd;
+  FileDescriptor(int fd) : fd(fd) {}
+  FileDescriptor(const FileDescriptor& other) = delete;
+  FileDescriptor& operator=(const FileDescriptor& other) = delete;
+  ~FileDescriptor();
+};
+
+/**
+ * Everything needed to start a verification process
+ */
+struct Request {
+  String command;          // Split into arguments like a shell would, without running a shell
+  String workingDirectory;
+  String outFileName;      // Standard output, truncated on start
+  String errFileName;      // Error output, truncated on start
+  const Affinity::CoreSet* cores = nullptr; // Cores to bind the process to, nullptr to inherit
+  String tag;              // Kept with the process by a supervisor for a restarted server (see Zygote::held())
+};
+
+/**
+ * Collects the exit status of processes that were started by another process (see Zygote),
+ * or of work done by a process shared by several runs (see SolverPool)
+ */
+class Reaper {
+public:
+  virtual ~Reaper() {}
+
+  /**
+   * Same contract as waitpid(pid, status, WNOHANG): 0 while the process runs, pid once it ended, -1 on error
+   */
+  virtual pid_t wait(pid_t pid, int* status) = 0;
+
+  /**
+   * Sends the signal to the process group, unless the reaper knows better
+   */
+  virtual void kill(pid_t pid, int signal);
+};
+
+/**
+ * A started process. The process leads its own process group, signals are sent to the whole group
+ * so that tools started through wrapper scripts are reached too.
+ */
+class Process {
+public:
+  Process();
+  /**
+   * @param reaper Collects the exit status if the process is not a child of this process, nullptr otherwise
+   */
+  explicit Process(pid_t pid, const std::shared_ptr<Reaper>& reaper = nullptr);
+  Process(const Process& other) = delete;
+  Process(Process&& other) noexcept;
+  Process& operator=(const Process& other) = delete;
+  Process& operator=(Process&& other) noexcept;
+
+  pid_t pid() const { return processID; }
+
+  /**
+   * Collects the exit status if the process ended.
+   * @return -2 while the process is running, its return code otherwise (the signal number if it was killed)
+   */
+  int poll();
+
+  /**
+   * @return The return code once poll() reported the end of the process, -1 before
+   */
+  int retcode() const { return returnCode; }
+
+  void kill(int signal);
+
+private:
+  pid_t processID;
+  std::shared_ptr<Reaper> reaper;
+  int returnCode;
+  bool finished;
+};
+
+/**
+ * Starts a process without copying the server's address space: the child shares the server's memory
+ * (clone with CLONE_VM | CLONE_VFORK) until it calls exec, so the cost does not grow with the server's size.
+ * The output files and the executable are prepared before the child is created, the child only
+ * changes directory, redirects the descriptors, binds itself to its cores and calls exec.
+ * Throws LaunchError if the process cannot be started.
+ * Does not take any lock; safe to call from any thread.
+ */
+Process spawn(const Request& request);
+
+/**
+ * Sends the signal to the process group led by pid (to the process alone if it does not lead one)
+ */
+void kill_group(pid_t pid, int signal);
+
+/**
+ * Splits the command into arguments and finds the executable in PATH unless the command names a path.
+ * Throws LaunchError.
+ */
+void parse_command(const String& command, String& path, Strings& arguments);
+
+/**
+ * Opens (creates, truncates) a file for the output of a process; the descriptor is closed on exec.
+ * Throws LaunchError.
+ */
+int open_output(const String& fileName);
+
+/**
+ * The part of spawn() after the command was parsed and the descriptors were opened.
+ * The descriptors stay open in the caller. Throws LaunchError.
+ * @return Process ID of the child
+ */
+pid_t start(const String& path, Strings& arguments, const String& workingDirectory, int in, int out, int err,
+            const Affinity::CoreSet* cores);
+
+}
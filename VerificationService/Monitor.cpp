@@ -0,0 +1,215 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Monitor.cpp
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+#include "Monitor.h"
+
+namespace Monitor {
+
+const size_t ProcFile::bufferSize;
+const size_t ShardPool::shardSize;
+
+namespace {
+
+/// Skips count space-separated fields
+const char* skip_fields(const char* p, int count) {
+  for (int i = 0; i < count && *p; i++) {
+    while (*p == ' ')
+      p++;
+    while (*p && *p != ' ')
+      p++;
+  }
+  while (*p == ' ')
+    p++;
+  return p;
+}
+
+unsigned long long parse_number(const char*& p) {
+  char* end;
+  unsigned long long value = strtoull(p, &end, 10);
+  p = end;
+  return value;
+}
+
+}
+
+ProcFile::ProcFile(const String& path) : fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+  buffer[0] = '\0';
+}
+
+ProcFile::~ProcFile() {
+  if (fd >= 0)
+    close(fd);
+}
+
+const char* ProcFile::read() {
+  if (fd < 0)
+    return nullptr;
+  ssize_t size;
+  do {
+    size = pread(fd, buffer, bufferSize, 0);
+  } while (size < 0 && errno == EINTR);
+  if (size <= 0)
+    return nullptr;
+  buffer[size] = '\0';
+  return buffer;
+}
+
+
+ProcessReader::ProcessReader(pid_t pid) : file("/proc/" + std::to_string(pid) + "/stat") { }
+
+bool ProcessReader::sample(ProcessSample& result) {
+  const char* content = file.read();
+  return content && parse(content, result);
+}
+
+bool ProcessReader::parse(const char* content, ProcessSample& result) {
+  const char* p = strrchr(content, ')');
+  if (!p || p[1] != ' ' || !p[2])
+    return false;
+  p += 2;
+  result.state = *p;                 // Field 3
+  p = skip_fields(p, 11);            // Fields 3 to 13
+  result.utime = parse_number(p);    // Field 14
+  result.stime = parse_number(p);    // Field 15
+  p = skip_fields(p, 7);             // Fields 16 to 22
+  result.vsize = parse_number(p);    // Field 23
+  result.rss = parse_number(p);      // Field 24
+  return true;
+}
+
+
+StorageReader::StorageReader(pid_t pid) : file("/proc/" + std::to_string(pid) + "/io") { }
+
+bool StorageReader::sample(unsigned long long& written) {
+  const char* content = file.read();
+  return content && parse(content, written);
+}
+
+bool StorageReader::parse(const char* content, unsigned long long& written) {
+  const char* bytes = strstr(content, "\nwrite_bytes: ");
+  const char* cancelled = strstr(content, "\ncancelled_write_bytes: ");
+  if (!bytes || !cancelled)
+    return false;
+  bytes += strlen("\nwrite_bytes: ");
+  cancelled += strlen("\ncancelled_write_bytes: ");
+  unsigned long long total = parse_number(bytes);
+  unsigned long long dropped = parse_number(cancelled);
+  written = (total > dropped ? total - dropped : 0);
+  return true;
+}
+
+
+HostSampler::HostSampler() : stat("/proc/stat") {
+  sample();
+}
+
+const HostSample& HostSampler::sample() {
+  current.previousTotalTime = current.totalTime;
+  const char* content = stat.read();
+  if (content && strncmp(content, "cpu ", 4) == 0) {
+    const char* p = content + 4;
+    unsigned long long total = 0;
+    while (*p && *p != '\n') {
+      const char* number = p;
+      total += parse_number(p);
+      if (p == number)
+        break;
+    }
+    current.totalTime = total;
+  }
+  struct sysinfo info;
+  if (sysinfo(&info) == 0 && info.totalram > 0) {
+    unsigned long long freeRam = static_cast<unsigned long long>(info.freeram) * info.mem_unit;
+    unsigned long long totalRam = static_cast<unsigned long long>(info.totalram) * info.mem_unit;
+    current.memFreeMB = freeRam >> 20;
+    current.memFreePercent = freeRam / std::max(1ULL, totalRam / 100);
+  }
+  return current;
+}
+
+
+ShardPool& ShardPool::instance() {
+  static ShardPool pool(std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+  return pool;
+}
+
+ShardPool::ShardPool(Nat count) : stopping(false) {
+  for (Nat i = 0; i < count; i++)
+    threads.emplace_back(&ShardPool::serve, this);
+}
+
+ShardPool::~ShardPool() {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+void ShardPool::for_each(size_t count, const std::function<void(size_t)>& work) {
+  if (count <= shardSize) {
+    for (size_t i = 0; i < count; i++)
+      work(i);
+    return;
+  }
+  Batch batch;
+  batch.work = &work;
+  batch.count = count;
+  batch.remaining = (count + shardSize - 1) / shardSize;
+  std::unique_lock<decltype(mutex)> lock(mutex);
+  batches.push_back(&batch);
+  wakeUp.notify_all();
+  while (work_on(batch, lock))
+    ;
+  batch.finished.wait(lock, [&batch] () { return batch.remaining == 0; });
+}
+
+void ShardPool::serve() {
+  std::unique_lock<decltype(mutex)> lock(mutex);
+  for (;;) {
+    wakeUp.wait(lock, [this] () { return stopping || !batches.empty(); });
+    if (stopping)
+      return;
+    work_on(*batches.front(), lock);
+  }
+}
+
+bool ShardPool::work_on(Batch& batch, std::unique_lock<std::mutex>& lock) {
+  if (batch.next >= batch.count)
+    return false;
+  size_t begin = batch.next;
+  size_t end = std::min(batch.count, begin + shardSize);
+  batch.next = end;
+  if (batch.next >= batch.count) // No more shards to take, the batch stays alive until its owner saw it finish
+    batches.erase(std::find(batches.begin(), batches.end(), &batch));
+  lock.unlock();
+  for (size_t i = begin; i < end; i++)
+    (*batch.work)(i);
+  lock.lock();
+  if (--batch.remaining == 0)
+    batch.finished.notify_all();
+  return true;
+}
+
+}
@@ -0,0 +1,176 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Monitor.h
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#include "bbb.h"
+
+namespace Monitor {
+
+using namespace Basics;
+
+/**
+ * A small /proc file read through a descriptor that stays open between reads, into a fixed buffer.
+ * Reading allocates nothing, only the first bufferSize bytes of the file are read.
+ */
+class ProcFile {
+public:
+  static const size_t bufferSize = 1024;
+
+  ProcFile(const String& path);
+  ProcFile(const ProcFile& other) = delete;
+  ProcFile& operator=(const ProcFile& other) = delete;
+  ~ProcFile();
+
+  bool is_open() const { return fd >= 0; }
+
+  /**
+   * Reads the file from its beginning; the content is terminated by '\0'.
+   * @return The content, nullptr if the file cannot be read (e.g. the process ended)
+   */
+  const char* read();
+
+private:
+  int fd;
+  char buffer[bufferSize + 1];
+};
+
+/**
+ * Values of /proc/[pid]/stat (see proc(5)), fields counted from 1
+ */
+struct ProcessSample {
+  char state = '?';             // Field 3
+  unsigned long long utime = 0; // Field 14, clock ticks
+  unsigned long long stime = 0; // Field 15, clock ticks
+  unsigned long long vsize = 0; // Field 23, bytes
+  long long rss = 0;            // Field 24, pages
+};
+
+/**
+ * Samples one process
+ */
+class ProcessReader {
+public:
+  ProcessReader(pid_t pid);
+
+  /**
+   * @return false if the statistics cannot be read (the process does not exist any more)
+   */
+  bool sample(ProcessSample& result);
+
+  /**
+   * Parses the content of /proc/[pid]/stat. The fields are counted after the last ')', the name of the
+   * process (field 2) may contain spaces and parentheses.
+   */
+  static bool parse(const char* content, ProcessSample& result);
+
+private:
+  ProcFile file;
+};
+
+/**
+ * Bytes a process caused to be written to storage, from /proc/[pid]/io: write_bytes less cancelled_write_bytes
+ * (data truncated or deleted before it reached the disk). Includes the children the process reaped,
+ * not the ones still running.
+ */
+class StorageReader {
+public:
+  StorageReader(pid_t pid);
+
+  /**
+   * @return false if the statistics cannot be read (the process does not exist any more)
+   */
+  bool sample(unsigned long long& written);
+
+  static bool parse(const char* content, unsigned long long& written);
+
+private:
+  ProcFile file;
+};
+
+/**
+ * Values of the whole host, sampled once per monitoring tick and shared by all runs
+ */
+struct HostSample {
+  unsigned long long totalTime = 0;         // Clock ticks spent by all CPUs (the "cpu" line of /proc/stat)
+  unsigned long long previousTotalTime = 0; // totalTime of the previous tick
+  Nat memFreeMB = 0;
+  Nat memFreePercent = 0;
+};
+
+class HostSampler {
+public:
+  HostSampler();
+
+  /**
+   * Takes a new sample, the previous one becomes its predecessor
+   */
+  const HostSample& sample();
+  const HostSample& last() const { return current; }
+
+private:
+  ProcFile stat;
+  HostSample current;
+};
+
+/**
+ * Process-wide threads that monitor the runs of all execution windows in shards.
+ * The calling thread works on the shards too, so a small number of runs costs no hand-off.
+ */
+class ShardPool {
+public:
+  static const size_t shardSize = 32; // Runs sampled by one thread at a time
+
+  static ShardPool& instance();
+
+  ShardPool(const ShardPool& other) = delete;
+  ShardPool& operator=(const ShardPool& other) = delete;
+  ~ShardPool();
+
+  /**
+   * Calls work(i) for every i < count, in parallel for more than one shard. Returns when all calls returned.
+   */
+  void for_each(size_t count, const std::function<void(size_t)>& work);
+
+private:
+  struct Batch {
+    const std::function<void(size_t)>* work;
+    size_t count;
+    size_t next = 0;      // First index not taken yet
+    size_t remaining = 0; // Shards not finished yet
+    std::condition_variable finished;
+  };
+
+  ShardPool(Nat threads);
+  void serve();
+  /// Runs one shard of the batch; false if all its shards were taken. Needs the lock, releases it while working.
+  bool work_on(Batch& batch, std::unique_lock<std::mutex>& lock);
+
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::deque<Batch*> batches; // Batches with shards not taken yet
+  bool stopping;
+  std::vector<std::thread> threads;
+};
+
+}
@@ -0,0 +1,244 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   OutputParser.cpp
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "OutputParser.h"
+#include "subprocess.hpp"
+
+namespace OutputParser {
+
+const Nat Matcher::none;
+
+Matcher::Matcher(const Strings& patterns) {
+  const uint32_t absent = std::numeric_limits<uint32_t>::max();
+  transitions.assign(256, absent);
+  bestOutput.assign(1, none);
+
+  // Trie of the patterns:
+  for (Nat index = 0; index < patterns.size(); index++) {
+    uint32_t state = 0;
+    for (unsigned char c : patterns[index]) {
+      if (transitions[state * 256 + c] == absent) {
+        transitions[state * 256 + c] = bestOutput.size();
+        transitions.resize(transitions.size() + 256, absent);
+        bestOutput.push_back(none);
+      }
+      state = transitions[state * 256 + c];
+    }
+    bestOutput[state] = std::min(bestOutput[state], index);
+  }
+
+  // Failure links folded into the transition table (breadth first):
+  std::vector<uint32_t> failure(bestOutput.size(), 0);
+  std::deque<uint32_t> queue;
+  for (Nat c = 0; c < 256; c++) {
+    uint32_t& next = transitions[c];
+    if (next == absent)
+      next = 0;
+    else
+      queue.push_back(next);
+  }
+  while (!queue.empty()) {
+    uint32_t state = queue.front();
+    queue.pop_front();
+    bestOutput[state] = std::min(bestOutput[state], bestOutput[failure[state]]);
+    for (Nat c = 0; c < 256; c++) {
+      uint32_t& next = transitions[state * 256 + c];
+      if (next == absent) {
+        next = transitions[failure[state] * 256 + c];
+      }
+      else {
+        failure[next] = transitions[failure[state] * 256 + c];
+        queue.push_back(next);
+      }
+    }
+  }
+
+  std::fill(std::begin(startsPattern), std::end(startsPattern), false);
+  startsPattern[static_cast<unsigned char>('\n')] = true;
+  for (Nat c = 0; c < 256; c++)
+    if (transitions[c] != 0)
+      startsPattern[c] = true;
+  for (Nat c = 0; c < 256; c++)
+    if (startsPattern[c])
+      startBytes.push_back(c);
+}
+
+/// Next byte at or after p that may leave the initial state or ends a line
+const unsigned char* Matcher::skip(const unsigned char* p, const unsigned char* end) const {
+#ifdef __SSE2__
+  if (startBytes.size() <= 8) {
+    __m128i needles[8];
+    for (size_t i = 0; i < startBytes.size(); i++)
+      needles[i] = _mm_set1_epi8(static_cast<char>(startBytes[i]));
+    while (end - p >= 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i hits = _mm_setzero_si128();
+      for (size_t i = 0; i < startBytes.size(); i++)
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+      int mask = _mm_movemask_epi8(hits);
+      if (mask != 0)
+        return p + __builtin_ctz(mask);
+      p += 16;
+    }
+  }
+#endif
+  while (p < end && !startsPattern[*p])
+    p++;
+  return p;
+}
+
+Nat Matcher::scan(Cursor& cursor, const char* data, size_t size) const {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = p + size;
+  while (p < end) {
+    if (cursor.state == 0) {
+      p = skip(p, end);
+      if (p == end)
+        break;
+    }
+    unsigned char c = *p++;
+    if (c == '\n') {
+      Nat result = cursor.lineBest;
+      cursor.state = 0;
+      cursor.lineBest = none;
+      if (result != none)
+        return result;
+      continue;
+    }
+    cursor.state = transitions[cursor.state * 256 + c];
+    cursor.lineBest = std::min(cursor.lineBest, bestOutput[cursor.state]);
+  }
+  return none;
+}
+
+Nat Matcher::finish(Cursor& cursor) const {
+  Nat result = cursor.lineBest;
+  cursor = Cursor();
+  return result;
+}
+
+
+PatternParser::Definition::Definition(std::vector<Rule>&& rules, const String& fallback) :
+    rules(std::move(rules)),
+    fallback(fallback),
+    matcher([this] () {
+      Strings patterns;
+      for (const Rule& rule : this->rules)
+        patterns.push_back(rule.pattern);
+      return patterns;
+    }()) { }
+
+PatternParser::PatternParser(const std::shared_ptr<const Definition>& definition) :
+    definition(definition),
+    decided{Matcher::none, Matcher::none} { }
+
+void PatternParser::feed(Stream stream, const char* data, size_t size) {
+  int i = static_cast<int>(stream);
+  if (decided[i] == Matcher::none)
+    decided[i] = definition->matcher.scan(cursors[i], data, size);
+}
+
+String PatternParser::finish(const String& outFileName, const String& errFileName, int returnCode) {
+  for (int i = 0; i < 2; i++)
+    if (decided[i] == Matcher::none)
+      decided[i] = definition->matcher.finish(cursors[i]);
+  for (int i = 0; i < 2; i++) // Standard output takes precedence, as in the scripts
+    if (decided[i] != Matcher::none)
+      return definition->rules[decided[i]].verdict + "\n";
+  return definition->fallback + "\n";
+}
+
+/// Only a verdict on standard output is final. A verdict on error output is overruled by any later match on standard
+/// output (see finish()), so it decides only once the run ended.
+bbb::Maybe<String> PatternParser::verdict_so_far() const {
+  int out = static_cast<int>(Stream::out);
+  if (decided[out] != Matcher::none)
+    return definition->rules[decided[out]].verdict + "\n";
+  return {};
+}
+
+String ScriptParser::finish(const String& outFileName, const String& errFileName, int returnCode) {
+  try {
+    // TODO: escape possible spaces in the following (quoting did not work):
+    return subprocess::check_output("./" + script + " " + outFileName + " " + errFileName + " " + std::to_string(returnCode)).buf.data();
+  } catch (const subprocess::OSError& e) {
+    return "ERROR";
+  }
+}
+
+
+Registry& Registry::instance() {
+  static Registry registry;
+  return registry;
+}
+
+/// Built-in counterparts of the scripts in toolAdapters/outputParsers
+Registry::Registry() {
+  auto divine4 = std::make_shared<const PatternParser::Definition>(std::vector<PatternParser::Rule>{
+      {"error found: no", "TRUE"},
+      {"Assertion failed", "FALSE_REACH"},
+      {"E: resource exhausted: time limit", "TIMEOUT"}
+    }, "ERROR");
+  add("divine4", [divine4] () { return std::make_unique<PatternParser>(divine4); });
+
+  auto symbiotic = std::make_shared<const PatternParser::Definition>(std::vector<PatternParser::Rule>{
+      {"RESULT: true", "TRUE"},
+      {"RESULT: unknown", "UNKNOWN"},
+      {"RESULT: done", "DONE"},
+      {"RESULT: false(valid-deref)", "FALSE_DEREF"},
+      {"RESULT: false(valid-free)", "FALSE_FREE"},
+      {"RESULT: false(valid-memtrack)", "FALSE_MEMTRACK"},
+      {"RESULT: false(valid-memcleanup)", "FALSE_MEMCLEANUP"},
+      {"false(no-overflow)", "FALSE_OVERFLOW"},
+      {"RESULT: false(termination)", "FALSE_TERMINATION"},
+      {"RESULT: false", "FALSE_REACH"},
+      {"RESULT: timeout", "TIMEOUT"}
+    }, "ERROR");
+  add("symbiotic", [symbiotic] () { return std::make_unique<PatternParser>(symbiotic); });
+
+  add("dummy", [] () { return std::make_unique<ConstantParser>("UNKNOWN\n"); });
+}
+
+void Registry::add(const String& name, Factory&& factory) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  factories[name] = std::move(factory);
+}
+
+String Registry::builtin_name(const String& outputParser) {
+  size_t begin = outputParser.rfind('/');
+  begin = (begin == String::npos ? 0 : begin + 1);
+  size_t end = outputParser.rfind('.');
+  if (end == String::npos || end < begin)
+    end = outputParser.size();
+  return outputParser.substr(begin, end - begin);
+}
+
+std::unique_ptr<Parser> Registry::create(const String& outputParser) const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  String name = (outputParser.empty() ? "dummy" : builtin_name(outputParser));
+  auto it = factories.find(name);
+  if (it != factories.end())
+    return it->second();
+  DEB("No built-in output parser " << name << ", running " << outputParser);
+  return std::make_unique<ScriptParser>(outputParser);
+}
+
+}
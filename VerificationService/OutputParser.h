@@ -0,0 +1,190 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   OutputParser.h
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bbb.h"
+
+namespace OutputParser {
+
+using namespace Basics;
+
+enum class Stream { out, err };
+
+/**
+ * Turns the output of one run of a tool into a verdict (e.g. "TRUE\n", "FALSE_REACH\n", "ERROR\n"),
+ * the same strings the scripts in toolAdapters/outputParsers print.
+ * The output is fed while the tool is writing it; one parser instance serves one run.
+ */
+class Parser {
+public:
+  virtual ~Parser() {}
+
+  /**
+   * Passes the next part of a stream of the run's output
+   */
+  virtual void feed(Stream stream, const char* data, size_t size) = 0;
+
+  /**
+   * Called once the run ended and all its output was fed.
+   * @return The verdict
+   */
+  virtual String finish(const String& outFileName, const String& errFileName, int returnCode) = 0;
+
+  /**
+   * @return The verdict found in the output fed so far, nothing if the output does not decide yet
+   *         (or the parser can only decide once the run ended)
+   */
+  virtual bbb::Maybe<String> verdict_so_far() const { return {}; }
+};
+
+using Factory = std::function<std::unique_ptr<Parser>()>;
+
+/**
+ * Multi-pattern substring matcher (Aho-Corasick) working on whole lines of a stream.
+ *
+ * The stream may arrive in arbitrary chunks; the scanning state is kept in a Cursor.
+ * While no pattern is partially matched, the scan skips to the next byte that can start
+ * a pattern or end a line, comparing 16 bytes at a time where SSE2 is available.
+ */
+class Matcher {
+public:
+  static const Nat none = std::numeric_limits<Nat>::max();
+
+  /**
+   * Scanning state of one stream
+   */
+  struct Cursor {
+    uint32_t state = 0;
+    Nat lineBest = none; // Lowest index of a pattern matched on the current line
+  };
+
+  Matcher(const Strings& patterns);
+
+  /**
+   * Scans data until the end of the first line containing a pattern.
+   * @return Lowest index of a pattern on that line, none if no complete line in data contains a pattern
+   */
+  Nat scan(Cursor& cursor, const char* data, size_t size) const;
+
+  /**
+   * Ends the stream, the unterminated last line counts as a line.
+   * @return Lowest index of a pattern on that line, none if it has none
+   */
+  Nat finish(Cursor& cursor) const;
+
+private:
+  const unsigned char* skip(const unsigned char* p, const unsigned char* end) const;
+
+  std::vector<uint32_t> transitions; // state * 256 + byte -> state
+  std::vector<Nat> bestOutput;       // state -> lowest index of a pattern ending in the state or its suffixes
+  bool startsPattern[256];           // Bytes that leave the initial state (and the line end)
+  std::vector<unsigned char> startBytes;
+};
+
+/**
+ * Verdict of the first line (stdout before stderr) that contains one of the patterns.
+ * If a line contains several patterns, the pattern listed first wins.
+ */
+class PatternParser : public Parser {
+public:
+  struct Rule {
+    String pattern;
+    String verdict;
+  };
+
+  /**
+   * Describes a parser; shared by all runs using it
+   */
+  struct Definition {
+    Definition(std::vector<Rule>&& rules, const String& fallback);
+    const std::vector<Rule> rules;
+    const String fallback; // Verdict if no line matches
+    const Matcher matcher;
+  };
+
+  PatternParser(const std::shared_ptr<const Definition>& definition);
+
+  virtual void feed(Stream stream, const char* data, size_t size) override;
+  virtual String finish(const String& outFileName, const String& errFileName, int returnCode) override;
+  virtual bbb::Maybe<String> verdict_so_far() const override;
+
+protected:
+  std::shared_ptr<const Definition> definition;
+  Matcher::Cursor cursors[2];
+  Nat decided[2]; // Index of the deciding rule for each stream, Matcher::none if not decided yet
+};
+
+/**
+ * Always gives the same verdict
+ */
+class ConstantParser : public Parser {
+public:
+  ConstantParser(const String& verdict) : verdict(verdict) {}
+  virtual void feed(Stream stream, const char* data, size_t size) override {}
+  virtual String finish(const String& outFileName, const String& errFileName, int returnCode) override { return verdict; }
+private:
+  const String verdict;
+};
+
+/**
+ * Runs an external output parser script on the output files once the run ended
+ */
+class ScriptParser : public Parser {
+public:
+  ScriptParser(const String& script) : script(script) {}
+  virtual void feed(Stream stream, const char* data, size_t size) override {}
+  virtual String finish(const String& outFileName, const String& errFileName, int returnCode) override;
+private:
+  const String script;
+};
+
+/**
+ * Parsers available without running a script.
+ * A tool's output_parser is looked up by the file name of the script without extension
+ * (e.g. toolAdapters/outputParsers/divine4.sh -> divine4); unknown scripts are run as before.
+ */
+class Registry {
+public:
+  static Registry& instance();
+
+  Registry(const Registry& other) = delete;
+  Registry& operator=(const Registry& other) = delete;
+
+  void add(const String& name, Factory&& factory);
+
+  /**
+   * @param outputParser The tool's output_parser setting, empty if the tool has none
+   * @return Parser for a single run
+   */
+  std::unique_ptr<Parser> create(const String& outputParser) const;
+
+private:
+  Registry();
+  static String builtin_name(const String& outputParser);
+
+  mutable std::mutex mutex;
+  std::map<String, Factory> factories;
+};
+
+}
@@ -0,0 +1,270 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Portfolio.cpp
+ */
+
+#include <algorithm>
+
+#include "Portfolio.h"
+
+namespace Portfolio {
+
+namespace {
+
+String trimmed(const String& text) {
+  String result = text;
+  while (!result.empty() && isspace(result.back()))
+    result.pop_back();
+  return result;
+}
+
+/// Values of the sweep in the parameter, or just the parameter if it holds no sweep
+Strings expand_parameter(const String& parameter, bool& swept) {
+  swept = false;
+  size_t open = parameter.find('{');
+  size_t close = (open == String::npos ? String::npos : parameter.find('}', open));
+  if (close == String::npos)
+    return {parameter};
+  const String prefix = parameter.substr(0, open), suffix = parameter.substr(close + 1);
+  const String sweep = parameter.substr(open + 1, close - open - 1);
+  Strings values;
+  size_t dots = sweep.find("..");
+  if (dots != String::npos) {
+    Strings bounds;
+    String rest = sweep;
+    for (size_t pos; (pos = rest.find("..")) != String::npos; rest = rest.substr(pos + 2))
+      bounds.push_back(rest.substr(0, pos));
+    bounds.push_back(rest);
+    std::vector<Nat> numbers;
+    for (const String& bound : bounds) {
+      auto number = bbb::s2u(bound);
+      if (!number)
+        return {parameter}; // Not a range
+      numbers.push_back(number.value());
+    }
+    if (numbers.size() > 3)
+      return {parameter};
+    Nat step = (numbers.size() == 3 ? numbers[2] : 1);
+    if (step == 0 || numbers[0] > numbers[1])
+      throw std::runtime_error("Invalid sweep range in parameter \"" + parameter + "\"");
+    Nat count = (numbers[1] - numbers[0]) / step + 1;
+    if (count > maxSweepPoints)
+      throw std::runtime_error("The sweep has more than " + std::to_string(maxSweepPoints) + " points.");
+    for (Nat i = 0; i < count; i++)
+      values.push_back(prefix + std::to_string(numbers[0] + i * step) + suffix);
+  }
+  else if (sweep.find(',') != String::npos) {
+    Strings items;
+    bbb::split_by(sweep, items, ",");
+    for (const String& item : items)
+      values.push_back(prefix + item + suffix);
+  }
+  else
+    return {parameter};
+  swept = true;
+  return values;
+}
+
+}
+
+bool is_definitive(const String& parsedOutput) {
+  String verdict = parsedOutput;
+  while (!verdict.empty() && isspace(verdict.back()))
+    verdict.pop_back();
+  return verdict == "TRUE" || verdict.compare(0, 6, "FALSE_") == 0;
+}
+
+Group::Group(Archive::ReportID parent, std::vector<Archive::ReportID>&& members) :
+    parent(parent),
+    members(std::move(members)),
+    remaining(this->members.size()),
+    decided(false) { }
+
+bool Group::is_decided() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return decided;
+}
+
+bool Group::member_finished(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (remaining > 0)
+    remaining--;
+  if (decided)
+    return false;
+  auto report = archive.borrow_report(member);
+  if (is_definitive(report->parsedOutput)) {
+    decide_nomutex(member, archive, "Verification finished. Verdict by " + report->tool->get_name() + " (report n. " + std::to_string(member) + ").");
+    return true;
+  }
+  if (remaining == 0)
+    decide_nomutex(member, archive, "Verification finished. No tool of the portfolio reached a definitive verdict.");
+  return false;
+}
+
+void Group::member_dropped(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (remaining > 0)
+    remaining--;
+  if (decided || remaining > 0)
+    return;
+  decide_nomutex(member, archive, "Verification finished. No tool of the portfolio reached a definitive verdict.");
+}
+
+void Group::decide_nomutex(Archive::ReportID member, Archive::Archive& archive, const String& runningResult) {
+  decided = true;
+  auto winner = archive.borrow_report(member);
+  auto report = archive.borrow_report(parent);
+  report->decidedBy = winner->tool->get_name();
+  report->callCommand = winner->callCommand;
+  report->runTime = winner->runTime;
+  report->peakMemory = winner->peakMemory;
+  report->date = winner->date;
+  report->partVerResult = winner->partVerResult;
+  report->returnCode = winner->returnCode;
+  report->parsedOutput = winner->parsedOutput;
+  report->stdOutput = winner->stdOutput;
+  report->errOutput = winner->errOutput;
+  report->terminatedEarly = winner->terminatedEarly;
+  report->outputFiles = winner->outputFiles;
+  report->running = false;
+  report->runningResult = runningResult;
+  DEB("Portfolio of report " << parent << " decided by report " << member << ": " << report->parsedOutput);
+  report->validate();
+}
+
+
+Sweep::Sweep(Archive::ReportID parent, std::vector<Archive::ReportID>&& members, Strings&& points, bool untilDefinitive) :
+    Group(parent, std::move(members)),
+    points(std::move(points)),
+    untilDefinitive(untilDefinitive) { }
+
+bool Sweep::member_finished(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (remaining > 0)
+    remaining--;
+  if (decided)
+    return false;
+  if (untilDefinitive && is_definitive(archive.borrow_report(member)->parsedOutput)) {
+    size_t index = std::find(members.begin(), members.end(), member) - members.begin();
+    aggregate_nomutex(archive, "Sweep finished early: " + (index < points.size() ? points[index] : std::to_string(member))
+                               + " reached a definitive verdict.");
+    return true;
+  }
+  if (remaining == 0)
+    aggregate_nomutex(archive, "Sweep finished.");
+  return false;
+}
+
+void Sweep::member_dropped(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (remaining > 0)
+    remaining--;
+  if (decided || remaining > 0)
+    return;
+  aggregate_nomutex(archive, "Sweep finished.");
+}
+
+/// Lists the points in the parent's output; members not finalised yet (stopped or still queued) are listed without a verdict.
+void Sweep::aggregate_nomutex(Archive::Archive& archive, const String& runningResult) {
+  decided = true;
+  String listing, verdict, decidedBy;
+  Dur runTime = Dur::zero();
+  long peakMemory = 0;
+  Nat definitive = 0;
+  for (size_t i = 0; i < members.size(); i++) {
+    auto member = archive.borrow_report(members[i]);
+    listing += points[i] + ": ";
+    if (!member->is_valid()) {
+      listing += "no verdict\n";
+      continue;
+    }
+    String memberVerdict = trimmed(member->parsedOutput);
+    listing += memberVerdict + " (" + std::to_string(member->runTime.count()) + " ms, " + std::to_string(member->peakMemory) + " kB)\n";
+    runTime += member->runTime;
+    peakMemory = std::max(peakMemory, member->peakMemory);
+    if (is_definitive(memberVerdict)) {
+      definitive++;
+      if (verdict.empty()) {
+        verdict = memberVerdict;
+        decidedBy = points[i];
+      }
+    }
+  }
+  auto report = archive.borrow_report(parent);
+  report->parsedOutput = (verdict.empty() ? "UNKNOWN" : verdict);
+  report->decidedBy = decidedBy;
+  report->stdOutput = listing;
+  report->runTime = runTime;
+  report->peakMemory = peakMemory;
+  report->date = SClock::now();
+  report->running = false;
+  report->runningResult = runningResult + " " + std::to_string(definitive) + " of " + std::to_string(members.size())
+                          + " points reached a definitive verdict.";
+  DEB("Sweep of report " << parent << " decided: " << report->parsedOutput);
+  report->validate();
+}
+
+void expand_sweep(const Strings& parameters, std::vector<Strings>& points, Strings& labels) {
+  points.clear();
+  labels.clear();
+  std::vector<Strings> values(parameters.size());
+  std::vector<bool> swept(parameters.size());
+  size_t count = 1;
+  for (size_t i = 0; i < parameters.size(); i++) {
+    bool isSwept;
+    values[i] = expand_parameter(parameters[i], isSwept);
+    swept[i] = isSwept;
+    count *= values[i].size();
+    if (count > maxSweepPoints)
+      throw std::runtime_error("The sweep has more than " + std::to_string(maxSweepPoints) + " points.");
+  }
+  if (std::find(swept.begin(), swept.end(), true) == swept.end())
+    return;
+  for (size_t point = 0; point < count; point++) {
+    Strings pointParameters;
+    String label;
+    size_t rest = point;
+    for (size_t i = parameters.size(); i-- > 0; ) { // The last parameter varies fastest
+      pointParameters.push_back(values[i][rest % values[i].size()]);
+      if (swept[i])
+        label = pointParameters.back() + (label.empty() ? "" : " ") + label;
+      rest /= values[i].size();
+    }
+    std::reverse(pointParameters.begin(), pointParameters.end());
+    points.push_back(std::move(pointParameters));
+    labels.push_back(std::move(label));
+  }
+}
+
+
+Step::Step(Archive::ReportID step, Archive::ReportID member) : Group(step, {member}) { }
+
+bool Step::member_finished(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  remaining = 0;
+  if (!decided)
+    decide_nomutex(member, archive, "Verification finished. Step run as report n. " + std::to_string(member) + ".");
+  return false;
+}
+
+void Step::member_dropped(Archive::ReportID member, Archive::Archive& archive) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  remaining = 0;
+  if (decided)
+    return;
+  decided = true;
+  auto report = archive.borrow_report(parent);
+  report->running = false;
+  report->runningResult = "The step was not run (report n. " + std::to_string(member) + ").";
+}
+
+}
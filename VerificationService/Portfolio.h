@@ -0,0 +1,133 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Portfolio.h
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "bbb.h"
+#include "Archive.h"
+
+namespace Portfolio {
+
+using namespace Basics;
+
+/**
+ * @param parsedOutput Output of a tool's output parser
+ * @return True for a verdict that answers the verification question (TRUE, FALSE_*),
+ *         false for UNKNOWN, TIMEOUT, ERROR and the like.
+ */
+bool is_definitive(const String& parsedOutput);
+
+/**
+ * Several tools of one category racing on the same verification task.
+ *
+ * The parent report is the one the client asked for, each member report is a run of one tool.
+ * The first member with a definitive verdict decides the parent report; if no member reaches one,
+ * the parent is decided when the last member ends.
+ */
+class Group {
+public:
+  Group(Archive::ReportID parent, std::vector<Archive::ReportID>&& members);
+  Group(const Group& other) = delete;
+  Group& operator=(const Group& other) = delete;
+  virtual ~Group() { }
+
+  Archive::ReportID get_parent() const { return parent; }
+  const std::vector<Archive::ReportID>& get_members() const { return members; }
+  bool is_decided() const;
+
+  /**
+   * To be called once the member's report is finalised.
+   * @return True if the member decided the parent report, i.e. the other members should be stopped.
+   */
+  virtual bool member_finished(Archive::ReportID member, Archive::Archive& archive);
+
+  /**
+   * To be called for a member that ended without running (dropped from the queue or failed to launch).
+   */
+  virtual void member_dropped(Archive::ReportID member, Archive::Archive& archive);
+
+protected:
+  void decide_nomutex(Archive::ReportID member, Archive::Archive& archive, const String& runningResult);
+
+  mutable std::mutex mutex;
+  const Archive::ReportID parent;
+  const std::vector<Archive::ReportID> members;
+  Nat remaining;
+  bool decided;
+};
+
+using SharedGroup = std::shared_ptr<Group>;
+
+/**
+ * Runs of one tool over the points of a parameter sweep, e.g. a range of bounds.
+ *
+ * The parent report is the one the client asked for, each member report is the run of one point.
+ * The parent is decided once all members ended; with untilDefinitive, already by the first member
+ * with a definitive verdict, and the other members are stopped (iterative deepening: the points are queued
+ * in order, so smaller bounds start first). The parent's output lists the verdict and the resources of every point,
+ * its verdict is the one of the first point (in sweep order) with a definitive verdict.
+ */
+class Sweep : public Group {
+public:
+  /**
+   * @param points Parameters of the members as written in the aggregate report, in the order of the members
+   */
+  Sweep(Archive::ReportID parent, std::vector<Archive::ReportID>&& members, Strings&& points, bool untilDefinitive);
+
+  virtual bool member_finished(Archive::ReportID member, Archive::Archive& archive) override;
+  virtual void member_dropped(Archive::ReportID member, Archive::Archive& archive) override;
+
+private:
+  void aggregate_nomutex(Archive::Archive& archive, const String& runningResult);
+
+  const Strings points;
+  const bool untilDefinitive;
+};
+
+/**
+ * A step of a plan whose inputs are outputs of earlier steps. The step's report is the one the client asked for.
+ * Once the inputs are known, the step runs as its only member, a report with the actual input files; a step whose
+ * inputs did not change is thus found in the archive and not run again. The member's result is copied to the step's report.
+ */
+class Step : public Group {
+public:
+  Step(Archive::ReportID step, Archive::ReportID member);
+
+  virtual bool member_finished(Archive::ReportID member, Archive::Archive& archive) override;
+  virtual void member_dropped(Archive::ReportID member, Archive::Archive& archive) override;
+};
+
+/**
+ * Maximum number of points of a sweep
+ */
+const Nat maxSweepPoints = 256;
+
+/**
+ * Expands the sweeps in call parameters of a request that asks for a sweep (see RequestResponse::Request::get_sweep()).
+ * A parameter may contain one sweep in braces: a list "{a,b,c}",
+ * or a range "{first..last}" or "{first..last..step}" of natural numbers. Several sweeps give all combinations,
+ * the first parameter varies slowest. E.g. {"--unwind {1..3}"} gives {"--unwind 1"}, {"--unwind 2"}, {"--unwind 3"}.
+ * Braces that hold neither a list nor a range are kept as they are.
+ * Throws std::runtime_error for a range that is not increasing or for more than maxSweepPoints points.
+ * @param parameters Call parameters of the request
+ * @param points The parameters of each point; empty if there is no sweep
+ * @param labels The swept parameters of each point, e.g. "--unwind 2"
+ */
+void expand_sweep(const Strings& parameters, std::vector<Strings>& points, Strings& labels);
+
+}
@@ -0,0 +1,670 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Remote.cpp
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <experimental/filesystem>
+#include <fstream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "Remote.h"
+
+namespace Remote {
+
+namespace filesystem = std::experimental::filesystem;
+
+namespace {
+
+/// Longest header of a message ("<type> <length>\n")
+const size_t maxHeaderSize = 64;
+
+/// Tool names are compared without case, as in the ToolKit
+String lowercase(String name) {
+  std::transform(name.begin(), name.end(), name.begin(), [] (unsigned char c) { return std::tolower(c); });
+  return name;
+}
+
+std::set<String> lowercase(std::set<String>&& names) {
+  std::set<String> result;
+  for (const String& name : names)
+    result.insert(lowercase(name));
+  return result;
+}
+
+void write_all(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      throw RemoteError("Sending timed out, the other side does not read"); // See keep_alive()
+    if (written <= 0)
+      throw RemoteError("Sending failed: " + String(strerror(errno)));
+    data += written;
+    size -= written;
+  }
+}
+
+/// @return false if the connection ended before the first byte
+bool read_all(int fd, char* data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t got = ::recv(fd, data + done, size - done, 0);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0)
+      throw RemoteError("Receiving failed: " + String(strerror(errno)));
+    if (got == 0) {
+      if (done == 0)
+        return false;
+      throw RemoteError("Connection ended within a message");
+    }
+    done += got;
+  }
+  return true;
+}
+
+}
+
+void write_message(int fd, const String& type, const String& payload) {
+  String header = type + " " + std::to_string(payload.size()) + "\n";
+  write_all(fd, header.data(), header.size());
+  write_all(fd, payload.data(), payload.size());
+}
+
+bool read_message(int fd, String& type, String& payload) {
+  String header;
+  char c;
+  for (;;) {
+    if (!read_all(fd, &c, 1)) {
+      if (header.empty())
+        return false;
+      throw RemoteError("Connection ended within a message");
+    }
+    if (c == '\n')
+      break;
+    header += c;
+    if (header.size() > maxHeaderSize)
+      throw RemoteError("Malformed message header");
+  }
+  size_t space = header.find(' ');
+  if (space == String::npos || space == 0)
+    throw RemoteError("Malformed message header: " + header);
+  type = header.substr(0, space);
+  String length = header.substr(space + 1);
+  if (length.empty() || length.find_first_not_of("0123456789") != String::npos) // std::stoull() takes "-1" too
+    throw RemoteError("Malformed message header: " + header);
+  size_t size;
+  try {
+    size = std::stoull(length);
+  }
+  catch (const std::logic_error& e) {
+    throw RemoteError("Malformed message header: " + header);
+  }
+  if (size > maxPayloadSize)
+    throw RemoteError("Message of " + length + " bytes is too large: " + type);
+  payload.resize(size);
+  if (size > 0 && !read_all(fd, &payload[0], size))
+    throw RemoteError("Connection ended within a message");
+  return true;
+}
+
+Nat split_id(const String& payload, String& rest) {
+  size_t newline = payload.find('\n');
+  try {
+    Nat id = std::stoul(payload.substr(0, newline));
+    rest = (newline == String::npos ? String() : payload.substr(newline + 1));
+    return id;
+  }
+  catch (const std::logic_error& e) {
+    throw RemoteError("Malformed message without a run ID");
+  }
+}
+
+bool is_safe_path(const String& path) {
+  if (path.empty() || path[0] == '/')
+    return false;
+  for (const auto& element : filesystem::path(path))
+    if (element == "..")
+      return false;
+  return true;
+}
+
+int connect_to(const String& host, int port) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses;
+  int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+  if (error != 0)
+    throw RemoteError("Cannot resolve " + host + ": " + gai_strerror(error));
+  int fd = -1;
+  for (struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0)
+    throw RemoteError("Cannot connect to " + host + ":" + std::to_string(port) + ": " + strerror(errno));
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Statistics and signals are small messages
+  keep_alive(fd);
+  return fd;
+}
+
+int listen_on(const String& address, int port) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* addresses;
+  int error = getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+  if (error != 0)
+    throw RemoteError("Cannot resolve " + address + ": " + gai_strerror(error));
+  int fd = -1;
+  String message;
+  for (struct addrinfo* candidate = addresses; candidate && fd < 0; candidate = candidate->ai_next) {
+    fd = socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol);
+    if (fd < 0) {
+      message = strerror(errno);
+      continue;
+    }
+    int one = 1, zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (candidate->ai_family == AF_INET6)
+      setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)); // IPv4 agents too if bound to "::"
+    if (bind(fd, candidate->ai_addr, candidate->ai_addrlen) != 0 || ::listen(fd, 16) != 0) {
+      message = strerror(errno);
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0)
+    throw RemoteError("Cannot listen on " + address + ":" + std::to_string(port) + ": " + message);
+  return fd;
+}
+
+void keep_alive(int fd) {
+  struct timeval sendTimeout{60, 0};
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+  int one = 1, idle = 30, interval = 10, probes = 3;
+  setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+  unsigned int unacknowledged = 60000; // ms sent data may stay unacknowledged
+  setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &unacknowledged, sizeof(unacknowledged));
+}
+
+String read_secret(const String& file) {
+  Strings lines;
+  if (!bbb::read_file(file, lines) || lines.empty() || lines[0].empty())
+    throw RemoteError("No secret for worker agents in " + file);
+  return lines[0];
+}
+
+
+Slot::Slot(Slot&& other) noexcept : Slot() {
+  *this = std::move(other);
+}
+
+Slot& Slot::operator=(Slot&& other) noexcept {
+  release();
+  worker = std::move(other.worker);
+  cores = other.cores;
+  memory = other.memory;
+  other.worker.reset();
+  return *this;
+}
+
+void Slot::release() {
+  if (!worker)
+    return;
+  worker->unreserve(cores, memory);
+  worker.reset();
+}
+
+
+Assignment::Assignment(Slot&& slot, Nat id, const Launcher::Request& request) :
+    worker(slot.get_worker()),
+    slot(std::move(slot)),
+    id(id),
+    directory(request.workingDirectory),
+    outFileName(request.outFileName),
+    errFileName(request.errFileName),
+    out(Launcher::open_output(request.outFileName)),
+    err(Launcher::open_output(request.errFileName)),
+    sampled(false),
+    done(false),
+    status(0) { }
+
+pid_t Assignment::wait(pid_t pid, int* status) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!done)
+    return 0;
+  *status = this->status;
+  return pid;
+}
+
+void Assignment::kill(pid_t pid, int signal) {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (done)
+      return;
+  }
+  worker->signal(id, signal);
+}
+
+bool Assignment::sample(Monitor::ProcessSample& process, Monitor::HostSample& host) const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!sampled || done)
+    return false;
+  process = this->process;
+  host = this->host;
+  return true;
+}
+
+void Assignment::receive_stats(const Monitor::ProcessSample& process, const Monitor::HostSample& host) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  this->process = process;
+  this->host = host;
+  sampled = true;
+}
+
+/// The run tails the output files, as it would the ones of a local process
+void Assignment::receive_output(bool error, const String& chunk) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  int fd = (error ? err.fd : out.fd);
+  const char* data = chunk.data();
+  size_t size = chunk.size();
+  while (size > 0) {
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0) {
+      DEB("Writing the output of remote run " << id << " failed: " << strerror(errno));
+      return;
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+/// Written aside and renamed, so that the run never reads a partial file
+void Assignment::receive_file(const String& path, const String& content) {
+  filesystem::path target = filesystem::path(directory)/path;
+  std::error_code error;
+  filesystem::create_directories(target.parent_path(), error);
+  String partial = target.string() + ".part";
+  {
+    std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+    if (!file) {
+      DEB("Writing " << target << " of remote run " << id << " failed");
+      return;
+    }
+  }
+  filesystem::rename(partial, target, error);
+}
+
+void Assignment::finish(int status) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (done)
+    return;
+  this->status = status;
+  done = true;
+  slot.release(); // The worker's cores are free for another run
+}
+
+
+Worker::Worker(int fd, const String& name, Nat cores, Nat memory, std::set<String>&& tools) :
+    fd(fd),
+    name(name),
+    cores(cores),
+    memory(memory),
+    tools(lowercase(std::move(tools))),
+    usedCores(0),
+    usedMemory(0),
+    connected(true) { }
+
+bool Worker::has_tool(const String& tool) const {
+  return tools.count(lowercase(tool)) > 0;
+}
+
+Worker::~Worker() {
+  close(fd);
+}
+
+bool Worker::is_connected() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return connected;
+}
+
+Nat Worker::free_cores() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return cores - std::min(cores, usedCores);
+}
+
+bool Worker::try_reserve(Nat cores, Nat memory) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!connected || usedCores + cores > this->cores || usedMemory + memory > this->memory)
+    return false;
+  usedCores += cores;
+  usedMemory += memory;
+  return true;
+}
+
+void Worker::unreserve(Nat cores, Nat memory) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  usedCores -= std::min(usedCores, cores);
+  usedMemory -= std::min(usedMemory, memory);
+}
+
+void Worker::assign(const std::shared_ptr<Assignment>& assignment, const String& tool, const String& arguments) {
+  const Nat id = assignment->get_id();
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (!connected)
+      throw RemoteError("Worker agent " + name + " disconnected");
+    assignments[id] = assignment;
+  }
+  const String prefix = std::to_string(id) + "\n";
+  const filesystem::path directory(assignment->get_directory());
+  for (auto it = filesystem::recursive_directory_iterator(directory); it != filesystem::recursive_directory_iterator(); ++it) {
+    if (!filesystem::is_regular_file(it->status()) || it->path() == assignment->get_out_file_name()
+        || it->path() == assignment->get_err_file_name())
+      continue;
+    String content;
+    if (!bbb::read_file(it->path().string(), content))
+      throw RemoteError("Cannot read " + it->path().string());
+    String path = it->path().string().substr(directory.string().size() + 1);
+    send("FILE", prefix + path + "\n" + content);
+  }
+  send("ASSIGN", prefix + tool + "\n" + arguments);
+  DEB("Assigned remote run " << id << " of " << tool << " to worker agent " << name);
+}
+
+void Worker::signal(Nat id, int signal) {
+  try {
+    send("SIGNAL", std::to_string(id) + "\n" + std::to_string(signal));
+  }
+  catch (const RemoteError& e) {
+    DEB("Signalling remote run " << id << " failed: " << e.what()); // The run ends once serve() sees the connection end
+  }
+}
+
+void Worker::send(const String& type, const String& payload) {
+  std::lock_guard<decltype(sendMutex)> lockGuard(sendMutex);
+  try {
+    write_message(fd, type, payload);
+  }
+  catch (const RemoteError& e) {
+    disconnect(); // serve() ends and finishes the worker's runs
+    throw;
+  }
+}
+
+std::shared_ptr<Assignment> Worker::find(Nat id) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  auto it = assignments.find(id);
+  return (it == assignments.end() ? nullptr : it->second.lock());
+}
+
+void Worker::dispatch(const String& type, const String& payload) {
+  String rest;
+  Nat id = split_id(payload, rest);
+  std::shared_ptr<Assignment> assignment = find(id);
+  if (!assignment)
+    return; // The run was dropped meanwhile
+  if (type == "OUT" || type == "ERR")
+    assignment->receive_output(type == "ERR", rest);
+  else if (type == "FILE") {
+    size_t newline = rest.find('\n');
+    String path = rest.substr(0, newline);
+    if (newline == String::npos || !is_safe_path(path))
+      throw RemoteError("Malformed file of remote run " + std::to_string(id));
+    assignment->receive_file(path, rest.substr(newline + 1));
+  }
+  else if (type == "STATS") {
+    Monitor::ProcessSample process;
+    Monitor::HostSample host;
+    std::istringstream values(rest);
+    values >> process.state >> process.utime >> process.stime >> process.vsize >> process.rss
+           >> host.totalTime >> host.previousTotalTime >> host.memFreeMB >> host.memFreePercent;
+    if (!values)
+      throw RemoteError("Malformed statistics of remote run " + std::to_string(id));
+    assignment->receive_stats(process, host);
+  }
+  else if (type == "EXIT") {
+    assignment->finish(std::atoi(rest.c_str()));
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    assignments.erase(id);
+  }
+  else
+    DEB("Worker agent " << name << " sent an unknown message " << type);
+}
+
+void Worker::serve() {
+  try {
+    String type, payload;
+    while (read_message(fd, type, payload))
+      dispatch(type, payload);
+  }
+  catch (const std::exception& e) {
+    DEB("Connection to worker agent " << name << " failed: " << e.what());
+  }
+  DEB("Worker agent " << name << " disconnected");
+  std::map<Nat, std::weak_ptr<Assignment>> lost;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    connected = false;
+    lost.swap(assignments);
+  }
+  for (auto& entry : lost)
+    if (auto assignment = entry.second.lock()) {
+      assignment->receive_output(true, "Connection to worker agent " + name + " lost.\n");
+      assignment->finish(SIGKILL); // Wait status of a process killed by SIGKILL
+    }
+}
+
+void Worker::disconnect() {
+  shutdown(fd, SHUT_RDWR);
+}
+
+
+WorkerPool& WorkerPool::instance() {
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::~WorkerPool() {
+  if (listener >= 0) {
+    shutdown(listener, SHUT_RDWR);
+    acceptor.join();
+    close(listener);
+  }
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    listener = -1; // Agents still introducing themselves are dropped
+    for (const SharedWorker& worker : workers)
+      worker->disconnect();
+  }
+  for (std::thread& reader : readers)
+    reader.join();
+}
+
+void WorkerPool::listen(const String& address, int port, const String& secret) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (listener >= 0)
+    throw RemoteError("Already listening for worker agents");
+  if (secret.empty())
+    throw RemoteError("Worker agents need a secret");
+  this->secret = secret;
+  listener = listen_on(address, port);
+  acceptor = std::thread(&WorkerPool::accept, this);
+  DEB("Listening for worker agents on " << address << ":" << port);
+}
+
+void WorkerPool::accept() {
+  for (;;) {
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    int fd = accept4(listener, reinterpret_cast<struct sockaddr*>(&address), &length, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return; // The listener was shut down
+    }
+    char host[NI_MAXHOST] = "?", port[NI_MAXSERV] = "?";
+    getnameinfo(reinterpret_cast<struct sockaddr*>(&address), length, host, sizeof(host), port, sizeof(port),
+                NI_NUMERICHOST | NI_NUMERICSERV);
+    String name = String(host) + ":" + port;
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    // Threads of rejected and disconnected agents are joined here, so that they do not pile up:
+    for (auto reader = readers.begin(); reader != readers.end(); )
+      if (finishedReaders.erase(reader->get_id()) > 0) {
+        reader->join(); // It returned from welcome(), the thread ends right after
+        reader = readers.erase(reader);
+      }
+      else {
+        ++reader;
+      }
+    readers.emplace_back([this, fd, name] () { // A slow agent does not hold up the others
+      welcome(fd, name);
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      finishedReaders.insert(std::this_thread::get_id());
+    });
+  }
+}
+
+/// Compares in time independent of where the strings differ
+static bool same_secret(const String& given, const String& expected) {
+  unsigned char difference = (given.size() != expected.size());
+  for (size_t i = 0; i < given.size(); i++)
+    difference |= given[i] ^ expected[i % expected.size()];
+  return difference == 0;
+}
+
+void WorkerPool::welcome(int fd, const String& name) {
+  SharedWorker worker;
+  try {
+    struct timeval timeout{10, 0}, none{0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    String type, payload;
+    if (!read_message(fd, type, payload) || type != "HELLO")
+      throw RemoteError("Expected HELLO");
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    std::istringstream lines(payload);
+    String given;
+    std::getline(lines, given);
+    if (!same_secret(given, secret))
+      throw RemoteError("Wrong secret");
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    keep_alive(fd);
+    Nat cores = 0, memory = 0;
+    lines >> cores >> memory;
+    if (!lines || cores == 0)
+      throw RemoteError("Malformed HELLO");
+    std::set<String> tools;
+    String tool;
+    while (std::getline(lines, tool))
+      if (!tool.empty())
+        tools.insert(tool);
+    DEB("Worker agent " << name << " connected with " << cores << " cores, " << memory << " MB and "
+        << tools.size() << " tools");
+    worker = std::make_shared<Worker>(fd, name, cores, memory, std::move(tools));
+  }
+  catch (const std::exception& e) {
+    DEB("Rejected worker agent " << name << ": " << e.what());
+    close(fd);
+    return;
+  }
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (listener < 0) { // The pool is being destroyed
+      close(fd);
+      return;
+    }
+    workers.push_back(worker);
+  }
+  worker->serve();
+  remove(worker.get());
+}
+
+void WorkerPool::remove(const Worker* worker) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  workers.remove_if([worker] (const SharedWorker& candidate) { return candidate.get() == worker; });
+}
+
+Slot WorkerPool::reserve(const String& tool, Nat cores, Nat memory) {
+  std::vector<SharedWorker> candidates;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    for (const SharedWorker& worker : workers)
+      if (worker->has_tool(tool))
+        candidates.push_back(worker);
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), [] (const SharedWorker& a, const SharedWorker& b) {
+    return a->free_cores() > b->free_cores();
+  });
+  for (const SharedWorker& worker : candidates)
+    if (worker->try_reserve(cores, memory))
+      return Slot(worker, cores, memory);
+  return Slot();
+}
+
+Launcher::Process WorkerPool::start(Slot&& slot, const String& tool, const String& toolPath, const Launcher::Request& request,
+                                    std::shared_ptr<Assignment>& assignment) {
+  if (request.command.compare(0, toolPath.size(), toolPath) != 0)
+    throw RemoteError("The command does not start with the tool's path: " + request.command);
+  Nat id;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    id = nextID++;
+  }
+  SharedWorker worker = slot.get_worker();
+  try {
+    assignment = std::make_shared<Assignment>(std::move(slot), id, request);
+  }
+  catch (const Launcher::LaunchError& e) {
+    throw RemoteError(e.what());
+  }
+  String arguments = request.command.substr(toolPath.size());
+  arguments.erase(0, arguments.find_first_not_of(' '));
+  worker->assign(assignment, tool, arguments);
+  return Launcher::Process(assignment->get_pid(), assignment);
+}
+
+size_t WorkerPool::size() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  return workers.size();
+}
+
+}
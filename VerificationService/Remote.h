@@ -0,0 +1,306 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Remote.h
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/types.h>
+
+#include "bbb.h"
+#include "Launcher.h"
+#include "Monitor.h"
+
+/**
+ * Runs on worker agents (see VerifyWorker.cpp). An agent connects to the server, advertises its tools and capacity,
+ * and runs the verifications the server assigns to it. The server keeps the run directory of every remote run:
+ * the agent streams the run's output, statistics, partVerResult.txt and finally the declared outputs back into it,
+ * so the run is monitored and finalised exactly like a local one.
+ *
+ * Messages are framed as "<type> <payload length>\n<payload>". The first line of a payload is the ID of the run.
+ * A payload is at most maxPayloadSize bytes.
+ *  - HELLO  (agent)  "<secret>\n<cores> <memory MB>\n<tool>\n<tool>...": the secret shared with the server (see read_secret())
+ *  - FILE   (both)   "<id>\n<run-relative path>\n<content>": an input before ASSIGN, a result of the run after it
+ *  - ASSIGN (server) "<id>\n<tool>\n<arguments>": starts the tool with the arguments in the run's directory
+ *  - SIGNAL (server) "<id>\n<signal>": sent to the run's process group
+ *  - STATS  (agent)  "<id>\n<state> <utime> <stime> <vsize> <rss> <total time> <previous total time> <free MB> <free %>"
+ *  - OUT, ERR (agent) "<id>\n<chunk>": output written since the last chunk
+ *  - EXIT   (agent)  "<id>\n<wait status>": the run ended, nothing more follows for it
+ */
+namespace Remote {
+
+using namespace Basics;
+
+class RemoteError : public std::runtime_error {
+public:
+  RemoteError(const std::string& __arg) : runtime_error(__arg) { }
+};
+
+/// Port the server listens on for agents unless configured otherwise
+const int defaultPort = 6090;
+
+/// Longest payload of a message; a larger one is taken for a malformed message
+const size_t maxPayloadSize = size_t(1) << 30;
+
+/// Pseudo process IDs of remote runs start here, above any PID of this host (see pid_max in proc(5))
+const pid_t firstRemotePid = 1 << 22;
+
+/**
+ * Sends one message. Throws RemoteError if the connection is lost.
+ */
+void write_message(int fd, const String& type, const String& payload);
+
+/**
+ * Receives one message.
+ * @return false if the connection ended. Throws RemoteError on a malformed message.
+ */
+bool read_message(int fd, String& type, String& payload);
+
+/**
+ * Splits "<id>\n<rest>". Throws RemoteError.
+ */
+Nat split_id(const String& payload, String& rest);
+
+/**
+ * A run-relative path sent by the other side may not leave the run's directory
+ */
+bool is_safe_path(const String& path);
+
+/**
+ * Throws RemoteError
+ * @return Descriptor of the connection
+ */
+int connect_to(const String& host, int port);
+
+/**
+ * Throws RemoteError
+ * @param address Host name or numeric address to bind to, "::" for all addresses
+ * @return Descriptor of the listening socket
+ */
+int listen_on(const String& address, int port);
+
+/**
+ * Makes a connection fail rather than hang when the other side stops answering: sending times out,
+ * and an idle connection is probed (TCP keep-alive), so that a host gone without closing it is noticed.
+ */
+void keep_alive(int fd);
+
+/**
+ * Reads the secret agents introduce themselves with, the first line of the file. Throws RemoteError if there is none.
+ */
+String read_secret(const String& file);
+
+class Worker;
+using SharedWorker = std::shared_ptr<Worker>;
+
+/**
+ * Cores and memory reserved on a worker agent for one run, released on destruction
+ */
+class Slot {
+public:
+  Slot() : cores(0), memory(0) { }
+  Slot(const SharedWorker& worker, Nat cores, Nat memory) : worker(worker), cores(cores), memory(memory) { }
+  Slot(const Slot& other) = delete;
+  Slot(Slot&& other) noexcept;
+  Slot& operator=(const Slot& other) = delete;
+  Slot& operator=(Slot&& other) noexcept;
+  ~Slot() { release(); }
+
+  operator bool() const { return worker != nullptr; }
+  const SharedWorker& get_worker() const { return worker; }
+  void release();
+
+private:
+  SharedWorker worker;
+  Nat cores;
+  Nat memory;
+};
+
+/**
+ * A run on a worker agent. Stands in for the process the run would otherwise have started:
+ * the run polls and signals the assignment, and samples the statistics the agent sent last.
+ */
+class Assignment : public Launcher::Reaper {
+public:
+  /**
+   * Opens (truncates) the output files of the request
+   */
+  Assignment(Slot&& slot, Nat id, const Launcher::Request& request);
+  Assignment(const Assignment& other) = delete;
+  Assignment& operator=(const Assignment& other) = delete;
+
+  /**
+   * @return pid with the wait status the agent reported once the run ended, 0 while it runs
+   */
+  virtual pid_t wait(pid_t pid, int* status) override;
+
+  /**
+   * Forwards the signal to the agent unless the run ended
+   */
+  virtual void kill(pid_t pid, int signal) override;
+
+  /**
+   * @return false until the agent sent statistics, and once the run ended
+   */
+  bool sample(Monitor::ProcessSample& process, Monitor::HostSample& host) const;
+
+  Nat get_id() const { return id; }
+  pid_t get_pid() const { return firstRemotePid + id; }
+  const String& get_directory() const { return directory; }
+  const SharedWorker& get_worker() const { return worker; }
+  const String& get_out_file_name() const { return outFileName; }
+  const String& get_err_file_name() const { return errFileName; }
+
+  // Called by the thread of the worker:
+  void receive_stats(const Monitor::ProcessSample& process, const Monitor::HostSample& host);
+  void receive_output(bool error, const String& chunk);
+  void receive_file(const String& path, const String& content);
+  void finish(int status);
+
+private:
+  mutable std::mutex mutex;
+  const SharedWorker worker;
+  Slot slot; // Released once the run ended
+  const Nat id;
+  const String directory;
+  const String outFileName;
+  const String errFileName;
+  Launcher::FileDescriptor out, err;
+  Monitor::ProcessSample process;
+  Monitor::HostSample host;
+  bool sampled;
+  bool done;
+  int status;
+};
+
+/**
+ * The server's side of the connection to one worker agent, with the thread reading its messages.
+ * The worker is dropped from the pool once the connection ends; its runs end as if killed.
+ */
+class Worker {
+public:
+  Worker(int fd, const String& name, Nat cores, Nat memory, std::set<String>&& tools);
+  Worker(const Worker& other) = delete;
+  Worker& operator=(const Worker& other) = delete;
+  ~Worker();
+
+  const String& get_name() const { return name; }
+  /**
+   * @param tool Case does not matter, as in the ToolKit
+   */
+  bool has_tool(const String& tool) const;
+  bool is_connected() const;
+  Nat free_cores() const;
+
+  bool try_reserve(Nat cores, Nat memory);
+  void unreserve(Nat cores, Nat memory);
+
+  /**
+   * Sends the files of the run's directory and starts the tool with the arguments on the agent.
+   * Throws RemoteError.
+   */
+  void assign(const std::shared_ptr<Assignment>& assignment, const String& tool, const String& arguments);
+
+  void signal(Nat id, int signal);
+
+  /**
+   * Reads messages until the connection ends, then finishes the worker's runs
+   */
+  void serve();
+
+  /**
+   * Ends the connection, serve() returns
+   */
+  void disconnect();
+
+private:
+  /// Throws RemoteError, and ends the connection then: a message may have been sent in part
+  void send(const String& type, const String& payload);
+  std::shared_ptr<Assignment> find(Nat id);
+  void dispatch(const String& type, const String& payload);
+
+  const int fd;
+  const String name;
+  const Nat cores;
+  const Nat memory;
+  const std::set<String> tools; // Lowercase
+  mutable std::mutex mutex;
+  std::mutex sendMutex;
+  Nat usedCores;
+  Nat usedMemory;
+  bool connected;
+  std::map<Nat, std::weak_ptr<Assignment>> assignments;
+};
+
+/**
+ * Process-wide set of the connected worker agents
+ */
+class WorkerPool {
+public:
+  static WorkerPool& instance();
+
+  WorkerPool(const WorkerPool& other) = delete;
+  WorkerPool& operator=(const WorkerPool& other) = delete;
+  ~WorkerPool();
+
+  /**
+   * Accepts agents on the port from now on, those that introduce themselves with the secret. Throws RemoteError.
+   * @param address See listen_on()
+   */
+  void listen(const String& address, int port, const String& secret);
+
+  /**
+   * Reserves cores and memory on the connected worker with the tool that has the most free cores.
+   * @return An empty slot if no worker can take the run
+   */
+  Slot reserve(const String& tool, Nat cores, Nat memory);
+
+  /**
+   * Starts the request's command on the slot's worker; the command has to start with the tool's path on this host,
+   * the agent replaces it with its own. Throws RemoteError.
+   * @return Stands for the remote process. The assignment gives the run its statistics.
+   */
+  Launcher::Process start(Slot&& slot, const String& tool, const String& toolPath, const Launcher::Request& request,
+                          std::shared_ptr<Assignment>& assignment);
+
+  size_t size() const;
+
+private:
+  WorkerPool() : listener(-1), nextID(0) { }
+  void accept();
+
+  /**
+   * Reads the HELLO of an accepted connection, then serves the agent until it disconnects. Runs in a thread of its own.
+   * An agent that does not introduce itself within 10 s is dropped.
+   */
+  void welcome(int fd, const String& name);
+  void remove(const Worker* worker);
+
+  mutable std::mutex mutex;
+  int listener;
+  String secret;
+  std::thread acceptor;
+  std::list<SharedWorker> workers;
+  std::list<std::thread> readers; // Threads of the connections (see welcome()), until reaped by accept()
+  std::set<std::thread::id> finishedReaders; // Readers that returned and are yet to be joined
+  Nat nextID;
+};
+
+}
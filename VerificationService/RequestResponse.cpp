@@ -25,7 +25,7 @@ namespace RequestResponse {
 void Request::finalise_verify() {
   try {
     requestType = RequestType::verify;
-    workspaceID = headers.at("workspace");
+    workspaceID = Workspace::parse_id(headers.at("workspace")); // An invalid ID is not found
     if (this->state != MultipartBodyCallback::State::FINISHED)
       throw std::runtime_error("Unfinished or missing file upload.");
     xml.fill(getFileDataAsString());
@@ -41,7 +41,7 @@ void Request::finalise_upload() {
   // here in finalise, only set data structures. Handle processing in the handler fn
   try {
     requestType = RequestType::upload;
-    workspaceID = headers.at("workspace");
+    workspaceID = Workspace::parse_id(headers.at("workspace")); // An invalid ID is not found
     if (this->state != MultipartBodyCallback::State::FINISHED)
       throw std::runtime_error("Unfinished or missing file upload.");
   }
@@ -53,7 +53,7 @@ void Request::finalise_upload() {
 void Request::finalise_monitor() {
   try {
     requestType = RequestType::monitor;
-    workspaceID = headers.at("workspace");
+    workspaceID = Workspace::parse_id(headers.at("workspace")); // An invalid ID is not found
     headers.at("id"); // Verify that id is present
   }
   catch (const std::out_of_range& e) {
@@ -68,7 +68,7 @@ void Request::finalise_workspace() {
     if (workspace_cmd == "new")
       workspace_tool = headers.at("tool");
     if (workspace_cmd == "destroy")
-      workspaceID = headers.at("workspace");
+      workspaceID = Workspace::parse_id(headers.at("workspace")); // An invalid ID is not found
   }
   catch (const std::out_of_range& e) {
     requestType = RequestType::malformed;
@@ -81,7 +81,7 @@ void Request::finalise_query() {
     requestType = RequestType::query;
     query = headers.at("cmd");
     if (query.find("kill") != std::string::npos) {
-      workspaceID = headers.at("workspace");
+      workspaceID = Workspace::parse_id(headers.at("workspace")); // An invalid ID is not found
     }
   }
   catch (const std::out_of_range& e) {
@@ -104,7 +104,7 @@ void Request::clear() {
   headers.clear();
   xml.clear();
   query.clear();
-  workspaceID.clear();
+  workspaceID = Workspace::invalidID;
   workspace_cmd.clear();
   workspace_tool.clear();
 }
@@ -170,4 +170,57 @@ bbb::Maybe<Nat> Request::get_id() const {
   return bbb::s2u(headers.at("id"));
 }
 
+String Request::get_tenant() const {
+  auto it = headers.find("tenant");
+  if (it == headers.end() || it->second.empty())
+    return (workspaceID == Workspace::invalidID ? String() : Workspace::format_id(workspaceID));
+  return it->second;
+}
+
+int Request::get_priority() const {
+  auto it = headers.find("priority");
+  if (it == headers.end())
+    return normalPriority;
+  if (it->second == "interactive")
+    return interactivePriority;
+  if (it->second == "normal")
+    return normalPriority;
+  if (it->second == "batch")
+    return batchPriority;
+  try {
+    return std::stoi(it->second);
+  }
+  catch (const std::exception& e) {
+    DEB("Ignoring invalid priority \"" << it->second << "\"");
+    return normalPriority;
+  }
+}
+
+Dur Request::get_time_limit() const {
+  auto it = headers.find("time-limit");
+  if (it == headers.end())
+    return Dur::zero();
+  auto seconds = bbb::s2u(it->second.data(), it->second.size());
+  if (!seconds) {
+    DEB("Ignoring invalid time limit \"" << it->second << "\"");
+    return Dur::zero();
+  }
+  return std::chrono::seconds(seconds.value());
+}
+
+bool Request::get_sweep() const {
+  auto it = headers.find("sweep");
+  return it != headers.end() && it->second == "true";
+}
+
+bool Request::get_sweep_until_definitive() const {
+  auto it = headers.find("sweep-until-definitive");
+  return it != headers.end() && it->second == "true";
+}
+
+bool Request::get_portfolio() const {
+  auto it = headers.find("portfolio");
+  return it != headers.end() && it->second == "true";
+}
+
 }
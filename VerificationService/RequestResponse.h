@@ -32,6 +32,16 @@ namespace RequestResponse {
 
 using namespace Basics;
 
+/**
+ * Priorities of the priority classes a request may name in its "priority" header.
+ * Interactive requests may suspend batch runs to get their cores.
+ */
+enum PriorityClass : int {
+  batchPriority = -10,
+  normalPriority = 0,
+  interactivePriority = 10
+};
+
 class MultipartBodyCallback : public proxygen::RFC1867Codec::Callback {
   // TODO: this way it will only store a single file. Extend (use a callback or something).
    public:
@@ -91,7 +101,7 @@ struct Request : public MultipartBodyCallback {
   std::map<String, String> headers;
   XMLSupport::Xml xml;
   String query;
-  Workspace::WorkspaceID workspaceID;
+  Workspace::WorkspaceID workspaceID = Workspace::invalidID;
   String workspace_cmd;
   String workspace_tool;
 
@@ -120,6 +130,41 @@ struct Request : public MultipartBodyCallback {
   bbb::Maybe<Nat> get_id() const;
   bbb::Maybe<String> get_query_cmd() const;
 
+  /**
+   * Tenant whose share of the server the request is accounted to.
+   * Taken from the "tenant" header, defaults to the request's workspace.
+   */
+  String get_tenant() const;
+
+  /**
+   * Scheduling priority from the "priority" header, higher is more urgent. Defaults to normalPriority.
+   * The header holds either a number or a priority class: "interactive", "normal" or "batch".
+   */
+  int get_priority() const;
+
+  /**
+   * Wall-time limit of the run from the "time-limit" header in seconds, zero (the default) for none.
+   * Time the run spends suspended does not count.
+   */
+  Dur get_time_limit() const;
+
+  /**
+   * Whether braces in the parameters are a parameter sweep ("sweep: true" header), see Portfolio::expand_sweep().
+   * Otherwise the parameters are passed as they are.
+   */
+  bool get_sweep() const;
+
+  /**
+   * Whether a parameter sweep stops at the first point with a definitive verdict ("sweep-until-definitive: true" header).
+   */
+  bool get_sweep_until_definitive() const;
+
+  /**
+   * Whether a request that names a category races all of its tools ("portfolio: true" header)
+   * rather than running the least loaded one (see ToolKit::route()).
+   */
+  bool get_portfolio() const;
+
   String get_bound() {
     assert(headers.count("Content-Type") != 0);
     assert(headers["Content-Type"].find("boundary") != String::npos);
@@ -0,0 +1,171 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   RunHistory.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+#include "RunHistory.h"
+
+namespace RunHistory {
+
+void RunHistory::Fit::add(double x, double y) {
+  weight = weight * decay + 1;
+  this->x = this->x * decay + x;
+  this->y = this->y * decay + y;
+  xx = xx * decay + x * x;
+  xy = xy * decay + x * y;
+  samples++;
+}
+
+double RunHistory::Fit::at(double x) const {
+  double mean = y / weight;
+  double variance = weight * xx - this->x * this->x;
+  if (variance <= 1e-9 * weight * weight) // All runs had inputs of about the same size
+    return mean;
+  double slope = (weight * xy - this->x * y) / variance;
+  slope = std::max(0.0, std::min(slope, 3.0)); // A larger input does not make a run faster, nor more than cubically slower
+  return mean + slope * (x - this->x / weight);
+}
+
+RunHistory& RunHistory::instance() {
+  static RunHistory history;
+  return history;
+}
+
+void RunHistory::load(const String& file) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  this->file = file;
+  if (file.empty())
+    return;
+  Strings lines;
+  if (!bbb::read_file(file, lines))
+    return;
+  size_t first = (lines.size() > maxRecords ? lines.size() - maxRecords : 0);
+  for (size_t i = first; i < lines.size(); i++) {
+    Strings fields;
+    bbb::split_by(lines[i], fields, "\t");
+    if (fields.size() != 7)
+      continue;
+    try {
+      Features features{fields[0], std::stoull(fields[1]), std::stoull(fields[2]), std::stoull(fields[3])};
+      Outcome outcome{Dur(std::stol(fields[4])), static_cast<Nat>(std::stoul(fields[5])), fields[6]};
+      learn_nomutex(features, outcome);
+    }
+    catch (const std::logic_error& e) {
+      DEB("Skipping a malformed line of the run history " << file << ": " << lines[i]);
+    }
+  }
+  if (first > 0) { // Keeps the file from growing without bounds
+    bbb::write_file(file + ".tmp", Strings(lines.begin() + first, lines.end()));
+    if (rename((file + ".tmp").c_str(), file.c_str()) != 0) {
+      DEB("Cannot shorten the run history " << file << ": " << strerror(errno));
+    }
+  }
+  DEB("Learnt " << lines.size() - first << " runs from " << file);
+}
+
+void RunHistory::record(const Features& features, const Outcome& outcome) {
+  if (features.empty())
+    return;
+  String verdict = outcome.verdict.substr(0, outcome.verdict.find('\n'));
+  std::replace(verdict.begin(), verdict.end(), '\t', ' ');
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  learn_nomutex(features, {outcome.runTime, outcome.peakMemory, verdict});
+  if (file.empty())
+    return;
+  std::ofstream out(file, std::ios::app);
+  out << features.tool << "\t" << features.parameters << "\t" << features.inputBytes << "\t" << features.inputs << "\t"
+      << outcome.runTime.count() << "\t" << outcome.peakMemory << "\t" << verdict << "\n";
+}
+
+void RunHistory::learn_nomutex(const Features& features, const Outcome& outcome) {
+  double x = std::log1p(static_cast<double>(features.inputBytes));
+  double runTime = std::log(std::max(1e-3, std::chrono::duration<double>(outcome.runTime).count()));
+  double memory = std::log(std::max<double>(1, outcome.peakMemory));
+  for (Model* model : {&byTool[features.tool], &byParameters[parameters_key(features)]}) {
+    model->runTime.add(x, runTime);
+    model->memory.add(x, memory);
+  }
+  Hash key = exact_key(features);
+  if (exact.find(key) == exact.end()) {
+    exactOrder.push_back(key);
+    if (exactOrder.size() > maxExact) {
+      exact.erase(exactOrder.front());
+      exactOrder.pop_front();
+    }
+  }
+  exact[key] = outcome;
+}
+
+Prediction RunHistory::predict(const Features& features) const {
+  Prediction prediction;
+  if (features.empty())
+    return prediction;
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  auto it = exact.find(exact_key(features));
+  if (it != exact.end()) {
+    prediction.runTime = std::max(Dur(1), it->second.runTime);
+    prediction.memory = it->second.peakMemory;
+    prediction.exact = true;
+    return prediction;
+  }
+  const Model* model = usable(byParameters, parameters_key(features));
+  if (!model)
+    model = usable(byTool, features.tool);
+  if (!model)
+    return prediction;
+  double x = std::log1p(static_cast<double>(features.inputBytes));
+  prediction.runTime = std::max(Dur(1), std::chrono::duration_cast<Dur>(std::chrono::duration<double>(std::exp(model->runTime.at(x)))));
+  prediction.memory = static_cast<Nat>(std::min<double>(std::exp(model->memory.at(x)), std::numeric_limits<Nat>::max()));
+  return prediction;
+}
+
+const RunHistory::Model* RunHistory::usable(const std::map<String, Model>& models, const String& key) {
+  auto it = models.find(key);
+  return (it != models.end() && it->second.runTime.samples >= minSamples ? &it->second : nullptr);
+}
+
+String RunHistory::parameters_key(const Features& features) {
+  return features.tool + "\t" + std::to_string(features.parameters);
+}
+
+Hash RunHistory::exact_key(const Features& features) {
+  return std::hash<String>{}(parameters_key(features)) * 31 + features.inputs;
+}
+
+Features RunHistory::features_of(Archive::Archive& archive, Archive::ReportID reportID) {
+  Features features;
+  auto report = archive.borrow_report(reportID);
+  if (!report->tool)
+    return features;
+  features.tool = report->tool->get_name() + " " + report->tool->get_version();
+  std::replace(features.tool.begin(), features.tool.end(), '\t', ' '); // Separates the fields in the file
+  String parameters;
+  for (const String& parameter : report->parameters)
+    parameters += parameter + "\n";
+  features.parameters = std::hash<String>{}(parameters);
+  for (Archive::FileID id : report->inputFiles) {
+    Archive::FileDigest file = archive.get_file_digest(id);
+    features.inputBytes += file.size;
+    features.inputs = features.inputs * 31 + file.digest;
+  }
+  return features;
+}
+
+}
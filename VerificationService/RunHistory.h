@@ -0,0 +1,131 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   RunHistory.h
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "bbb.h"
+#include "Archive.h"
+
+namespace RunHistory {
+
+using namespace Basics;
+
+/**
+ * What a run is recognised by: its tool, its parameters and its inputs
+ */
+struct Features {
+  String tool;             // Name and version of the tool, empty if the run is not recorded
+  Hash parameters = 0;     // Digest of the parameters
+  uint64_t inputBytes = 0; // Size of the input files together
+  Hash inputs = 0;         // Digest of the contents of the input files
+
+  bool empty() const { return tool.empty(); }
+};
+
+/**
+ * How a finished run went
+ */
+struct Outcome {
+  Dur runTime;     // Without the time the run was suspended
+  Nat peakMemory;  // Peak resident set size, MB
+  String verdict;  // Parsed output of the tool
+};
+
+/**
+ * Expected run time and memory of a run, zero where nothing is known
+ */
+struct Prediction {
+  Dur runTime = Dur::zero();
+  Nat memory = 0; // MB
+  bool exact = false; // The same run (tool, parameters and inputs) ended before
+
+  bool known() const { return runTime > Dur::zero(); }
+};
+
+/**
+ * Run times and peak memory of finished runs, and predictions made from them.
+ *
+ * A run that ended before with the same tool, parameters and inputs is expected to take what it took.
+ * Otherwise the run time and memory are fitted against the input size, as a power law (least squares in log-log
+ * space, older runs weigh less), per tool and parameters if there were enough runs of them, else per tool.
+ * Process-wide; the runs are appended to a file and learnt from again when the server starts.
+ */
+class RunHistory {
+public:
+  static const Nat minSamples = 3;     // Runs a fit needs before it predicts
+  static constexpr double decay = 0.98; // Weight of a run relative to the next one
+  static const size_t maxExact = 10000; // Runs remembered by their inputs
+  static const size_t maxRecords = 100000; // Runs kept in the file
+
+  static RunHistory& instance();
+
+  RunHistory(const RunHistory& other) = delete;
+  RunHistory& operator=(const RunHistory& other) = delete;
+
+  /**
+   * Learns the runs in the file, and appends the runs recorded from now on to it
+   * @param file Empty to keep the history in memory only
+   */
+  void load(const String& file);
+
+  void record(const Features& features, const Outcome& outcome);
+  Prediction predict(const Features& features) const;
+
+  /**
+   * Reads the features of the run of the report: its tool, parameters and the digests of its input files
+   * (see Archive::get_file_digest()). Needs the report's lock not to be held.
+   */
+  static Features features_of(Archive::Archive& archive, Archive::ReportID reportID);
+
+private:
+  RunHistory() {}
+
+  /**
+   * Weighted least squares of y = a + b * x, with exponential forgetting
+   */
+  struct Fit {
+    double weight = 0, x = 0, y = 0, xx = 0, xy = 0;
+    Nat samples = 0;
+
+    void add(double x, double y);
+    double at(double x) const;
+  };
+
+  struct Model {
+    Fit runTime; // log(seconds) against log(input bytes)
+    Fit memory;  // log(MB) against log(input bytes)
+  };
+
+  void learn_nomutex(const Features& features, const Outcome& outcome);
+
+  /// @return nullptr if the model does not have minSamples runs
+  static const Model* usable(const std::map<String, Model>& models, const String& key);
+
+  static String parameters_key(const Features& features);
+  static Hash exact_key(const Features& features);
+
+  mutable std::mutex mutex;
+  std::map<String, Model> byTool;       // By tool
+  std::map<String, Model> byParameters; // By tool and parameters
+  std::unordered_map<Hash, Outcome> exact;
+  std::deque<Hash> exactOrder; // Oldest first, to forget the oldest once there are maxExact
+  String file;
+};
+
+}
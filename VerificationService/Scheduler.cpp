@@ -0,0 +1,394 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Scheduler.cpp
+ */
+
+#include <algorithm>
+#include <limits>
+#include <sys/sysinfo.h>
+
+#include "Scheduler.h"
+
+using namespace std::chrono_literals;
+
+namespace Scheduler {
+
+const SharedLedger& Ledger::instance() {
+  static const SharedLedger ledger = std::make_shared<Ledger>();
+  return ledger;
+}
+
+
+Allocation::Allocation() {}
+
+Allocation::Allocation(ToolKit::ToolReservation&& reservation, Affinity::CoreSet&& cores, const Demand& demand, const SharedLedger& ledger) :
+    reservation(std::move(reservation)),
+    cores(std::move(cores)),
+    demand(demand),
+    ledger(ledger) {
+  std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+  ledger->used.cores += demand.cores;
+  ledger->used.memory += demand.memory;
+  for (const String& category : demand.categories)
+    ledger->runsPerCategory[category]++;
+  ledger->runsPerTenant[demand.tenant]++;
+}
+
+Allocation::Allocation(Allocation&& other) noexcept {
+  *this = std::move(other);
+}
+
+Allocation& Allocation::operator=(Allocation&& other) noexcept {
+  release();
+  reservation = std::move(other.reservation);
+  cores = std::move(other.cores);
+  demand = std::move(other.demand);
+  ledger = std::move(other.ledger);
+  suspended = other.suspended;
+  other.ledger.reset();
+  return *this;
+}
+
+Allocation::~Allocation() {
+  release();
+}
+
+void Allocation::release() {
+  if (!ledger)
+    return;
+  {
+    std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+    if (!suspended) // The cores were returned already
+      ledger->used.cores -= demand.cores;
+    ledger->used.memory -= demand.memory;
+    for (const String& category : demand.categories)
+      ledger->runsPerCategory[category]--;
+    if (--ledger->runsPerTenant[demand.tenant] == 0)
+      ledger->runsPerTenant.erase(demand.tenant);
+  }
+  ledger.reset();
+  cores.release();
+  reservation = ToolKit::ToolReservation(); // Frees the tool's instance slot
+  suspended = false;
+}
+
+void Allocation::suspend() {
+  if (!ledger || suspended)
+    return;
+  {
+    std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+    ledger->used.cores -= demand.cores;
+  }
+  cores.release();
+  suspended = true;
+}
+
+bool Allocation::resume() {
+  if (!ledger || !suspended)
+    return true;
+  std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+  if (ledger->used.cores + demand.cores > ledger->capacity.cores)
+    return false;
+  Affinity::CoreSet newCores = Affinity::CoreAllocator::instance().allocate(demand.cores);
+  if (newCores.empty())
+    return false; // Cores are taken by runs of other server threads
+  ledger->used.cores += demand.cores;
+  cores = std::move(newCores);
+  suspended = false;
+  return true;
+}
+
+
+JobScheduler::JobScheduler(Archive::Archive& archive, ToolKit::ToolKit& toolKit, Capacity nodeCapacity) :
+    abandonTimeout(1min),
+    preemptingPriority(std::numeric_limits<int>::max()),
+    preemptiblePriority(std::numeric_limits<int>::min()),
+    unknownRunTime(1min),
+    agingRate(1.0),
+    defaultTimeLimitFactor(0.0),
+    minDefaultTimeLimit(10min),
+    archive(archive),
+    toolKit(toolKit),
+    capacity(nodeCapacity),
+    ledger(Ledger::instance()),
+    nextSequence(0) {
+  std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+  ledger->capacity = capacity;
+  DEB("Scheduler capacity: " << capacity.cores << " cores, " << capacity.memory << " MB");
+}
+
+void JobScheduler::submit(Job&& job) {
+  job.features = RunHistory::RunHistory::features_of(archive, job.reportID); // Borrows the report, so before the lock
+  job.expected = RunHistory::RunHistory::instance().predict(job.features);
+  if (job.timeLimit == Dur::zero() && job.expected.known() && defaultTimeLimitFactor > 0) {
+    job.timeLimit = std::max(minDefaultTimeLimit, std::chrono::duration_cast<Dur>(job.expected.runTime * defaultTimeLimitFactor));
+    DEB("Report " << job.reportID << " is expected to run " << job.expected.runTime.count() << " ms, limited to "
+        << job.timeLimit.count() << " ms");
+  }
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  job.sequence = nextSequence++;
+  job.submitted = SClock::now();
+  {
+    auto report = archive.borrow_report(job.reportID);
+    report->updateLastMonitored(); // The client is just talking to us
+    report->runningResult = "Queued.";
+  }
+  DEB("Queueing report " << job.reportID << " of tenant " << job.tenant << " with priority " << job.priority);
+  queues[job.priority][job.tenant].push_back(std::move(job));
+}
+
+bool JobScheduler::cancel(Archive::ReportID reportID) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  for (auto& level : queues) {
+    for (auto& tenant : level.second) {
+      auto& fifo = tenant.second;
+      auto it = std::find_if(fifo.begin(), fifo.end(), [&] (const Job& job) { return job.reportID == reportID; });
+      if (it != fifo.end()) {
+        Portfolio::SharedGroup group = std::move(it->group);
+        fifo.erase(it);
+        if (group)
+          group->member_dropped(reportID, archive);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool JobScheduler::is_queued(Archive::ReportID reportID) const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  for (const auto& level : queues)
+    for (const auto& tenant : level.second)
+      for (const Job& job : tenant.second)
+        if (job.reportID == reportID)
+          return true;
+  return false;
+}
+
+bool JobScheduler::empty() const {
+  return size() == 0;
+}
+
+size_t JobScheduler::size() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  size_t result = 0;
+  for (const auto& level : queues)
+    for (const auto& tenant : level.second)
+      result += tenant.second.size();
+  return result;
+}
+
+Capacity JobScheduler::get_used() const {
+  std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+  return ledger->used;
+}
+
+Demand JobScheduler::demand_of(const Job& job) const {
+  Demand demand;
+  // A job demanding more than the whole node gets the whole node instead of waiting forever
+  demand.cores = std::min(job.tool->get_cores_per_run(), capacity.cores);
+  Nat memory = (job.expected.memory > 0 ? job.expected.memory + job.expected.memory / 4 : job.tool->get_memory_per_run()); // A quarter to spare
+  demand.memory = std::min(memory, capacity.memory);
+  demand.categories = job.tool->get_capabilities();
+  demand.tenant = job.tenant;
+  return demand;
+}
+
+double JobScheduler::rank(const Job& job, TimePoint now) const {
+  Dur expected = (job.expected.known() ? job.expected.runTime : unknownRunTime);
+  return std::chrono::duration<double>(expected).count() - agingRate * std::chrono::duration<double>(now - job.submitted).count();
+}
+
+/// @param withCores false to check everything but the cores
+bool JobScheduler::fits_nomutex(const Job& job, const Demand& demand, bool withCores) const {
+  if (!job.tool->is_free())
+    return false;
+  std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+  if ((withCores && ledger->used.cores + demand.cores > capacity.cores) || ledger->used.memory + demand.memory > capacity.memory)
+    return false;
+  for (const String& category : demand.categories) {
+    auto it = ledger->runsPerCategory.find(category);
+    Nat running = (it == ledger->runsPerCategory.end() ? 0 : it->second);
+    if (running >= toolKit.get_category_capacity(category))
+      return false;
+  }
+  return true;
+}
+
+std::vector<Dispatch> JobScheduler::next_dispatches() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  std::vector<Dispatch> dispatches;
+  TimePoint now = SClock::now();
+
+  // Drop jobs whose clients went away or whose portfolio is already decided:
+  for (auto& level : queues) {
+    for (auto& tenant : level.second) {
+      auto& fifo = tenant.second;
+      fifo.erase(std::remove_if(fifo.begin(), fifo.end(), [&] (const Job& job) {
+        if (job.group && job.group->is_decided()) {
+          archive.borrow_report(job.reportID)->runningResult = "Not started: another tool of the portfolio decided the verification.";
+          return true;
+        }
+        if (now - archive.borrow_report(job.monitored_report())->getLastMonitored() <= abandonTimeout)
+          return false;
+        DEB("Dropping abandoned job of report " << job.reportID);
+        archive.borrow_report(job.reportID)->runningResult = "Dropped from the queue: not monitored by the client.";
+        if (job.group)
+          job.group->member_dropped(job.reportID, archive);
+        return true;
+      }), fifo.end());
+    }
+  }
+
+  for (auto& level : queues) {
+    TenantQueues& tenants = level.second;
+    bool dispatched = true;
+    while (dispatched) {
+      dispatched = false;
+      // Fair share: tenants with fewer running jobs first, ties broken by the age of their oldest job
+      std::vector<TenantQueues::iterator> order;
+      for (auto it = tenants.begin(); it != tenants.end(); ++it)
+        if (!it->second.empty())
+          order.push_back(it);
+      {
+        std::lock_guard<decltype(ledger->mutex)> lockGuard(ledger->mutex);
+        auto running = [&] (const String& tenant) -> Nat {
+          auto it = ledger->runsPerTenant.find(tenant);
+          return (it == ledger->runsPerTenant.end() ? 0 : it->second);
+        };
+        std::sort(order.begin(), order.end(), [&] (TenantQueues::iterator a, TenantQueues::iterator b) {
+          Nat ra = running(a->first), rb = running(b->first);
+          return ra != rb ? ra < rb : a->second.front().sequence < b->second.front().sequence;
+        });
+      }
+      for (auto tenantIt : order) {
+        auto& fifo = tenantIt->second;
+        std::vector<std::pair<double, std::deque<Job>::iterator>> ranked;
+        for (auto jobIt = fifo.begin(); jobIt != fifo.end(); ++jobIt)
+          ranked.emplace_back(rank(*jobIt, now), jobIt);
+        std::stable_sort(ranked.begin(), ranked.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& entry : ranked) {
+          auto jobIt = entry.second;
+          Demand demand = demand_of(*jobIt);
+          Allocation allocation;
+          std::unique_lock<decltype(ledger->dispatchMutex)> dispatchLock(ledger->dispatchMutex); // Other threads' schedulers book the same ledger
+          if (fits_nomutex(*jobIt, demand)) {
+            ToolKit::ToolReservation reservation(jobIt->tool);
+            Affinity::CoreSet cores;
+            if (reservation) // Otherwise cores may be taken by runs of other server threads
+              cores = Affinity::CoreAllocator::instance().allocate(demand.cores);
+            if (!cores.empty()) {
+              DEB("Dispatching report " << jobIt->reportID << " of tenant " << jobIt->tenant << " to cores " << cores.to_string());
+              allocation = Allocation(std::move(reservation), std::move(cores), demand, ledger);
+            }
+          }
+          dispatchLock.unlock();
+          Remote::Slot slot;
+          if (!allocation) {
+            slot = Remote::WorkerPool::instance().reserve(jobIt->tool->get_name(), demand.cores, demand.memory);
+            if (!slot)
+              continue;
+            DEB("Dispatching report " << jobIt->reportID << " of tenant " << jobIt->tenant << " to worker agent "
+                << slot.get_worker()->get_name());
+          }
+          dispatches.push_back({std::move(*jobIt), std::move(allocation), std::move(slot)});
+          fifo.erase(jobIt);
+          dispatched = true;
+          break;
+        }
+        if (dispatched)
+          break; // Running counts changed, recompute the tenant order
+      }
+    }
+  }
+  return dispatches;
+}
+
+Allocation JobScheduler::allocate(const Job& job) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  Demand demand = demand_of(job);
+  ToolKit::ToolReservation reservation(job.tool);
+  Affinity::CoreSet cores = Affinity::CoreAllocator::instance().allocate(demand.cores); // Empty if too few are free
+  return Allocation(std::move(reservation), std::move(cores), demand, ledger);
+}
+
+Nat JobScheduler::cores_to_preempt() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  Nat wanted = 0;
+  for (const auto& level : queues) {
+    if (level.first < preemptingPriority)
+      break; // Levels are ordered by priority, highest first
+    for (const auto& tenant : level.second)
+      for (const Job& job : tenant.second) {
+        Demand demand = demand_of(job);
+        if (fits_nomutex(job, demand, false))
+          wanted += demand.cores;
+      }
+  }
+  if (wanted == 0)
+    return 0;
+  Nat available = std::min(capacity.cores - std::min(capacity.cores, get_used().cores), Affinity::CoreAllocator::instance().free());
+  return (wanted > available ? wanted - available : 0);
+}
+
+void JobScheduler::show_position(Archive::ReportID reportID) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  TimePoint now = SClock::now();
+  const Job* found = nullptr;
+  int foundLevel = 0;
+  size_t total = 0;
+  for (const auto& level : queues)
+    for (const auto& tenant : level.second)
+      for (const Job& job : tenant.second) {
+        total++;
+        if (job.reportID == reportID) {
+          found = &job;
+          foundLevel = level.first;
+        }
+      }
+  if (!found)
+    return;
+  // Jobs of higher priority, and jobs of the same priority ranked before it (see next_dispatches()), are ahead:
+  double foundRank = rank(*found, now);
+  size_t ahead = 0;
+  for (const auto& level : queues) {
+    if (level.first < foundLevel)
+      break; // Levels are ordered by priority, highest first
+    for (const auto& tenant : level.second)
+      for (const Job& job : tenant.second) {
+        if (level.first > foundLevel) {
+          ahead++;
+          continue;
+        }
+        double jobRank = rank(job, now);
+        if (jobRank < foundRank || (jobRank == foundRank && job.sequence < found->sequence))
+          ahead++;
+      }
+  }
+  String result = "Queued (position " + std::to_string(ahead + 1) + " of " + std::to_string(total) + ").";
+  if (found->expected.known())
+    result += " Expected to run for about " + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(found->expected.runTime).count()) + " s.";
+  archive.borrow_report(reportID)->runningResult = result;
+}
+
+Capacity JobScheduler::detect_node_capacity() {
+  Capacity result;
+  result.cores = Affinity::CoreAllocator::instance().size();
+  struct sysinfo info;
+  if (sysinfo(&info) == 0)
+    result.memory = (static_cast<uint64_t>(info.totalram) * info.mem_unit / (1024 * 1024)) * 9 / 10;
+  else
+    result.memory = ToolKit::unlimitedCapacity;
+  return result;
+}
+
+}
@@ -0,0 +1,255 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Scheduler.h
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bbb.h"
+#include "Affinity.h"
+#include "Archive.h"
+#include "Portfolio.h"
+#include "Remote.h"
+#include "RunHistory.h"
+#include "ToolKit.h"
+#include "Workspace.h"
+
+namespace Scheduler {
+
+using namespace Basics;
+
+/**
+ * Amount of node resources. Memory is in MB.
+ */
+struct Capacity {
+  Nat cores = 0;
+  Nat memory = 0;
+};
+
+/**
+ * Node-wide bookkeeping of the resources held by allocations.
+ * Process-wide like Affinity::CoreAllocator, so that the schedulers of all service threads share the node;
+ * shared with the allocations, so that an allocation may outlive the scheduler.
+ */
+struct Ledger {
+  static const std::shared_ptr<Ledger>& instance();
+
+  std::mutex mutex;
+  std::mutex dispatchMutex; // Held by a scheduler from the check that a job fits until its allocation is booked
+  Capacity capacity; // Of the node, set by the scheduler
+  Capacity used;
+  std::map<String, Nat> runsPerCategory;
+  std::map<String, Nat> runsPerTenant;
+};
+using SharedLedger = std::shared_ptr<Ledger>;
+
+/**
+ * Resources requested by a single run
+ */
+struct Demand {
+  Nat cores = 1;
+  Nat memory = ToolKit::defaultMemoryPerRun;
+  ToolKit::Capabilities categories;
+  String tenant;
+};
+
+/**
+ * Resources granted to a single run: an instance slot of the tool, a set of CPU cores the run is pinned to, memory
+ * and a slot in each of the tool's categories. Everything is released on destruction.
+ */
+class Allocation {
+public:
+  Allocation();
+  Allocation(ToolKit::ToolReservation&& reservation, Affinity::CoreSet&& cores, const Demand& demand, const SharedLedger& ledger);
+  Allocation(const Allocation& other) = delete;
+  Allocation(Allocation&& other) noexcept;
+  Allocation& operator=(const Allocation& other) = delete;
+  Allocation& operator=(Allocation&& other) noexcept;
+  virtual ~Allocation();
+
+  operator bool() const { return ledger != nullptr; }
+  const Demand& getDemand() const { return demand; }
+  const Affinity::CoreSet& getCores() const { return cores; }
+
+  /**
+   * Returns all held resources. Safe to call repeatedly.
+   */
+  void release();
+
+  /**
+   * Lends the cores to other runs while the run is suspended: they go back to the CoreAllocator and the ledger.
+   * Memory, the tool's instance slot and the category slots stay held, a stopped process keeps its memory.
+   */
+  void suspend();
+
+  /**
+   * Takes cores again after suspend(), not necessarily the same ones.
+   * @return false if there are not enough free cores at the moment
+   */
+  bool resume();
+
+  bool is_suspended() const { return suspended; }
+
+private:
+  ToolKit::ToolReservation reservation;
+  Affinity::CoreSet cores;
+  Demand demand;
+  SharedLedger ledger;
+  bool suspended = false;
+};
+
+/**
+ * A verification waiting for resources
+ */
+struct Job {
+  Archive::ReportID reportID;
+  Workspace::SharedWorkspace workspace;
+  String callSchema;
+  ToolKit::SharedTool tool;
+  String tenant;      // Fair share is computed among tenants (workspace ID unless the request names one)
+  int priority = 0;   // Higher priority jobs are dispatched first
+  Dur timeLimit = Dur::zero(); // Wall-time limit of the run without the time it was suspended, zero for none
+  Nat sequence = 0;   // FIFO order, assigned by the scheduler
+  TimePoint submitted;
+  Portfolio::SharedGroup group; // Set for members of a portfolio verification
+  RunHistory::Features features;   // What the run is recorded under in the RunHistory, filled in by submit()
+  RunHistory::Prediction expected; // Filled in by submit()
+
+  /**
+   * The report the client monitors: the portfolio's report for its members, the job's own report otherwise
+   */
+  Archive::ReportID monitored_report() const { return group ? group->get_parent() : reportID; }
+};
+
+/**
+ * A job together with the resources granted to it, ready to be launched
+ */
+struct Dispatch {
+  Job job;
+  Allocation allocation; // Empty for a job that runs on a worker agent
+  Remote::Slot slot;     // Set for a job that runs on a worker agent
+};
+
+/**
+ * Queues verification jobs and hands them out once the node can run them.
+ *
+ * Jobs are ordered by priority first. Among jobs of the same priority, the tenant with the fewest
+ * running jobs goes first and the jobs of one tenant are taken shortest expected run time first (see RunHistory),
+ * a job catching up with shorter ones as it waits (see agingRate). A job is dispatched
+ * only if an instance slot of its tool, a slot in each of the tool's categories, and the cores and memory
+ * it demands are available, so the node is kept busy without being over-subscribed. The schedulers of all service threads
+ * book the same Ledger and tool reservation counters (see ToolKit::ReservationCounters).
+ * A job demands the memory its runs took so far, if the RunHistory knows, otherwise what its tool declares.
+ * Concurrent runs get disjoint sets of cores from the process-wide Affinity::CoreAllocator.
+ * A job that does not fit does not block smaller jobs behind it.
+ * A job that does not fit into the node goes to a connected worker agent with its tool and enough free capacity,
+ * if there is one (see Remote::WorkerPool); the node is always preferred.
+ *
+ * Jobs of priority preemptingPriority and higher (interactive requests) may take the cores of running jobs
+ * of priority preemptiblePriority and lower (batch runs), which are suspended meanwhile; see cores_to_preempt().
+ */
+class JobScheduler {
+public:
+  JobScheduler(Archive::Archive& archive, ToolKit::ToolKit& toolKit, Capacity nodeCapacity = detect_node_capacity());
+  JobScheduler(const JobScheduler& other) = delete;
+  JobScheduler& operator=(const JobScheduler& other) = delete;
+
+  /**
+   * Enqueues a job. The job's report shows its queue position until it is dispatched (see show_position()).
+   * A job without a time limit gets one from its expected run time if defaultTimeLimitFactor is set.
+   * @param job
+   */
+  void submit(Job&& job);
+
+  /**
+   * Removes a queued job.
+   * @return true if the job was queued, false if there was no such job
+   */
+  bool cancel(Archive::ReportID reportID);
+
+  bool is_queued(Archive::ReportID reportID) const;
+
+  /**
+   * Writes the current queue position of a queued job into its report, for the client monitoring it.
+   * Computed on demand rather than on every change of the queue, which would rewrite every queued report.
+   * Does nothing if the job is not queued.
+   */
+  void show_position(Archive::ReportID reportID);
+  bool empty() const;
+  size_t size() const;
+
+  /**
+   * Takes all queued jobs that fit into the currently free resources and allocates the resources for them.
+   * Jobs that were not monitored by their client for longer than abandonTimeout are dropped,
+   * as are members of portfolios that were already decided.
+   * @return Jobs to be launched by the caller (outside of any scheduler lock)
+   */
+  std::vector<Dispatch> next_dispatches();
+
+  /**
+   * Books the resources of a job that runs already, taken over from an earlier server (see Zygote::held()).
+   * The run is accounted even if the node is full; it gets cores only if there are free ones, and a slot of its tool if one is free.
+   */
+  Allocation allocate(const Job& job);
+
+  /**
+   * @return Cores the queued preempting jobs miss, i.e. how many cores preemptible runs should lend them.
+   *         Only jobs that would fit if the cores were free are counted.
+   */
+  Nat cores_to_preempt() const;
+
+  Capacity get_capacity() const { return capacity; }
+  Capacity get_used() const;
+
+  /**
+   * Cores available to runs and 90 % of the physical memory
+   */
+  static Capacity detect_node_capacity();
+
+  Dur abandonTimeout;
+  int preemptingPriority;
+  int preemptiblePriority;
+  Dur unknownRunTime;           // Expected run time of a job the RunHistory knows nothing of
+  double agingRate;             // Seconds of expected run time a second of waiting makes up for
+  double defaultTimeLimitFactor; // Time limit of a job without one, relative to its expected run time; zero (default) for none.
+                                 // Runs killed by it are not recorded, so the history learns only the runs that fit.
+  Dur minDefaultTimeLimit;      // The least time limit given by defaultTimeLimitFactor
+
+private:
+  using TenantQueues = std::map<String, std::deque<Job>>;
+
+  bool fits_nomutex(const Job& job, const Demand& demand, bool withCores = true) const;
+  Demand demand_of(const Job& job) const;
+
+  /**
+   * @return Order of the job among the queued jobs of its priority and tenant, lower first
+   */
+  double rank(const Job& job, TimePoint now) const;
+
+  mutable std::mutex mutex;
+  Archive::Archive& archive;
+  ToolKit::ToolKit& toolKit;
+  Capacity capacity;
+  SharedLedger ledger;
+  std::map<int, TenantQueues, std::greater<int>> queues; // priority -> tenant -> FIFO
+  Nat nextSequence;
+};
+
+}
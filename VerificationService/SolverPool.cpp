@@ -0,0 +1,395 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   SolverPool.cpp
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SolverPool.h"
+
+namespace SolverPool {
+
+namespace {
+
+const int exitedWithError = 1 << 8; // Wait status of a process that exited with 1
+
+/// Writes nothing if fd is -1
+void write_all(int fd, const String& data) {
+  if (fd < 0)
+    return;
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    written += n;
+  }
+}
+
+/// Resident memory of the process in MB
+Nat resident_memory(pid_t pid) {
+  Strings lines;
+  if (!bbb::read_file("/proc/" + std::to_string(pid) + "/statm", lines) || lines.empty())
+    return 0;
+  unsigned long size = 0, resident = 0;
+  if (sscanf(lines[0].c_str(), "%lu %lu", &size, &resident) != 2)
+    return 0;
+  return (resident * sysconf(_SC_PAGESIZE)) >> 20;
+}
+
+}
+
+Query::Query(pid_t worker, Strings&& inputFiles, int out, int err) :
+    worker(worker),
+    inputFiles(std::move(inputFiles)),
+    out(out),
+    err(err),
+    done(false),
+    status(0) { }
+
+pid_t Query::wait(pid_t pid, int* status) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!done)
+    return 0;
+  *status = this->status;
+  return pid;
+}
+
+void Query::kill(pid_t pid, int signal) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (!done) // Otherwise the session process may be answering another query already
+    Launcher::kill_group(worker, signal);
+}
+
+void Query::finish(int status) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  this->status = status;
+  done = true;
+}
+
+
+Worker::Worker(const String& command, const ToolKit::SessionSettings& settings) :
+    command(command),
+    settings(settings),
+    busy(false),
+    stopping(false),
+    lastUsed(SClock::now()),
+    pid(-1),
+    channel(-1),
+    uses(0),
+    sequence(0),
+    thread(&Worker::serve, this) { }
+
+Worker::~Worker() {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    stopping = true;
+    if (pid > 0)
+      Launcher::kill_group(pid, SIGKILL); // Ends a query in progress
+  }
+  wakeUp.notify_all();
+  thread.join();
+}
+
+bool Worker::try_reserve() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (busy)
+    return false;
+  busy = true;
+  return true;
+}
+
+void Worker::unreserve() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  busy = false;
+}
+
+bool Worker::try_retire(TimePoint now) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (busy || now - lastUsed < std::chrono::seconds(settings.idleTimeout))
+    return false;
+  busy = true;
+  return true;
+}
+
+pid_t Worker::ensure_started() {
+  if (pid > 0) // Only the worker's own thread changes it, and it is idle while the worker is reserved
+    return pid;
+  String path;
+  Strings arguments;
+  Launcher::parse_command(command, path, arguments);
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+    throw Launcher::LaunchError(String("Cannot create a session channel: ") + strerror(errno));
+  Launcher::FileDescriptor child(sockets[1]);
+  pid_t started;
+  try {
+    started = Launcher::start(path, arguments, ".", child.fd, child.fd, child.fd, nullptr);
+  }
+  catch (...) {
+    close(sockets[0]);
+    throw;
+  }
+  fcntl(sockets[0], F_SETFL, fcntl(sockets[0], F_GETFL) | O_NONBLOCK);
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  pid = started;
+  channel = sockets[0];
+  uses = 0;
+  DEB("Started session process " << pid << ": " << command);
+  return pid;
+}
+
+void Worker::submit(const std::shared_ptr<Query>& query) {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    pending = query;
+  }
+  wakeUp.notify_all();
+}
+
+void Worker::serve() {
+  for (;;) {
+    std::shared_ptr<Query> query;
+    {
+      std::unique_lock<decltype(mutex)> lock(mutex);
+      wakeUp.wait(lock, [this] () { return stopping || pending; });
+      if (stopping)
+        break;
+      query = std::move(pending);
+      pending.reset();
+    }
+    int status = answer(*query);
+    if (needs_recycling())
+      stop_process();
+    // Idle before the run learns the answer, so that the run's next query can reuse the worker;
+    // both under the mutex, so that the query is not killed after a new reservation:
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    busy = false;
+    lastUsed = SClock::now();
+    query->finish(status);
+  }
+  if (pid > 0)
+    stop_process();
+}
+
+/// @return Wait status for the query
+int Worker::answer(Query& query) {
+  String script;
+  for (const String& inputFile : query.get_input_files()) {
+    String content;
+    if (!bbb::read_file(inputFile, content)) {
+      write_all(query.get_error_output(), "Cannot read input file " + inputFile + "\n");
+      return exitedWithError;
+    }
+    script += content;
+    script += "\n";
+  }
+  String marker = "verify-server-query-" + std::to_string(++sequence);
+  script += "(echo \"" + marker + "\")\n";
+  if (!exchange(script, marker, query.get_output())) {
+    // The session process ended before answering (a crash, a limit, (exit) in the input, or the query was killed):
+    DEB("Session process " << pid << " ended while answering a query.");
+    return collect_process();
+  }
+  uses++;
+  // (reset) rather than (pop): the logic and the options the query set have to go too, the next query sets its own.
+  // Whatever it prints (with :print-success) is not part of the query's output.
+  String resetMarker = "verify-server-reset-" + std::to_string(sequence);
+  if (!exchange("(reset)\n(echo \"" + resetMarker + "\")\n", resetMarker, -1)) {
+    DEB("Session process " << pid << " ended after answering a query.");
+    collect_process(); // The query has its answer, the next one starts a new process
+  }
+  return 0;
+}
+
+/// Collects the ended session process.
+/// @return Its wait status
+int Worker::collect_process() {
+  int status = 0;
+  waitpid(pid, &status, 0);
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  close(channel);
+  channel = -1;
+  pid = -1;
+  return status;
+}
+
+/// Sends the script and copies the output to out (-1 to drop it) until the line with the marker.
+/// @return false if the session process closed its output first
+bool Worker::exchange(const String& script, const String& marker, int out) {
+  size_t written = 0;
+  String line;
+  char buffer[64 * 1024];
+  for (;;) {
+    pollfd fds{channel, static_cast<short>(POLLIN | (written < script.size() ? POLLOUT : 0)), 0};
+    if (::poll(&fds, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if ((fds.revents & POLLOUT) && written < script.size()) {
+      ssize_t n = send(channel, script.data() + written, script.size() - written, MSG_NOSIGNAL);
+      if (n > 0)
+        written += n;
+      else if (n < 0 && errno != EAGAIN && errno != EINTR)
+        written = script.size(); // The process stopped reading; its output tells why
+    }
+    if (fds.revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t n = read(channel, buffer, sizeof(buffer));
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        write_all(out, line);
+        return false;
+      }
+      String output;
+      for (ssize_t i = 0; i < n; i++) {
+        if (buffer[i] != '\n') {
+          line += buffer[i];
+          continue;
+        }
+        if (line == marker) {
+          write_all(out, output);
+          return true;
+        }
+        output += line;
+        output += '\n';
+        line.clear();
+      }
+      write_all(out, output);
+    }
+  }
+}
+
+bool Worker::needs_recycling() const {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (pid <= 0)
+    return false;
+  return uses >= settings.maxUses || (settings.maxMemory > 0 && resident_memory(pid) > settings.maxMemory);
+}
+
+/// Closes the input of the session process and gives it a moment to exit before killing it.
+void Worker::stop_process() {
+  DEB("Stopping session process " << pid << " after " << uses << " queries.");
+  shutdown(channel, SHUT_WR);
+  int status;
+  bool exited = false;
+  for (int i = 0; i < 100 && !exited; i++) {
+    exited = (waitpid(pid, &status, WNOHANG) == pid);
+    if (!exited)
+      usleep(10000);
+  }
+  if (!exited) {
+    Launcher::kill_group(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+  }
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  close(channel);
+  channel = -1;
+  pid = -1;
+}
+
+
+Pool& Pool::instance() {
+  static Pool pool;
+  return pool;
+}
+
+Pool::Pool() {
+  const Dur period = std::chrono::seconds(10);
+  retirement = Timers::TimerService::instance().schedule(period, [this] () { return retire_idle(); }, period / 2);
+}
+
+Pool::~Pool() {
+  Timers::TimerService::instance().cancel(retirement);
+}
+
+bool Pool::retire_idle() {
+  TimePoint now = SClock::now();
+  std::vector<std::unique_ptr<Worker>> retired;
+  bool left = false;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    for (auto tool = workers.begin(); tool != workers.end(); ) {
+      auto& toolWorkers = tool->second;
+      for (auto worker = toolWorkers.begin(); worker != toolWorkers.end(); )
+        if ((*worker)->try_retire(now)) {
+          retired.push_back(std::move(*worker));
+          worker = toolWorkers.erase(worker);
+        }
+        else {
+          ++worker;
+        }
+      if (toolWorkers.empty()) {
+        tool = workers.erase(tool);
+      }
+      else {
+        left = true;
+        ++tool;
+      }
+    }
+  }
+  if (!retired.empty())
+    DEB("Retiring " << retired.size() << " idle session worker(s).");
+  return left; // The retired workers stop their processes as they go
+}
+
+Launcher::Process Pool::submit(const String& toolName, const String& command, const ToolKit::SessionSettings& settings,
+                               Strings&& inputFiles, const Launcher::Request& request) {
+  if (settings.protocol != "smtlib")
+    throw Launcher::LaunchError("Unsupported session protocol of " + toolName + ": " + settings.protocol);
+  Worker* worker = nullptr;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    auto& toolWorkers = workers[toolName];
+    for (auto& candidate : toolWorkers)
+      if (candidate->try_reserve()) {
+        worker = candidate.get();
+        break;
+      }
+    if (!worker) {
+      if (toolWorkers.size() >= settings.maxProcesses)
+        return Launcher::Process();
+      toolWorkers.push_back(std::make_unique<Worker>(command, settings));
+      worker = toolWorkers.back().get();
+      worker->try_reserve();
+    }
+  }
+  Timers::TimerService::instance().wake(retirement); // Parked while the pool was empty
+  pid_t pid;
+  std::shared_ptr<Query> query;
+  try {
+    pid = worker->ensure_started();
+    Launcher::FileDescriptor out(Launcher::open_output(request.outFileName));
+    Launcher::FileDescriptor err(Launcher::open_output(request.errFileName));
+    query = std::make_shared<Query>(pid, std::move(inputFiles), out.fd, err.fd);
+    out.fd = err.fd = -1; // Owned by the query now
+  }
+  catch (...) {
+    worker->unreserve();
+    throw;
+  }
+  if (request.cores)
+    request.cores->apply_to(pid);
+  worker->submit(query);
+  return Launcher::Process(pid, query);
+}
+
+}
@@ -0,0 +1,174 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   SolverPool.h
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "bbb.h"
+#include "Launcher.h"
+#include "Timers.h"
+#include "ToolKit.h"
+
+namespace SolverPool {
+
+using namespace Basics;
+
+/**
+ * One run of a tool answered by a session process. Stands in for the process the run would otherwise
+ * have started: the run polls and kills the query, not the session process, which outlives it.
+ */
+class Query : public Launcher::Reaper {
+public:
+  Query(pid_t worker, Strings&& inputFiles, int out, int err);
+  Query(const Query& other) = delete;
+  Query& operator=(const Query& other) = delete;
+
+  /**
+   * @return pid with status 0 once the query was answered, the status of the session process if it ended
+   *         before answering, 0 while the query is being answered
+   */
+  virtual pid_t wait(pid_t pid, int* status) override;
+
+  /**
+   * Stops the session process if it is still answering this query
+   */
+  virtual void kill(pid_t pid, int signal) override;
+
+  const Strings& get_input_files() const { return inputFiles; }
+  int get_output() const { return out.fd; }
+  int get_error_output() const { return err.fd; }
+  void finish(int status);
+
+private:
+  mutable std::mutex mutex;
+  const pid_t worker;
+  const Strings inputFiles; // Absolute paths, sent in order
+  Launcher::FileDescriptor out, err;
+  bool done;
+  int status;
+};
+
+/**
+ * A session process of a tool together with the thread talking to it. Answers one query at a time:
+ * the query's input files are sent followed by an (echo) of a marker that ends the query's output, then
+ * a (reset), so that the next query starts without the logic, options and assertions of this one. The process is started on first use and replaced after SessionSettings::maxUses
+ * queries, when it outgrows SessionSettings::maxMemory, or when it ends. The Pool retires a worker
+ * that was not used for SessionSettings::idleTimeout.
+ */
+class Worker {
+public:
+  Worker(const String& command, const ToolKit::SessionSettings& settings);
+  Worker(const Worker& other) = delete;
+  Worker& operator=(const Worker& other) = delete;
+  ~Worker();
+
+  /**
+   * Reserves the worker for a query, fails if it is busy
+   */
+  bool try_reserve();
+
+  /**
+   * Cancels a reservation that will not be followed by submit()
+   */
+  void unreserve();
+
+  /**
+   * Reserves the worker for good if it is idle and was not used for SessionSettings::idleTimeout
+   * @return true if the worker may be destroyed
+   */
+  bool try_retire(TimePoint now);
+
+  /**
+   * Starts the session process unless it runs. Only for the holder of the reservation.
+   * Throws Launcher::LaunchError.
+   * @return Process ID of the session process
+   */
+  pid_t ensure_started();
+
+  /**
+   * Hands the query to the worker's thread. Only for the holder of the reservation, ends it once answered.
+   */
+  void submit(const std::shared_ptr<Query>& query);
+
+private:
+  void serve();
+  int answer(Query& query);
+  int collect_process();
+  bool exchange(const String& script, const String& marker, int out);
+  bool needs_recycling() const;
+  void stop_process();
+
+  const String command;
+  const ToolKit::SessionSettings settings;
+  mutable std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::shared_ptr<Query> pending;
+  bool busy;
+  bool stopping;
+  TimePoint lastUsed; // When the worker last became idle
+  pid_t pid;    // -1 if the session process is not running
+  int channel;  // Standard input and output of the session process, -1 if it is not running
+  Nat uses;     // Queries answered by the current session process
+  Nat sequence; // Numbers the markers
+  std::thread thread;
+};
+
+/**
+ * Process-wide pools of warm session processes, one pool per tool, of at most SessionSettings::maxProcesses
+ * processes. Session processes take memory the scheduler does not account for, so a pool is kept small and
+ * its unused processes are stopped (see retire_idle()).
+ */
+class Pool {
+public:
+  static Pool& instance();
+
+  Pool(const Pool& other) = delete;
+  Pool& operator=(const Pool& other) = delete;
+
+  /**
+   * Answers the run's input files with a session process of the tool.
+   * Throws Launcher::LaunchError.
+   * @param command The tool's path with its session arguments
+   * @param inputFiles Absolute paths of the run's input files
+   * @param request Output files and cores of the run; the command of the request is not used
+   * @return Stands for the query; its pid is the session process's, for statistics.
+   *         Empty (pid -1) if all session processes of the tool are busy and the pool is full;
+   *         the run then starts its own process.
+   */
+  Launcher::Process submit(const String& toolName, const String& command, const ToolKit::SessionSettings& settings,
+                           Strings&& inputFiles, const Launcher::Request& request);
+
+  /**
+   * Stops the session processes not used for their SessionSettings::idleTimeout. Runs periodically on the
+   * Timers::TimerService, parked while there are no session processes.
+   * @return Whether any worker is left
+   */
+  bool retire_idle();
+
+private:
+  Pool();
+  ~Pool();
+
+  std::mutex mutex;
+  Timers::TaskID retirement;
+  std::map<String, std::list<std::unique_ptr<Worker>>> workers; // By tool name
+};
+
+}
@@ -0,0 +1,138 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Timers.cpp
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include "Timers.h"
+
+namespace Timers {
+
+TimerService& TimerService::instance() {
+  static TimerService service;
+  return service;
+}
+
+TimerService& TimerService::background() {
+  static TimerService service;
+  return service;
+}
+
+TimerService::TimerService() : nextID(1), running(0), stopping(false), thread(&TimerService::serve, this) { }
+
+TimerService::~TimerService() {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  thread.join();
+}
+
+TaskID TimerService::schedule(Dur period, Task&& task, Dur slack) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  TaskID id = nextID++;
+  Entry& entry = tasks[id];
+  entry.period = std::max(period, Dur(1));
+  entry.slack = std::min(slack, entry.period);
+  entry.task = std::move(task);
+  entry.queued = false;
+  enqueue_nomutex(id, entry, Clock::now() + entry.period);
+  wakeUp.notify_all();
+  return id;
+}
+
+void TimerService::wake(TaskID id) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  auto found = tasks.find(id);
+  if (found == tasks.end())
+    return;
+  Entry& entry = found->second;
+  if (entry.queued || (running == id && std::this_thread::get_id() == thread.get_id()))
+    return;
+  if (running == id) // Decides whether to park on what it saw before the wake-up
+    enqueue_nomutex(id, entry, Clock::now() + entry.period);
+  else
+    enqueue_nomutex(id, entry, Clock::now());
+  wakeUp.notify_all();
+}
+
+void TimerService::cancel(TaskID id) {
+  std::unique_lock<decltype(mutex)> lock(mutex);
+  auto found = tasks.find(id);
+  if (found == tasks.end())
+    return;
+  if (found->second.queued)
+    queue.erase(found->second.due);
+  tasks.erase(found);
+  if (std::this_thread::get_id() != thread.get_id())
+    taskDone.wait(lock, [&] () { return running != id; });
+}
+
+void TimerService::enqueue_nomutex(TaskID id, Entry& entry, Clock::time_point due) {
+  entry.due = queue.emplace(due, id);
+  entry.queued = true;
+}
+
+void TimerService::serve() {
+  std::unique_lock<decltype(mutex)> lock(mutex);
+  while (!stopping) {
+    if (queue.empty()) { // Everything is parked
+      wakeUp.wait(lock);
+      continue;
+    }
+    Clock::time_point now = Clock::now();
+    if (queue.begin()->first > now) {
+      wakeUp.wait_until(lock, queue.begin()->first);
+      continue;
+    }
+    // The due tasks, and the ones that would wake the thread again soon:
+    std::vector<TaskID> batch;
+    for (auto it = queue.begin(); it != queue.end(); ) {
+      Entry& entry = tasks.at(it->second);
+      if (it->first - entry.slack > now) {
+        ++it;
+        continue;
+      }
+      batch.push_back(it->second);
+      entry.queued = false;
+      it = queue.erase(it);
+    }
+    for (TaskID id : batch) {
+      auto found = tasks.find(id);
+      if (found == tasks.end()) // Cancelled by a task of the batch
+        continue;
+      Task task = found->second.task;
+      running = id;
+      lock.unlock();
+      bool active = true;
+      try {
+        active = task();
+      }
+      catch (const std::exception& e) {
+        DEB("Periodic task " << id << " failed: " << e.what());
+      }
+      lock.lock();
+      running = 0;
+      taskDone.notify_all();
+      found = tasks.find(id);
+      if (found == tasks.end() || found->second.queued) // Cancelled, or woken while it ran
+        continue;
+      if (active)
+        enqueue_nomutex(id, found->second, Clock::now() + found->second.period);
+    }
+  }
+}
+
+}
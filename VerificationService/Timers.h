@@ -0,0 +1,102 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Timers.h
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "bbb.h"
+
+namespace Timers {
+
+using namespace Basics;
+
+using TaskID = uint64_t;
+
+/**
+ * Process-wide thread that runs the periodic work of the server: monitoring the runs of every service,
+ * expiring workspaces, and whatever else has to happen from time to time.
+ *
+ * Wake-ups are coalesced: when the thread wakes up for one task, it also runs the tasks due within their slack,
+ * so tasks of similar periods end up running together. A task with nothing to do parks itself by returning false
+ * and runs again once it is woken (see wake()); while all tasks are parked, the thread sleeps until one is woken
+ * or scheduled. Tasks run one at a time and should not block for long.
+ *
+ * Work that may block (e.g. launching runs) goes to background(), a second thread of the same kind,
+ * where it holds up only the other blocking work rather than every periodic task.
+ */
+class TimerService {
+public:
+  /// One tick of a task; returns false to park the task until wake()
+  using Task = std::function<bool()>;
+
+  static TimerService& instance();
+
+  /// Process-wide service for tasks that may block, see above
+  static TimerService& background();
+
+  TimerService(const TimerService& other) = delete;
+  TimerService& operator=(const TimerService& other) = delete;
+  ~TimerService();
+
+  /**
+   * Runs the task every period, the first time one period from now, until it is cancelled
+   * @param slack How much earlier the task may run to share a wake-up with another task
+   */
+  TaskID schedule(Dur period, Task&& task, Dur slack = Dur::zero());
+
+  /**
+   * Runs a parked task right away. A task woken by another thread while it runs stays scheduled even if it parks itself.
+   * Does nothing to a task that is scheduled already, or that wakes itself.
+   */
+  void wake(TaskID id);
+
+  /**
+   * Once it returns, the task does not run any more; waits for the task if it is running, unless called from the task.
+   */
+  void cancel(TaskID id);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    Dur period;
+    Dur slack;
+    Task task;
+    bool queued; // Has a due time, i.e. is neither parked nor running
+    std::multimap<Clock::time_point, TaskID>::iterator due;
+  };
+
+  TimerService();
+  void serve();
+  void enqueue_nomutex(TaskID id, Entry& entry, Clock::time_point due);
+
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable taskDone;
+  std::map<TaskID, Entry> tasks;
+  std::multimap<Clock::time_point, TaskID> queue; // Due times of the queued tasks
+  TaskID nextID;
+  TaskID running; // 0 if no task runs
+  bool stopping;
+  std::thread thread;
+};
+
+}
@@ -15,21 +15,52 @@
  */
 
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <experimental/filesystem>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "bbb.h"
 #include "subprocess.hpp"
 
 #include "ToolKit.h"
+#include "ToolKitXMLFactory.h"
 
 namespace ToolKit {
-  Tool::Tool() : busy(false) {}
+  namespace filesystem = std::experimental::filesystem;
+
+  /**
+   * Decrements the counter unless it is zero
+   * @return false if it was zero
+   */
+  static bool release(std::atomic<Nat>& counter) {
+    Nat value = counter;
+    do {
+      if (value == 0)
+        return false;
+    } while (!counter.compare_exchange_weak(value, value - 1));
+    return true;
+  }
+
+  Tool::Tool() : blocked(false), maxInstances(1), activeInstances(std::make_shared<std::atomic<Nat>>(0)), memoryPerRun(defaultMemoryPerRun), coresPerRun(1), earlyTermination(false) {}
   Tool::Tool(const String& name, const String& path, const String& outputParser, bool singleInstance) : 
-      busy(false),
-      singleInstance(singleInstance),
+      blocked(false),
+      maxInstances(singleInstance ? 1 : std::max(1u, std::thread::hardware_concurrency())),
+      activeInstances(std::make_shared<std::atomic<Nat>>(0)),
+      memoryPerRun(defaultMemoryPerRun),
+      coresPerRun(1),
+      earlyTermination(false),
       name(name),
       path(path),
       outputParser(outputParser) {
-    update_version();
   }
 
   Tool::Tool(Tool&& other) noexcept {
@@ -38,15 +69,20 @@ namespace ToolKit {
   Tool& Tool::operator=(Tool&& other) noexcept {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
     std::lock_guard<decltype(other.mutex)> lockGuardOther(other.mutex);
-    this->busy = other.busy;
-    other.busy = false;
-    this->singleInstance = other.singleInstance;
+    this->blocked = other.blocked;
+    this->maxInstances = other.maxInstances;
+    this->activeInstances = std::move(other.activeInstances);
+    this->memoryPerRun = other.memoryPerRun;
+    this->coresPerRun = other.coresPerRun;
+    this->earlyTermination = other.earlyTermination;
+    this->session = std::move(other.session);
     this->name = std::move(other.name);
     this->path = std::move(other.path);
     this->outputParser = std::move(other.outputParser);
     this->version = std::move(other.version);
     this->parameterSets = std::move(other.parameterSets);
     this->capabilities = std::move(other.capabilities);
+    this->categoryRuns = std::move(other.categoryRuns);
     return *this;
   }
     
@@ -56,6 +92,15 @@ namespace ToolKit {
     return name == other.name && version == other.version;
   }
     
+  Tool Tool::portfolio(const String& category, const std::vector<const Tool*>& members) {
+    Tool tool;
+    tool.name = category;
+    tool.maxInstances = unlimitedCapacity;
+    for (const Tool* member : members)
+      tool.version += member->get_name() + " " + member->get_version() + ";";
+    return tool;
+  }
+
   Hash Tool::hash() const {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
     return std::hash<String>{}(name) + std::hash<String>{}(version) + std::hash<String>{}(path);
@@ -76,6 +121,32 @@ namespace ToolKit {
     capabilities = std::move(c);
   }
 
+  void Tool::set_memory_per_run(Nat memory) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    memoryPerRun = memory;
+  }
+
+  void Tool::set_cores_per_run(Nat cores) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    coresPerRun = std::max<Nat>(1, cores);
+  }
+
+  void Tool::set_max_instances(Nat instances) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    maxInstances = std::max<Nat>(1, instances);
+  }
+
+  void Tool::set_early_termination(bool enabled) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    earlyTermination = enabled;
+  }
+
+  void Tool::set_session(SessionSettings&& settings) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    session = std::move(settings);
+    session.maxUses = std::max<Nat>(1, session.maxUses);
+  }
+
   void Tool::to_string(String& out)
   {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
@@ -86,163 +157,495 @@ namespace ToolKit {
   }
   
   /**
-   * Attempt to atomically acquire the tool (set its busy flag)
-   * @return True if the tool was not busy and was successfully acquired. 
+   * Attempt to atomically acquire one instance slot of the tool
+   * @return True if a slot was free and was successfully acquired. 
    *         False otherwise.
    */
   bool Tool::acquire() {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    if (busy)
+    if (blocked)
       return false;
-    if (singleInstance)
-        busy = true;  
+    Nat active = *activeInstances;
+    do {
+      if (active >= maxInstances)
+        return false;
+    } while (!activeInstances->compare_exchange_weak(active, active + 1)); // The counter may be shared with another tool
+    for (const auto& runs : categoryRuns)
+      (*runs)++;
     return true;
   }
   
   /**
-   * Release the tool if it was acquired (busy)
+   * Release one instance slot acquired by acquire()
    */
   void Tool::set_free() {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    busy = false; 
+    if (!release(*activeInstances))
+      return;
+    for (const auto& runs : categoryRuns)
+      release(*runs);
   }
   
   bool Tool::is_free() const {
       std::lock_guard<decltype(mutex)> lockGuard(mutex);
-      return !busy;  
+      return !blocked && *activeInstances < maxInstances;
+  }
+
+  void Tool::share_instances(const std::shared_ptr<std::atomic<Nat>>& counter) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (activeInstances == counter)
+      return;
+    *counter += activeInstances->exchange(0);
+    activeInstances = counter;
   }
   
+  std::shared_ptr<const std::atomic<Nat>> Tool::get_instance_counter() const {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    return activeInstances;
+  }
+
+  void Tool::set_category_counters(std::vector<std::shared_ptr<std::atomic<Nat>>>&& counters) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    categoryRuns = std::move(counters);
+  }
+
   bool Tool::has_category(const String& c) const {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
     return capabilities.find(c) != capabilities.end(); 
   }
   
-  void Tool::update_version() {
+  void Tool::set_version(const String& version, bool runnable) {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    this->version = version;
+    if (!runnable) {
+      blocked = true; // Block the tool
+      DEB("Error running tool: " + path);
+    }
+  }
+  
+  
+  constexpr std::chrono::seconds VersionCache::probeTimeout;
+
+  VersionCache& VersionCache::instance() {
+    static VersionCache cache;
+    return cache;
+  }
+
+  std::vector<VersionCache::Version> VersionCache::get(const Strings& paths, const String& file) {
+    std::vector<std::shared_future<Version>> pending;
+    bool probed = false;
+    {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      if (!file.empty() && loaded.insert(file).second)
+        load_nomutex(file);
+      for (const String& path : paths) {
+        String pathKey = key(path);
+        auto it = versions.find(pathKey.empty() ? path : pathKey);
+        if (it == versions.end()) {
+          it = versions.emplace(pathKey.empty() ? path : pathKey, std::async(std::launch::async, &VersionCache::probe, path).share()).first;
+          probed = true;
+        }
+        pending.push_back(it->second);
+      }
+    }
+    std::vector<Version> result;
+    for (const std::shared_future<Version>& version : pending)
+      result.push_back(version.get());
+    if (probed && !file.empty()) {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      save_nomutex(file);
+    }
+    return result;
+  }
+
+  /// Runs "<path> --version", stopping it after probeTimeout
+  VersionCache::Version VersionCache::probe(const String& path) {
+    Version result;
     try {
       auto process = subprocess::Popen(
-              {this->path.c_str(), "--version"},
+              {path.c_str(), "--version"},
               subprocess::output{subprocess::PIPE},
               subprocess::error{subprocess::STDOUT},
               subprocess::shell{false});
-      auto outputBuffer = process.communicate().first;
+      auto deadline = std::chrono::steady_clock::now() + probeTimeout;
+      struct pollfd output = {fileno(process.output()), POLLIN, 0};
+      String data;
+      char buffer[4096];
+      for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+          process.kill(9);
+          result.cacheable = false;
+          break;
+        }
+        int ready = poll(&output, 1, left);
+        if (ready < 0 && errno != EINTR)
+          break;
+        if (ready <= 0)
+          continue;
+        ssize_t size = read(output.fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR)
+          continue;
+        if (size <= 0) // The tool closed its output
+          break;
+        data.append(buffer, size);
+      }
       process.wait();
-      std::string data(outputBuffer.buf.data());
-      std::transform(data.begin(), data.end(), data.begin(), [] (const char c) -> char {return std::tolower(c);});
-      size_t versionPos;
-      size_t newlinePos;
-      versionPos = data.find("version");
+      result.text = (result.cacheable ? parse_version(data) : "unknown");
+      if (!result.cacheable) {
+        DEB("Version of " << path << " unknown, --version did not finish in " << probeTimeout.count() << " s");
+      }
+    }
+    catch (const std::exception& err) { // A failed exec is rethrown as a plain std::exception
+      result.text = "ERROR";
+      result.runnable = false;
+      result.cacheable = false;
+    }
+    return result;
+  }
+
+  /// The line mentioning a version, from the mention on
+  String VersionCache::parse_version(const String& output) {
+    String data(output.c_str()); // Up to a '\0', as the tool's output was read before
+    std::transform(data.begin(), data.end(), data.begin(), [] (const char c) -> char {return std::tolower(c);});
+    size_t versionPos;
+    size_t newlinePos;
+    versionPos = data.find("version");
+    if (versionPos == std::string::npos)
+    {
+      versionPos = data.find("v");
       if (versionPos == std::string::npos)
-      {
-        versionPos = data.find("v");
-        if (versionPos == std::string::npos)
-          versionPos = 0;
+        versionPos = 0;
+    }
+    newlinePos = data.find("\n", versionPos);
+    if (newlinePos == std::string::npos)
+      newlinePos = data.length();
+    return output.substr(versionPos, newlinePos - versionPos);
+  }
+
+  String VersionCache::key(const String& path) {
+    String executable = path;
+    if (path.find('/') == String::npos) {
+      const char* searchPath = getenv("PATH");
+      Strings directories;
+      bbb::split_by(searchPath ? searchPath : "", directories, ":");
+      for (const String& directory : directories) {
+        if (!directory.empty() && access((directory + "/" + path).c_str(), X_OK) == 0) {
+          executable = directory + "/" + path;
+          break;
+        }
       }
-      newlinePos = data.find("\n", versionPos);
-      if (newlinePos == std::string::npos)
-        newlinePos = data.length();
-      version = std::string(&(outputBuffer.buf.data()[versionPos]), &(outputBuffer.buf.data()[newlinePos]));
     }
-    catch (const subprocess::OSError& err) {
-      version = "ERROR";
-      busy = true; // Block the tool
-      DEB("Error running tool: " + path);
+    struct stat info;
+    if (stat(executable.c_str(), &info) != 0)
+      return "";
+    return path + "\t" + std::to_string(info.st_ino) + "\t"
+           + std::to_string(info.st_mtim.tv_sec * 1000000000ULL + info.st_mtim.tv_nsec);
+  }
+
+  /// Lines "<key>\t<version>", see key()
+  void VersionCache::load_nomutex(const String& file) {
+    Strings lines;
+    bbb::read_file(file, lines);
+    for (const String& line : lines) {
+      size_t separator = line.find('\t');
+      for (int i = 0; i < 2 && separator != String::npos; i++)
+        separator = line.find('\t', separator + 1);
+      if (separator == String::npos)
+        continue;
+      std::promise<Version> version;
+      version.set_value({line.substr(separator + 1), true, true});
+      versions.emplace(line.substr(0, separator), version.get_future().share());
+    }
+  }
+
+  void VersionCache::save_nomutex(const String& file) {
+    Strings lines;
+    for (const auto& version : versions) {
+      if (version.first.find('\t') == String::npos) // The executable does not exist
+        continue;
+      if (version.second.wait_for(std::chrono::seconds::zero()) != std::future_status::ready) // Probed by another thread
+        continue;
+      const Version& value = version.second.get();
+      if (value.cacheable)
+        lines.push_back(version.first + "\t" + value.text);
+    }
+    bbb::write_file(file + ".tmp", lines);
+    if (rename((file + ".tmp").c_str(), file.c_str()) != 0) {
+      DEB("Cannot store the tool versions in " << file << ": " << strerror(errno));
     }
   }
   
   
+  ReservationCounters& ReservationCounters::instance() {
+    static ReservationCounters counters;
+    return counters;
+  }
+
+  ReservationCounters::Counter ReservationCounters::tool(const String& name) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    Counter& counter = tools[name];
+    if (!counter)
+      counter = std::make_shared<std::atomic<Nat>>(0);
+    return counter;
+  }
+
+  ReservationCounters::Counter ReservationCounters::category(const String& name) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    Counter& counter = categories[name];
+    if (!counter)
+      counter = std::make_shared<std::atomic<Nat>>(0);
+    return counter;
+  }
+
+
   // class ToolKit
-  ToolKit::ToolKit() {}
+  ToolKit::ToolKit() : current(new Snapshot()), readers(0), watched(false) {}
   
-  ToolKit::ToolKit(ToolKit&& other) noexcept {
+  ToolKit::ToolKit(ToolKit&& other) noexcept : ToolKit() {
     *this = std::move(other);
   }
+
+  ToolKit::~ToolKit() {
+    if (watched)
+      SourceWatcher::instance().remove(*this);
+    delete current.load();
+  }
     
   ToolKit& ToolKit::operator=(ToolKit&& other) noexcept {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    std::lock_guard<decltype(other.mutex)> lockGuardOther(other.mutex);
-    this->toolStore = std::move(other.toolStore);
-    this->capabilities = std::move(other.capabilities);
-    this->toolsByCategoryMap = std::move(other.toolsByCategoryMap);
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    std::lock_guard<decltype(other.writeMutex)> lockGuardOther(other.writeMutex);
+    delete current.exchange(other.current.exchange(new Snapshot()));
+    this->source = std::move(other.source);
     return *this;
   }
 
-  bbb::MaybeRef<Tool> ToolKit::get(const String& name) {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    try {
-      return toolStore.at(normalizeName(name));
-    }
-    catch (const std::out_of_range& e) {
-      return {};
+  ToolKit::Reader::Reader(const ToolKit& toolKit) : toolKit(toolKit) {
+    toolKit.readers++; // Before the snapshot is loaded, see publish_nomutex()
+    snapshot = toolKit.current.load();
+  }
+
+  size_t ToolKit::NameHash::operator()(const String& name) const {
+    size_t hash = 14695981039346656037ULL; // FNV-1a of the lowercase name
+    for (char c : name)
+      hash = (hash ^ static_cast<unsigned char>(std::tolower(c))) * 1099511628211ULL;
+    return hash;
+  }
+
+  bool ToolKit::NameEqual::operator()(const String& left, const String& right) const {
+    return left.size() == right.size() &&
+           std::equal(left.begin(), left.end(), right.begin(), [] (char l, char r) { return std::tolower(l) == std::tolower(r); });
+  }
+
+  SharedTool ToolKit::get(const String& name) const {
+    Reader snapshot(*this);
+    auto it = snapshot->tools.find(name);
+    return (it == snapshot->tools.end() ? nullptr : it->second);
+  }
+
+  bool ToolKit::is_tool_free(const String& name) const {
+    SharedTool tool = get(name);
+    return tool && tool->is_free();
+  }
+
+  void ToolKit::insert(Tool&& tool) {
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(*current.load()));
+    String name = normalizeName(tool.get_name());
+    snapshot->tools[name] = std::make_shared<Tool>(std::move(tool));
+    index(*snapshot);
+    publish_nomutex(std::move(snapshot));
+  }
+
+  void ToolKit::insert(std::vector<Tool>&& tools, const std::map<String, Nat>& categoryCapacities) {
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(*current.load()));
+    for (Tool& tool : tools) {
+      String name = normalizeName(tool.get_name());
+      snapshot->tools[name] = std::make_shared<Tool>(std::move(tool));
     }
+    for (const auto& capacity : categoryCapacities)
+      snapshot->categoryCapacities[capacity.first] = capacity.second;
+    index(*snapshot);
+    publish_nomutex(std::move(snapshot));
+  }
+
+  String ToolKit::category_available(const String& c) const {
+    Reader snapshot(*this);
+    if (snapshot->categories.find(c) == snapshot->categories.end())
+      return "no";
+    return (get_category_free(c) > 0 ? "yes" : "busy");
   }
   
-  bbb::MaybeRef<const Tool> ToolKit::get(const String& name) const {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    try {
-      const decltype(toolStore)& constToolStore = toolStore;
-      return constToolStore.at(normalizeName(name));
+  Capabilities ToolKit::get_capabilities() const {
+    Reader snapshot(*this);
+    return snapshot->capabilities;
+  }
+  
+  std::set<String> ToolKit::get_tools(const String& category) const {
+    Reader snapshot(*this);
+    std::set<String> toolsWithCategory;
+    auto it = snapshot->categories.find(category);
+    if (it != snapshot->categories.end())
+      for (const Member& member : it->second.members)
+        toolsWithCategory.insert(member.name);
+    return toolsWithCategory;
+  }
+
+  std::vector<SharedTool> ToolKit::get_members(const String& category) const {
+    Reader snapshot(*this);
+    std::vector<SharedTool> members;
+    auto it = snapshot->categories.find(category);
+    if (it != snapshot->categories.end())
+      for (const Member& member : it->second.members)
+        members.push_back(member.tool);
+    return members;
+  }
+
+  SharedTool ToolKit::route(const String& category) const {
+    Reader snapshot(*this);
+    auto it = snapshot->categories.find(category);
+    if (it == snapshot->categories.end())
+      return nullptr;
+    const Member* best = nullptr;
+    uint64_t bestActive = 0;
+    for (const Member& member : it->second.members) {
+      if (member.capacity == 0)
+        continue;
+      uint64_t active = std::min<Nat>(*member.active, member.capacity);
+      // Smaller active / capacity, or the same and more free instances:
+      if (!best || active * best->capacity < bestActive * member.capacity ||
+          (active * best->capacity == bestActive * member.capacity && member.capacity - active > best->capacity - bestActive)) {
+        best = &member;
+        bestActive = active;
+      }
     }
-    catch (const std::out_of_range& e) {
-      return {};
+    return (best ? best->tool : nullptr);
+  }
+
+  Nat ToolKit::get_category_free(const String& category) const {
+    Reader snapshot(*this);
+    auto it = snapshot->categories.find(category);
+    if (it == snapshot->categories.end())
+      return 0;
+    Nat active = *it->second.active;
+    return (active >= it->second.capacity ? 0 : it->second.capacity - active);
+  }
+
+  std::vector<ToolKit::Availability> ToolKit::get_availability() const {
+    Reader snapshot(*this);
+    std::vector<Availability> availability;
+    for (const auto& category : snapshot->categories) {
+      Nat active = *category.second.active;
+      availability.push_back({category.first, (active >= category.second.capacity ? 0 : category.second.capacity - active), {}});
+      for (const Member& member : category.second.members)
+        availability.back().tools.emplace_back(member.name, *member.active < member.capacity);
     }
+    return availability;
   }
 
-  bool ToolKit::is_tool_free(const String& name) const {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  SharedTool ToolKit::get_portfolio(const String& category) const {
+    Reader snapshot(*this);
+    auto it = snapshot->categories.find(category);
+    return (it == snapshot->categories.end() ? nullptr : it->second.portfolio);
+  }
+
+  void ToolKit::set_category_capacity(const String& category, Nat capacity) {
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(*current.load()));
+    snapshot->categoryCapacities[category] = capacity;
+    index(*snapshot);
+    publish_nomutex(std::move(snapshot));
+  }
+
+  Nat ToolKit::get_category_capacity(const String& category) const {
+    Reader snapshot(*this);
+    auto it = snapshot->categoryCapacities.find(category);
+    return (it == snapshot->categoryCapacities.end() ? unlimitedCapacity : it->second);
+  }
+
+  void ToolKit::set_source(const String& file) {
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    std::error_code error;
+    filesystem::path path = filesystem::canonical(file, error); // Where it is written to if it is a link
+    source = (error ? filesystem::absolute(file) : path).string();
+  }
+
+  String ToolKit::get_source() const {
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    return source;
+  }
+
+  bool ToolKit::reload() {
+    String file = get_source();
+    ToolKit fresh;
     try {
-      return toolStore.at(normalizeName(name)).is_free();
+      fresh = ToolKitXMLFactory::create(file);
     }
-    catch (const std::out_of_range& e) {
+    catch (const std::exception& e) {
+      DEB("Cannot reload the toolkit from " << file << ", keeping the current one: " << e.what());
       return false;
     }
+    std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+    // Indexed when it was created, counted with the tools and categories of the same names it replaces:
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(*fresh.current.load()));
+    DEB("Reloaded the toolkit from " << file << ": " << snapshot->tools.size() << " tools");
+    publish_nomutex(std::move(snapshot));
+    return true;
   }
 
-  void ToolKit::insert(Tool&& tool) {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    ToolStoreIterator it = toolStore.emplace(normalizeName(tool.get_name()), std::move(tool)).first;
-    for (const std::string& cap : it->second.get_capabilities())
+  void ToolKit::watch() {
     {
-      toolsByCategoryMap[cap].push_back(it); //TODO: set would be more suitable but would require comparator of rbtree iterators
-      capabilities.insert(cap);
+      std::lock_guard<decltype(writeMutex)> lockGuard(writeMutex);
+      if (watched || source.empty())
+        return;
+      watched = true;
     }
+    SourceWatcher::instance().add(*this);
   }
 
-  String ToolKit::category_available(const String& c) const {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    bool at_least_one_capable = false;
-    for (auto &tp : toolStore) {
-      if (tp.second.has_category(c)) {
-        at_least_one_capable = true;
-        if (tp.second.is_free())
-          return "yes";
+  void ToolKit::index(Snapshot& snapshot) {
+    snapshot.capabilities.clear();
+    snapshot.categories.clear();
+    for (const auto& tool : snapshot.tools)
+      tool.second->share_instances(ReservationCounters::instance().tool(tool.first));
+    for (const auto& tool : snapshot.tools)
+      for (const String& category : tool.second->get_capabilities()) {
+        snapshot.categories[category].members.push_back({tool.second, tool.first, (tool.second->is_blocked() ? 0 : tool.second->get_max_instances()),
+                                                        tool.second->get_instance_counter()});
+        snapshot.capabilities.insert(category);
       }
+    for (auto& entry : snapshot.categories) {
+      Category& category = entry.second;
+      std::sort(category.members.begin(), category.members.end(), [] (const Member& l, const Member& r) { return l.name < r.name; });
+      uint64_t capacity = 0;
+      std::vector<const Tool*> members;
+      for (const Member& member : category.members) {
+        capacity += member.capacity;
+        members.push_back(member.tool.get());
+      }
+      auto limit = snapshot.categoryCapacities.find(entry.first);
+      if (limit != snapshot.categoryCapacities.end())
+        capacity = std::min<uint64_t>(capacity, limit->second);
+      category.capacity = std::min<uint64_t>(capacity, unlimitedCapacity);
+      // Runs of tools that left the category with a reload are still counted in it until they end
+      category.active = ReservationCounters::instance().category(entry.first);
+      category.portfolio = std::make_shared<Tool>(Tool::portfolio(entry.first, members));
     }
-    return (at_least_one_capable ? "busy" : "no");
-  }
-  
-  Capabilities ToolKit::get_capabilities() const {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    return capabilities;
-  }
-  
-  std::set<String> ToolKit::get_tools(const String& category) const {
-    std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    std::set<String> toolsWithCategory;
-    for (const ToolStoreIterator toolIt : toolsByCategoryMap.at(category)) {
-      toolsWithCategory.insert(toolIt->first);
+    for (const auto& tool : snapshot.tools) {
+      std::vector<std::shared_ptr<std::atomic<Nat>>> counters;
+      for (const String& category : tool.second->get_capabilities())
+        counters.push_back(snapshot.categories[category].active);
+      tool.second->set_category_counters(std::move(counters));
     }
-    return toolsWithCategory;
   }
 
-  ToolReservation ToolKit::reserveTool(const std::string& name) {
-    auto maybeTool = get(name);
-    if (!maybeTool)
-      throw ReservationError("Reservation failed: no such tool in toolkit");
-    ToolReservation res(maybeTool.value());
-    if (!res)
-      throw ReservationError("Reservation failed: tool busy");
-    return res;
+  /// Readers count themselves before they load the snapshot: once there are none after the swap, none has the previous one.
+  void ToolKit::publish_nomutex(std::unique_ptr<Snapshot>&& snapshot) {
+    const Snapshot* previous = current.exchange(snapshot.release());
+    while (readers.load() > 0)
+      std::this_thread::yield();
+    delete previous;
   }
 
   std::string ToolKit::normalizeName(const std::string& name) {
@@ -253,12 +656,92 @@ namespace ToolKit {
   }
 
 
-  
+  SourceWatcher& SourceWatcher::instance() {
+    static SourceWatcher watcher;
+    return watcher;
+  }
+
+  SourceWatcher::SourceWatcher() : inotifyFd(inotify_init1(IN_CLOEXEC)) {
+    if (pipe2(stopFds, O_CLOEXEC) != 0)
+      stopFds[0] = stopFds[1] = -1;
+    if (inotifyFd < 0) {
+      DEB("Cannot watch toolkit files: " << strerror(errno));
+    }
+    thread = std::thread(&SourceWatcher::serve, this);
+  }
+
+  SourceWatcher::~SourceWatcher() {
+    if (stopFds[1] >= 0) {
+      char stop = 0;
+      while (write(stopFds[1], &stop, 1) < 0 && errno == EINTR)
+        ;
+    }
+    thread.join();
+    for (int fd : {inotifyFd, stopFds[0], stopFds[1]})
+      if (fd >= 0)
+        close(fd);
+  }
+
+  void SourceWatcher::add(ToolKit& toolKit) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    filesystem::path file(toolKit.get_source());
+    String directory = file.parent_path().string();
+    if (inotifyFd >= 0) {
+      int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (watch < 0) {
+        DEB("Cannot watch " << directory << ": " << strerror(errno));
+      }
+      else
+        directories[watch] = directory; // The same descriptor for a directory watched already
+    }
+    toolKits.emplace(file.string(), &toolKit);
+  }
+
+  void SourceWatcher::remove(ToolKit& toolKit) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    for (auto it = toolKits.begin(); it != toolKits.end(); )
+      it = (it->second == &toolKit ? toolKits.erase(it) : std::next(it));
+  }
+
+  void SourceWatcher::serve() {
+    prctl(PR_SET_NAME, "VerifyToolWatch");
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+      struct pollfd fds[2] = {{stopFds[0], POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+      if (poll(fds, inotifyFd >= 0 ? 2 : 1, -1) < 0) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      if (fds[0].revents)
+        return;
+      ssize_t size = read(inotifyFd, buffer, sizeof(buffer));
+      if (size <= 0)
+        continue;
+      std::set<String> changed;
+      for (char* p = buffer; p < buffer + size; ) {
+        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+        p += sizeof(struct inotify_event) + event->len;
+        std::lock_guard<decltype(mutex)> lockGuard(mutex);
+        auto directory = directories.find(event->wd);
+        if (directory != directories.end() && event->len > 0)
+          changed.insert((filesystem::path(directory->second)/event->name).string());
+      }
+      std::lock_guard<decltype(mutex)> lockGuard(mutex); // Held while reloading, see remove()
+      for (const String& file : changed) {
+        auto range = toolKits.equal_range(file);
+        for (auto it = range.first; it != range.second; ++it)
+          it->second->reload();
+      }
+    }
+  }
+
+
   ToolReservation::ToolReservation() : reservedTool(nullptr) {}
   
-  ToolReservation::ToolReservation(Tool& tool) {
-    if (tool.acquire())
-      reservedTool = &tool;
+  ToolReservation::ToolReservation(const SharedTool& tool) {
+    if (tool->acquire())
+      reservedTool = tool;
     else
       reservedTool = nullptr;
   }
@@ -268,9 +751,13 @@ namespace ToolKit {
   }
   
   ToolReservation& ToolReservation::operator=(ToolReservation&& right) noexcept {
+    if (this == &right)
+      return *this;
     std::lock_guard<decltype(mutex) > lockGuard(mutex);
     std::lock_guard<decltype(right.mutex) > lockGuardRight(right.mutex);
-    reservedTool = right.reservedTool;
+    if (hasReservedTool_nomutex())
+      reservedTool->set_free(); // The slot held so far
+    reservedTool = std::move(right.reservedTool);
     right.reservedTool = nullptr;
     return *this;
   }
@@ -16,31 +16,56 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <experimental/optional>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "bbb.h"
 
 namespace ToolKit {
   // Forward declarations:
   class Tool;
+  class ToolKit;
   
+  using SharedTool = std::shared_ptr<Tool>;
   using String = std::string;
   using Strings = std::vector<String>;
   using Hash = bbb::Hash;
+  using Nat = Basics::Nat;
   using Capabilities = std::set<String>;
 
+  const Nat defaultMemoryPerRun = 1024; // MB reserved for a run of a tool that does not declare its memory demand
+  const Nat unlimitedCapacity = std::numeric_limits<Nat>::max();
+
   class ReservationError : public std::runtime_error {
   public:
     ReservationError(const std::string& __arg) : runtime_error(__arg) { }
   };
   
+  /**
+   * How runs of a tool that speaks an interactive protocol are served by long-lived session processes (see SolverPool)
+   */
+  struct SessionSettings {
+    String protocol;   // "smtlib" for SMT-LIB over standard input ((reset) after each query); empty if every run starts its own process
+    String arguments;  // Appended to the tool's path to start a session process (e.g. "-in" for z3)
+    Nat maxUses = 100; // Queries after which a session process is replaced
+    Nat maxMemory = 0; // MB of resident memory after which a session process is replaced, 0 for no limit
+    Nat maxProcesses = 4;  // Session processes of the tool at most; a run that finds them all busy starts its own process
+    Nat idleTimeout = 60;  // Seconds after which an unused session process is stopped
+  };
+
   class ToolReservation {
   public:
     ToolReservation();
@@ -48,7 +73,7 @@ namespace ToolKit {
      * Attempts to create and hold reservation for the tool or throws a ReservationError.
      * @param tool
      */
-    ToolReservation(Tool& tool);
+    ToolReservation(const SharedTool& tool);
     ToolReservation(const ToolReservation& other) = delete;
     ToolReservation& operator=(const ToolReservation& right) = delete;
     ToolReservation(ToolReservation&& other) noexcept;
@@ -63,20 +88,26 @@ namespace ToolKit {
   protected:
     bool hasReservedTool_nomutex() const;
     mutable std::mutex mutex;
-    Tool* reservedTool; // TODO: Tool should be kept as a shared pointer. It is not safe to rely on the reference only (in case runtime changes are made to the toolkit).
+    SharedTool reservedTool; // Kept alive if the toolkit is reloaded meanwhile
   };
   
   class Tool {
   protected:
     mutable std::recursive_mutex mutex;
-    bool busy;
-    bool singleInstance;
+    bool blocked; // The tool cannot be run at all (e.g. its executable is missing)
+    Nat maxInstances; // Number of runs of the tool that may execute concurrently
+    std::shared_ptr<std::atomic<Nat>> activeInstances; // Number of currently held reservations, shared with the tools of the same name (see share_instances())
+    Nat memoryPerRun; // MB of memory to reserve for a single run
+    Nat coresPerRun; // CPU cores a single run is pinned to
+    bool earlyTermination; // Stop a run as soon as its output shows a definitive verdict
+    SessionSettings session;
     String name;
     String path;
     String outputParser;
     String version;
     std::map<String, Strings> parameterSets;
     Capabilities capabilities;
+    std::vector<std::shared_ptr<std::atomic<Nat>>> categoryRuns; // Reservations of each category of the tool, counted with the tool's (see ToolKit::index())
   public:
     Tool();
     Tool(const String& name, const String& path, const String& outputParser, bool singleInstance = false);
@@ -93,6 +124,12 @@ namespace ToolKit {
     void add_category(const String& c);
     
     Capabilities get_capabilities() const {std::lock_guard<decltype(mutex)> lockGuard(mutex); return capabilities; }
+    Nat get_max_instances() const         {std::lock_guard<decltype(mutex)> lockGuard(mutex); return maxInstances; }
+    Nat get_active_instances() const      {std::lock_guard<decltype(mutex)> lockGuard(mutex); return *activeInstances; }
+    Nat get_memory_per_run() const        {std::lock_guard<decltype(mutex)> lockGuard(mutex); return memoryPerRun; }
+    Nat get_cores_per_run() const         {std::lock_guard<decltype(mutex)> lockGuard(mutex); return coresPerRun; }
+    bool get_early_termination() const    {std::lock_guard<decltype(mutex)> lockGuard(mutex); return earlyTermination; }
+    SessionSettings get_session() const   {std::lock_guard<decltype(mutex)> lockGuard(mutex); return session; }
     String get_name() const               {std::lock_guard<decltype(mutex)> lockGuard(mutex); return name; }
     String get_path() const               {std::lock_guard<decltype(mutex)> lockGuard(mutex); return path; }
     String get_version() const            {std::lock_guard<decltype(mutex)> lockGuard(mutex); return version; }
@@ -102,48 +139,323 @@ namespace ToolKit {
     bool has_category(const String& c) const;
     Hash hash() const;
     bool is_free() const;
+    bool is_blocked() const               {std::lock_guard<decltype(mutex)> lockGuard(mutex); return blocked; }
+
+    /**
+     * Creates a pseudo-tool standing for racing the given tools of a category (see Portfolio::Group).
+     * It is never run itself, it only identifies the reports of portfolio verifications.
+     * @param category Name of the category, becomes the name of the pseudo-tool
+     * @param members Tools of the portfolio, their versions are part of the pseudo-tool's version
+     */
+    static Tool portfolio(const String& category, const std::vector<const Tool*>& members);
     
     void set_capabilities(Capabilities& c);
     void set_capabilities(Capabilities&& c);
+    void set_memory_per_run(Nat memory);
+    void set_cores_per_run(Nat cores);
+    void set_max_instances(Nat instances);
+    void set_early_termination(bool enabled);
+    void set_session(SessionSettings&& settings);
     void set_free();
+
+    /**
+     * Counts the reservations of this tool in the given counter, together with the other tools counted in it,
+     * e.g. the tools of the same name in the toolkits of other service threads, or the tool a reloaded toolkit
+     * replaced, which runs started before the reload still hold. The reservations held already move to the counter.
+     */
+    void share_instances(const std::shared_ptr<std::atomic<Nat>>& counter);
+
+    /**
+     * @return The counter of the held reservations, for reading without the tool's lock
+     */
+    std::shared_ptr<const std::atomic<Nat>> get_instance_counter() const;
+
+    /**
+     * @param counters Counters of the tool's categories, acquire() and set_free() count the reservation in them too
+     */
+    void set_category_counters(std::vector<std::shared_ptr<std::atomic<Nat>>>&& counters);
+
+    /**
+     * @param version See VersionCache
+     * @param runnable The tool is blocked if false
+     */
+    void set_version(const String& version, bool runnable);
     void to_string(String& out);
     void write(std::fstream& f) {}
-    
-  protected:
+  };
+
+
+  /**
+   * Versions of tool executables, from the output of "<tool> --version", probed concurrently with a timeout.
+   * Process-wide, so that the toolkits of all service threads probe an executable once. Probed versions are
+   * kept in a file, keyed by the executable's path, inode and modification time, so that a restarted server
+   * does not probe the executables that did not change.
+   */
+  class VersionCache {
+  public:
+    static constexpr std::chrono::seconds probeTimeout{15}; // A JVM-based tool takes seconds to start
+
+    struct Version {
+      String text;
+      bool runnable = true;   // "ERROR" if false: the executable cannot be run
+      bool cacheable = true;  // False for a probe that timed out, its version is "unknown"
+    };
+
+    static VersionCache& instance();
+
+    VersionCache(const VersionCache& other) = delete;
+    VersionCache& operator=(const VersionCache& other) = delete;
+
     /**
-     * Attempts to run the tool with --version, sets the version member accordingly.
+     * Probes the executables not probed yet, all at once, and waits for the probes.
+     * @param paths
+     * @param file Where the versions are kept between servers, empty for none
+     * @return The version of each executable
      */
-    void update_version();
+    std::vector<Version> get(const Strings& paths, const String& file);
+
+  private:
+    VersionCache() {}
+
+    static Version probe(const String& path);
+    static String parse_version(const String& output);
+
+    /**
+     * @return "<path>\t<inode>\t<modification time>" of the executable, found on PATH if the path has no '/';
+     *         empty if it does not exist
+     */
+    static String key(const String& path);
+    void load_nomutex(const String& file);
+    void save_nomutex(const String& file);
+
+    std::mutex mutex;
+    std::map<String, std::shared_future<Version>> versions; // By key (by path for a missing executable), probed or being probed
+    std::set<String> loaded; // Files read already
   };
 
 
+  /**
+   * Process-wide counters of the reservations of tools and of categories, by name. Every toolkit (there is one per
+   * service thread) and every snapshot of a reloaded toolkit counts the runs of a tool or a category of the same name
+   * in the same counter, so that instance limits and category capacities hold for the whole node.
+   */
+  class ReservationCounters {
+  public:
+    using Counter = std::shared_ptr<std::atomic<Nat>>;
+
+    static ReservationCounters& instance();
+
+    ReservationCounters(const ReservationCounters& other) = delete;
+    ReservationCounters& operator=(const ReservationCounters& other) = delete;
+
+    /**
+     * @param name Lowercase name of the tool
+     */
+    Counter tool(const String& name);
+    Counter category(const String& name);
+
+  private:
+    ReservationCounters() {}
+
+    std::mutex mutex;
+    std::map<String, Counter> tools;
+    std::map<String, Counter> categories;
+  };
+
+
+  /**
+   * The tools are published as an immutable snapshot: lookups read the current snapshot without a lock, changes
+   * (insert(), reload()) build a new snapshot and swap it in. Tools are shared, reports, runs and reservations keep
+   * the tool they were created with when the toolkit is reloaded.
+   */
   class ToolKit {
   public:
     ToolKit();
     ToolKit(const ToolKit& other) = delete;
-    ToolKit(ToolKit&& other) noexcept;
+    ToolKit(ToolKit&& other) noexcept; // Only a toolkit that is not watched and not read from other threads
 
-    ~ToolKit() {}
+    ~ToolKit();
     
     ToolKit& operator=(const ToolKit& other) = delete;
     ToolKit& operator=(ToolKit&& other) noexcept;
 
-    bbb::MaybeRef<Tool> get(const String& name);
-    bbb::MaybeRef<const Tool> get(const String& name) const;
+    /**
+     * @param name Case does not matter
+     * @return nullptr if there is no such tool
+     */
+    SharedTool get(const String& name) const;
     bool is_tool_free(const String& name) const;
     void insert(Tool&& tool);
+
+    /**
+     * Adds the tools and sets the capacities of the categories in one change: readers see all of them or none
+     * @param categoryCapacities See set_category_capacity()
+     */
+    void insert(std::vector<Tool>&& tools, const std::map<String, Nat>& categoryCapacities);
+
+    /**
+     * @return "yes" if a run of the category can start, "busy" if its capacity is used up, "no" if no tool has it
+     */
     String category_available(const String& c) const;
     Capabilities get_capabilities() const;
     std::set<String> get_tools(const String& category) const;
-    ToolReservation reserveTool(const std::string& name);
+
+    /**
+     * @return The tools of the category, by name
+     */
+    std::vector<SharedTool> get_members(const String& category) const;
+
+    /**
+     * Picks the tool to run a request that names a category rather than a tool: the tool of the category
+     * with the smallest share of its instances in use, the one with more free instances of equally loaded ones.
+     * Reads the reservation counters only, without a lock.
+     * @return nullptr if the category has no tool that can be run
+     */
+    SharedTool route(const String& category) const;
+
+    /**
+     * @return Runs of the category that may start now: its capacity (the instances of its tools,
+     *         at most its category capacity) less its reservations
+     */
+    Nat get_category_free(const String& category) const;
+
+    struct Availability {
+      String category;
+      Nat free;                                // See get_category_free()
+      std::vector<std::pair<String, bool>> tools; // Lowercase name, whether it has a free instance
+    };
+
+    /**
+     * Availability of every category and its tools, read from the reservation counters without a lock
+     */
+    std::vector<Availability> get_availability() const;
+    
+    /**
+     * Limits the number of runs of a category that may execute concurrently (regardless of the tool)
+     * @param category
+     * @param capacity
+     */
+    void set_category_capacity(const String& category, Nat capacity);
+    
+    /**
+     * @return The maximal number of concurrent runs of the category, unlimitedCapacity if not limited
+     */
+    Nat get_category_capacity(const String& category) const;
+    
+    /**
+     * Returns the portfolio pseudo-tool of a category, made with the snapshot.
+     * @param category
+     * @return nullptr if no tool has the category
+     */
+    SharedTool get_portfolio(const String& category) const;
+
+    /**
+     * @param file The toolkit file the toolkit was read from (see ToolKitXMLFactory), reload() reads it again
+     */
+    void set_source(const String& file);
+    String get_source() const;
+
+    /**
+     * Reads the source file again and swaps in its tools; the tools of the same name keep counting the reservations
+     * of the tools they replace (see ReservationCounters). The toolkit does not change if the file cannot be read.
+     * @return false if the file cannot be read
+     */
+    bool reload();
+
+    /**
+     * Reloads the toolkit whenever its source file changes (see SourceWatcher), until it is destroyed
+     */
+    void watch();
     
   protected:
+    /// Case-insensitive, a lookup does not make a lowercase copy of the name
+    struct NameHash {
+      size_t operator()(const String& name) const;
+    };
+    struct NameEqual {
+      bool operator()(const String& left, const String& right) const;
+    };
+
+    struct Member {
+      SharedTool tool;
+      String name;                                    // Lowercase
+      Nat capacity;                                   // Instances of the tool, zero if it is blocked
+      std::shared_ptr<const std::atomic<Nat>> active; // See Tool::get_instance_counter()
+    };
+
+    struct Category {
+      std::vector<Member> members;             // By name
+      Nat capacity = 0;                        // Instances of the members, at most the category capacity
+      std::shared_ptr<std::atomic<Nat>> active; // Reservations of the members, the same counter in every snapshot and toolkit
+      SharedTool portfolio;                    // The category's portfolio pseudo-tool
+    };
+
+    struct Snapshot {
+      std::unordered_map<String, SharedTool, NameHash, NameEqual> tools; // By lowercase name
+      Capabilities capabilities;
+      std::map<String, Nat> categoryCapacities;
+      std::map<String, Category> categories;
+    };
+
+    /**
+     * Holds the current snapshot while it is read; the snapshot is not deleted until every reader that may have it let go
+     */
+    class Reader {
+    public:
+      Reader(const ToolKit& toolKit);
+      ~Reader() { toolKit.readers--; }
+      const Snapshot* operator->() const { return snapshot; }
+    private:
+      const ToolKit& toolKit;
+      const Snapshot* snapshot;
+    };
+
     static std::string normalizeName(const std::string& name);
+
+    /**
+     * Makes the categories and portfolios of the snapshot's tools. The tools and categories count their reservations
+     * in the process-wide counters of their names (see ReservationCounters).
+     */
+    static void index(Snapshot& snapshot);
+
+    /// Needs writeMutex. Swaps the snapshot in, deletes the previous one once it is not read.
+    void publish_nomutex(std::unique_ptr<Snapshot>&& snapshot);
     
-    mutable std::recursive_mutex mutex;
-    std::map<String, Tool> toolStore;
-    Capabilities capabilities;
-    using ToolStoreIterator = decltype(toolStore)::iterator;
-    std::map<String, std::list<ToolStoreIterator>> toolsByCategoryMap;
+    std::atomic<const Snapshot*> current; // Never null
+    mutable std::atomic<Nat> readers;     // Readers that may hold a snapshot (see Reader)
+    mutable std::mutex writeMutex;        // Serialises the changes, guards source
+    String source;
+    bool watched;
+  };
+
+  /**
+   * Process-wide thread that reloads toolkits when their source files change, watched with inotify. The directory
+   * of a file is watched, so that a file replaced by a rename (as editors save) is noticed as well as one rewritten.
+   */
+  class SourceWatcher {
+  public:
+    static SourceWatcher& instance();
+
+    SourceWatcher(const SourceWatcher& other) = delete;
+    SourceWatcher& operator=(const SourceWatcher& other) = delete;
+    ~SourceWatcher();
+
+    void add(ToolKit& toolKit);
+
+    /**
+     * Waits for a reload of the toolkit in progress
+     */
+    void remove(ToolKit& toolKit);
+
+  private:
+    SourceWatcher();
+    void serve();
+
+    std::mutex mutex;
+    int inotifyFd;
+    int stopFds[2]; // Pipe that wakes the thread to stop
+    std::map<int, String> directories; // By watch descriptor
+    std::multimap<String, ToolKit*> toolKits; // By absolute path of the source file
+    std::thread thread;
   };
 }
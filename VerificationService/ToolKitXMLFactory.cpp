@@ -18,6 +18,7 @@
 #include <fstream>
 #include<mutex>
 #include <set>
+#include <vector>
 
 #include "bbb.h"
 
@@ -28,38 +29,75 @@ namespace ToolKit {
     String xmlString;
     bbb::read_file(xmlFilePath, xmlString);
     auto xml = XMLSupport::Xml(xmlString);
-    return create(xml);
+    ToolKit toolkit = create(xml, xmlFilePath + ".versions");
+    toolkit.set_source(xmlFilePath);
+    return toolkit;
   }
 
-  ToolKit ToolKitXMLFactory::create(const XMLSupport::Xml& xml) {
+  ToolKit ToolKitXMLFactory::create(const XMLSupport::Xml& xml, const String& versionFile) {
     ToolKit toolkit;
     XMLSupport::Indices toolItems;
     xml.find_items("tool", toolItems);
+    std::vector<Tool> tools;
+    Strings paths;
     for (const XMLSupport::Index toolItem : toolItems) {
-      toolkit.insert(createToolFromItem(xml, toolItem));
+      tools.push_back(createToolFromItem(xml, toolItem));
+      paths.push_back(tools.back().get_path());
     }
+    std::vector<VersionCache::Version> versions = VersionCache::instance().get(paths, versionFile); // All probes at once
+    for (size_t i = 0; i < tools.size(); i++)
+      tools[i].set_version(versions[i].text, versions[i].runnable);
+    toolkit.insert(std::move(tools), getCategoryLimits(xml)); // Indexed once
     return toolkit;
   }
 
   Tool ToolKitXMLFactory::createToolFromItem(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId)
   {
     String name, path, outputParser;
-    bool singleInstance;
+    bool singleInstance, earlyTermination;
+    Nat memory, maxInstances, cores;
     std::set<String> capabilities;
-    getToolProperties(xml, toolItemId, name, path, outputParser, singleInstance);
+    getToolProperties(xml, toolItemId, name, path, outputParser, singleInstance, memory, maxInstances, cores, earlyTermination);
     getToolCapabilities(xml, toolItemId, capabilities);
     Tool tool(name, path, outputParser, singleInstance);
     tool.set_capabilities(std::move(capabilities));
+    tool.set_memory_per_run(memory);
+    tool.set_cores_per_run(cores);
+    tool.set_early_termination(earlyTermination);
+    tool.set_session(getToolSession(xml, toolItemId));
+    if (maxInstances > 0) // Otherwise derived from single_instance
+      tool.set_max_instances(maxInstances);
     return tool;
   }
 
-  void ToolKitXMLFactory::getToolProperties(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, String& name, String& path, String& outputParser, bool& singleInstance) {
+  void ToolKitXMLFactory::getToolProperties(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, String& name, String& path, String& outputParser, bool& singleInstance, Nat& memory, Nat& maxInstances, Nat& cores, bool& earlyTermination) {
     XMLSupport::Indices parameters;
     xml.get_params(toolItemId, parameters);
     name = xml.find_param_value_string(parameters, "name");
     path = xml.find_param_value_string(parameters, "path");
-    outputParser = xml.find_param_value_string(parameters, "output_parser");
+    outputParser = xml.find_param_value_string(parameters, "output_parser", ""); // Tools without a parser get the dummy verdict
     singleInstance = xml.find_param_value_bool(parameters, "single_instance");
+    memory = xml.find_param_value_nat(parameters, "memory", defaultMemoryPerRun);
+    maxInstances = xml.find_param_value_nat(parameters, "max_instances", 0);
+    cores = xml.find_param_value_nat(parameters, "cores", 1);
+    earlyTermination = xml.find_param_value_bool(parameters, "early_termination", false);
+  }
+
+  /**
+   * Reads the optional protocol, session_arguments, session_max_uses, session_max_memory, session_max_processes
+   * and session_idle_timeout attributes of a tool
+   */
+  SessionSettings ToolKitXMLFactory::getToolSession(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId) {
+    XMLSupport::Indices parameters;
+    xml.get_params(toolItemId, parameters);
+    SessionSettings settings;
+    settings.protocol = xml.find_param_value_string(parameters, "protocol", "");
+    settings.arguments = xml.find_param_value_string(parameters, "session_arguments", "");
+    settings.maxUses = xml.find_param_value_nat(parameters, "session_max_uses", settings.maxUses);
+    settings.maxMemory = xml.find_param_value_nat(parameters, "session_max_memory", settings.maxMemory);
+    settings.maxProcesses = std::max<Nat>(1, xml.find_param_value_nat(parameters, "session_max_processes", settings.maxProcesses));
+    settings.idleTimeout = xml.find_param_value_nat(parameters, "session_idle_timeout", settings.idleTimeout);
+    return settings;
   }
 
   void ToolKitXMLFactory::getToolCapabilities(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, std::set<String>& capabilities) {
@@ -73,4 +111,19 @@ namespace ToolKit {
       }
     }
   }
-}
\ No newline at end of file
+
+  /**
+   * Reads the optional top-level <category_limit name="..." max_runs="..."/> items
+   */
+  std::map<String, Nat> ToolKitXMLFactory::getCategoryLimits(const XMLSupport::Xml& xml) {
+    std::map<String, Nat> capacities;
+    XMLSupport::Indices limitItems;
+    xml.find_items("category_limit", limitItems);
+    for (const XMLSupport::Index limitItem : limitItems) {
+      XMLSupport::Indices parameters;
+      xml.get_params(limitItem, parameters);
+      capacities[xml.find_param_value_string(parameters, "name")] = xml.find_param_value_nat(parameters, "max_runs", unlimitedCapacity);
+    }
+    return capacities;
+  }
+}
@@ -22,11 +22,22 @@
 namespace ToolKit {
   class ToolKitXMLFactory {
   public:
+    /**
+     * The versions of the tools are kept in "<xmlFilePath>.versions" (see VersionCache).
+     * The file becomes the source of the toolkit, see ToolKit::reload().
+     */
     static ToolKit create(const String& xmlFilePath);
-    static ToolKit create(const XMLSupport::Xml& xml);
+
+    /**
+     * @param xml
+     * @param versionFile Where the versions of the tools are kept, empty for none (see VersionCache)
+     */
+    static ToolKit create(const XMLSupport::Xml& xml, const String& versionFile = "");
   protected:
     static Tool createToolFromItem(const XMLSupport::Xml& xml, XMLSupport::Index toolItemId);
-    static void getToolProperties(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, String & name, String & path, String& outputParser, bool & singleInstance);
+    static void getToolProperties(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, String & name, String & path, String& outputParser, bool & singleInstance, Nat & memory, Nat & maxInstances, Nat & cores, bool & earlyTermination);
+    static SessionSettings getToolSession(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId);
     static void getToolCapabilities(const XMLSupport::Xml& xml, const XMLSupport::Index toolItemId, std::set<String>& capabilities);
+    static std::map<String, Nat> getCategoryLimits(const XMLSupport::Xml& xml);
   };
 }
\ No newline at end of file
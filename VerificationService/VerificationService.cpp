@@ -20,21 +20,29 @@
 #include <sys/stat.h>
 
 #include "VerificationService.h"
+#include "Zygote.h"
 
 using namespace std::literals::chrono_literals;
 
 VerificationService::VerificationService(ToolKit::ToolKit&& toolkit) : VerificationService() {
   toolKit = std::move(toolkit);
+  toolKit.watch(); // A changed toolkit file is picked up without a restart
+  adoptHeldRuns();
 }
 
 VerificationService::VerificationService() : archive("./archiveReports", "./archiveFiles"),
                                              toolKit{},
-                                             workspaceManager("./workspaces/"),
+                                             workspaceManager("./workspaces/", heldWorkspaceDirectories()),
+                                             scheduler(archive, toolKit),
                                              tick(1s),
-                                             doObserve(true),
-                                             previousNumberOfTasks(-1),
-                                             observer(&VerificationService::observe,
-                                             this) {
+                                             previousNumberOfTasks(-1) {
+  // Parked after every round, requestDispatch() wakes it; woken while it runs, it runs once more right away:
+  dispatcher = Timers::TimerService::background().schedule(Dur(1), [this] () { dispatch(); return false; });
+  // Up to a quarter of a tick early, to share the wake-up with the other services' observers:
+  observer = Timers::TimerService::instance().schedule(tick, [this] () { return observe(); }, tick / 4);
+  scheduler.abandonTimeout = executionWindow.monitorTimeout;
+  scheduler.preemptingPriority = RequestResponse::interactivePriority;
+  scheduler.preemptiblePriority = RequestResponse::batchPriority;
 /*  std::ifstream aStream("archive.dat");
   if (aStream.is_open()) {
     //archive.read(aStream);//TODO
@@ -43,52 +51,192 @@ VerificationService::VerificationService() : archive("./archiveReports", "./arch
 }
 
 VerificationService::~VerificationService() {
-  doObserve = false;
-  observer.join();
+  Timers::TimerService::instance().cancel(observer);
+  Timers::TimerService::background().cancel(dispatcher);
 /*  std::fstream aStream;
   aStream.open("archive.dat", std::fstream::out | std::fstream::app);
   archive.write(aStream);
   aStream.close();*/
 }
 
-/** Keep observing the number of the running tasks. Update statistics, if there is any running task. */
-void VerificationService::observe() {
-  //std::cout << "Thread started.\n";
-  //int tInLS = 60;
-  //int i = 0;
-  while (doObserve) {
-    //std::cout << "Doing loop.\n";
-    std::this_thread::sleep_for(tick);
-    if (executionWindow.size() != previousNumberOfTasks) {
-      previousNumberOfTasks = executionWindow.size();
-      DEB(std::to_string(previousNumberOfTasks) + " running tasks.");
+std::set<std::string> VerificationService::heldWorkspaceDirectories() {
+  std::set<std::string> directories;
+  Zygote::Zygote* zygote = Zygote::Zygote::instance();
+  if (!zygote)
+    return directories;
+  for (const Zygote::Zygote::HeldProcess& process : zygote->held()) {
+    ExecutionEngine::RunRecord record;
+    if (record.from_tag(process.tag))
+      directories.insert(Workspace::filesystem::path(record.workspaceDirectory).filename().string());
+  }
+  return directories;
+}
+
+/// Reports are restored in ascending order of their IDs before any request comes (see Archive::restore_report()).
+/// Parents of members are restored as plain portfolio groups: the parent takes the first definitive verdict of its
+/// restored members, whatever the earlier server started it as.
+void VerificationService::adoptHeldRuns() {
+  Zygote::Zygote* zygote = Zygote::Zygote::instance();
+  if (!zygote || !zygote->claim_held())
+    return;
+  std::vector<std::pair<pid_t, ExecutionEngine::RunRecord>> runs;
+  for (const Zygote::Zygote::HeldProcess& process : zygote->held()) {
+    ExecutionEngine::RunRecord record;
+    if (record.from_tag(process.tag))
+      runs.emplace_back(process.pid, std::move(record));
+    else
+      DEB("Held process " << process.pid << " is not a run, leaving it alone");
+  }
+  std::map<Archive::ReportID, std::pair<const ExecutionEngine::RunRecord*, bool>> reports; // The run of each report, whether it is a parent
+  for (const auto& run : runs) {
+    reports[run.second.reportID] = {&run.second, false};
+    if (run.second.monitoredReportID != run.second.reportID)
+      reports.emplace(run.second.monitoredReportID, std::make_pair(&run.second, true));
+  }
+  std::set<Archive::ReportID> restored;
+  for (const auto& entry : reports) {
+    const ExecutionEngine::RunRecord& record = *entry.second.first;
+    const bool parent = entry.second.second;
+    auto tool = toolKit.get(parent ? record.workspaceTool : record.tool);
+    if (!tool && parent)
+      tool = toolKit.get_portfolio(record.workspaceTool);
+    if (!tool)
+      tool = toolKit.get(record.tool);
+    if (!tool) {
+      DEB("Cannot restore report " << entry.first << ": unknown tool " << record.tool);
+      continue;
+    }
+    Archive::Report report(tool, record.parameters, record.inputFiles, record.automationPlanName, getLocalAddress(),
+                           record.outputNames.size());
+    report.outputNames = record.outputNames;
+    if (parent) {
+      report.running = true;
+      report.runningResult = "Taken over after a restart of the server.";
     }
-    if (executionWindow.empty())
+    if (archive.restore_report(entry.first, report))
+      restored.insert(entry.first);
+  }
+  std::map<Archive::ReportID, std::vector<Archive::ReportID>> members; // By parent
+  for (const auto& run : runs)
+    if (run.second.monitoredReportID != run.second.reportID && restored.count(run.second.monitoredReportID))
+      members[run.second.monitoredReportID].push_back(run.second.reportID);
+  std::map<Archive::ReportID, Portfolio::SharedGroup> groups;
+  for (auto& parent : members) {
+    auto group = std::make_shared<Portfolio::Group>(parent.first, std::move(parent.second));
+    groups[parent.first] = group;
+    std::lock_guard<decltype(portfoliosMutex)> lockGuard(portfoliosMutex);
+    portfolios[parent.first] = group;
+  }
+  for (auto& run : runs) {
+    const ExecutionEngine::RunRecord& record = run.second;
+    if (!restored.count(record.reportID))
       continue;
+    try {
+      Workspace::SharedWorkspace workspace = workspaceManager.adopt(record.workspaceDirectory, record.workspaceTool).second;
+      workspace->addReport(record.reportID);
+      workspace->addReport(record.monitoredReportID);
+      Scheduler::Job job{record.reportID, workspace, "", archive.get_report(record.reportID).tool, record.tenant, record.priority,
+                         record.timeLimit};
+      if (groups.count(record.monitoredReportID))
+        job.group = groups[record.monitoredReportID];
+      executionWindow.adopt_run(job, archive, Launcher::Process(run.first, zygote->shared_from_this()), record,
+                                scheduler.allocate(job));
+      DEB("Took over the run of report " << record.reportID << ", PID: " << run.first);
+    }
+    catch (const std::exception& e) {
+      DEB("Cannot take over the run of report " << record.reportID << ": " << e.what());
+    }
+  }
+  Timers::TimerService::instance().wake(observer);
+}
+
+/** Observe the number of the running tasks. Update statistics, if there is any running task. */
+bool VerificationService::observe() {
+  if (executionWindow.size() != previousNumberOfTasks) {
+    previousNumberOfTasks = executionWindow.size();
+    DEB(std::to_string(previousNumberOfTasks) + " running tasks.");
+  }
+  if (!executionWindow.empty()) {
     //Archive::Reports resources;
     //TimePoint present = SClock::now();
     DEB("Updating stats.");
     executionWindow.update_stats();//report_finished(present);//, resources);
-    // if (resources.empty())
-    //   continue;
+  }
+  bool waiting;
+  {
+    std::lock_guard<decltype(portfoliosMutex)> lockGuard(portfoliosMutex);
+    for (auto it = portfolios.begin(); it != portfolios.end(); )
+      it = (it->second->is_decided() ? portfolios.erase(it) : std::next(it));
+    waiting = !portfolios.empty();
+  }
+  {
+    std::lock_guard<decltype(stepsMutex)> lockGuard(stepsMutex);
+    waiting = waiting || !pendingSteps.empty();
+  }
+  // Finished runs may have produced the inputs of waiting steps, and freed resources for the queued runs and the suspended ones:
+  if (waiting || !scheduler.empty() || executionWindow.has_suspended())
+    requestDispatch();
+  // if (resources.empty())
+  //   continue;
+
+  //archive.store_reports(resources);
+  return waiting || !executionWindow.empty() || !scheduler.empty();
+}
+
+void VerificationService::requestDispatch() {
+  Timers::TimerService::background().wake(dispatcher);
+}
+
+void VerificationService::dispatch() {
+  try {
+    resolvePendingSteps();
+    if (!scheduler.empty() || executionWindow.has_suspended())
+      dispatchQueued();
+  }
+  catch (const std::exception& e) {
+    DEB("Dispatching failed: " << e.what());
+  }
+}
 
-    //archive.store_reports(resources);
+void VerificationService::dispatchQueued() {
+  Timers::TimerService::instance().wake(observer);
+  // Interactive verifications waiting for cores get them from batch runs, which continue once cores are free again:
+  Nat preempted = scheduler.cores_to_preempt();
+  if (preempted > 0)
+    executionWindow.suspend_runs(preempted, scheduler.preemptiblePriority);
+  else
+    executionWindow.resume_runs();
+  for (Scheduler::Dispatch& dispatch : scheduler.next_dispatches()) {
+    try {
+      executionWindow.start_new_run(dispatch.job, archive, std::move(dispatch.allocation), std::move(dispatch.slot));
+    }
+    catch (const std::runtime_error& e) {
+      DEB(e.what());
+      archive.borrow_report(dispatch.job.reportID)->runningResult = e.what();
+      if (dispatch.job.group)
+        dispatch.job.group->member_dropped(dispatch.job.reportID, archive);
+    }
   }
 }
 
 std::pair<Workspace::WorkspaceID, std::string> VerificationService::createWorkspace(const std::string& toolName) {
-  ToolKit::ToolReservation toolReservation = toolKit.reserveTool(toolName);
-  std::pair<Workspace::WorkspaceID, Workspace::SharedWorkspace> answer(workspaceManager.create(std::move(toolReservation)));
+  auto tool = toolKit.get(toolName);
+  if (!tool)
+    tool = toolKit.get_portfolio(toolName);
+  if (!tool)
+    throw ToolKit::ReservationError("Reservation failed: no such tool or category in toolkit");
+  std::pair<Workspace::WorkspaceID, Workspace::SharedWorkspace> answer(workspaceManager.create(tool->get_name()));
   return {answer.first, answer.second->getWebPath()};
 }
 
-void VerificationService::destroyWorkspace(const Workspace::WorkspaceID& workspaceID) {
+void VerificationService::destroyWorkspace(Workspace::WorkspaceID workspaceID) {
   workspaceManager.destroy(workspaceID);
 }
 
-std::pair<bool, Archive::FileID> VerificationService::addFile(const Workspace::WorkspaceID& workspaceID, const std::string& fileName, const std::string& fileContent) {
+std::pair<bool, Archive::FileID> VerificationService::addFile(Workspace::WorkspaceID workspaceID, const std::string& fileName, const std::string& fileContent) {
   // Get relevant workspace:
   Workspace::SharedWorkspace workspace(workspaceManager.get(workspaceID));
+  workspace->admitUpload(fileContent.size());
   std::pair<bool, Archive::FileID> answer = archive.checkin_file(fileContent);
   // Make the file available from the current workspace:
   workspace->checkinFile(archive, answer.second, fileName);
@@ -104,18 +252,34 @@ std::pair<bool, Archive::ReportID> VerificationService::verify(const RequestResp
   String toolName = verificationRequest.get_tool_name();
   DEB("\nTool name: " + toolName);
   auto tool = toolKit.get(toolName);
-  if (!tool)
+  auto category = (tool ? nullptr : toolKit.get_portfolio(toolName)); // The plan names a category
+  if (!tool && !category)
    throw std::runtime_error("Cannot verify: Unknown tool. (" + toolName + ")");
 
-  // Check if the requested tool is reserved for this workspace:
-  if (workspace->getTool().get_name() != tool.value().get_name())
-   throw ToolKit::ReservationError("Invalid tool requested. Requested " + tool.value().get_name() + " but reserved " + workspace->getTool().get_name());
+  // Check if the requested tool is the one the workspace was created for:
+  String requested = (tool ? tool : category)->get_name();
+  if (workspace->getToolName() != requested)
+   throw ToolKit::ReservationError("Invalid tool requested. Requested " + requested + " but reserved " + workspace->getToolName());
+
+  // A category runs its least loaded tool, or all its tools as a portfolio:
+  bool portfolio = category && verificationRequest.get_portfolio();
+  if (category) {
+    tool = (portfolio ? category : toolKit.route(toolName));
+    if (!tool)
+      throw std::runtime_error("Cannot verify: No usable tool in category " + toolName);
+    DEB("Category " << toolName << " runs " << tool->get_name());
+  }
 
   // Identify input filenames and make sure the files are available.
   std::vector<Archive::FileID> inputFileIDs;
+  bool chained = false; // Some inputs are outputs of earlier reports
   {
     Strings inputs = verificationRequest.get_input_names();
     for (const std::string& input: inputs) {
+      if (!input.empty() && input[0] == '@') {
+        chained = true;
+        continue;
+      }
       try {
         Archive::FileID id = std::stoul(input);
         if (!workspace->hasFile(id)) // Verify that the workspace is allowed to access the file
@@ -134,7 +298,17 @@ std::pair<bool, Archive::ReportID> VerificationService::verify(const RequestResp
   DEB("Read schema \"" + schema + "\"");
   String automationPlan = verificationRequest.get_auto_plan_name();	// e.g. "http://honeywell.com/autoplans/MuxDemuxMuxDemux"
   DEB("Automation plan \n" + automationPlan + "\nEnd Automation plan");
-  auto answer = archive.checkin_report(tool.value(),
+  std::vector<Strings> sweepPoints;
+  Strings sweepLabels;
+  if (verificationRequest.get_sweep())
+    Portfolio::expand_sweep(verificationRequest.get_parameters(), sweepPoints, sweepLabels);
+  if (portfolio && !sweepPoints.empty())
+    throw std::runtime_error("Cannot verify: A parameter sweep needs a single tool, not a portfolio (" + toolName + ")");
+  if (chained && (portfolio || !sweepPoints.empty()))
+    throw std::runtime_error("Cannot verify: A step with inputs from earlier reports needs a single tool, not a portfolio, and no sweep (" + toolName + ")");
+  if (chained)
+    return startStep(tool, workspace, verificationRequest, schema, automationPlan);
+  auto answer = archive.checkin_report(tool,
                                 verificationRequest.get_parameters(),
                                 inputFileIDs,
                                 automationPlan,
@@ -144,29 +318,333 @@ std::pair<bool, Archive::ReportID> VerificationService::verify(const RequestResp
   // Report was either known or created. Add its id to the workspace's allowed reports:
   workspace->addReport(answer.second);
   
-  if (answer.first || !archive.borrow_report(answer.second)->is_valid()) {
-    executionWindow.start_new_run(answer.second, archive, workspace, schema);
-    return {true, answer.second};
-  } 
-  else {
+  if (!answer.first && archive.borrow_report(answer.second)->is_valid())
     return {false, answer.second};
+
+  if (scheduler.is_queued(answer.second) || archive.borrow_report(answer.second)->in_progress())
+    return {true, answer.second}; // The same verification is already in progress
+
+  if (!sweepPoints.empty()) {
+    startSweep(answer.second, tool, workspace, verificationRequest, inputFileIDs, schema, automationPlan,
+               std::move(sweepPoints), std::move(sweepLabels));
+    requestDispatch();
+    return {true, answer.second};
+  }
+
+  if (portfolio) {
+    startPortfolio(answer.second, tool->get_name(), workspace, verificationRequest, inputFileIDs, schema, automationPlan);
+    requestDispatch();
+    return {true, answer.second};
+  }
+
+  scheduler.submit({answer.second,
+                    workspace,
+                    schema,
+                    tool,
+                    verificationRequest.get_tenant(),
+                    verificationRequest.get_priority(),
+                    verificationRequest.get_time_limit()});
+  requestDispatch(); // Launching is the dispatcher's, it must not hold up the request
+  return {true, answer.second};
+}
+
+void VerificationService::startPortfolio(Archive::ReportID parentID, const String& category, Workspace::SharedWorkspace& workspace,
+                                         const RequestResponse::Request& verificationRequest, const std::vector<Archive::FileID>& inputFileIDs,
+                                         const String& schema, const String& automationPlan) {
+  std::vector<Archive::ReportID> members;
+  std::vector<ToolKit::SharedTool> tools;
+  std::vector<bool> known; // The member's verdict is already in the archive
+  for (const ToolKit::SharedTool& member : toolKit.get_members(category)) {
+    if (member->is_blocked())
+      continue;
+    auto answer = archive.checkin_report(member,
+                                         verificationRequest.get_parameters(),
+                                         inputFileIDs,
+                                         automationPlan,
+                                         getLocalAddress(),
+                                         std::count(schema.begin(), schema.end(), 'o'));
+    workspace->addReport(answer.second);
+    members.push_back(answer.second);
+    tools.push_back(member);
+    known.push_back(!answer.first && archive.borrow_report(answer.second)->is_valid());
+  }
+  if (members.empty())
+    throw std::runtime_error("Cannot verify: No usable tool in category " + category);
+
+  auto group = std::make_shared<Portfolio::Group>(parentID, std::vector<Archive::ReportID>(members));
+  {
+    auto parent = archive.borrow_report(parentID);
+    parent->running = true;
+    parent->runningResult = "Racing " + std::to_string(members.size()) + " tools.";
+  }
+  DEB("Portfolio of report " << parentID << " races " << members.size() << " tools of " << category);
+  for (size_t i = 0; i < members.size(); i++) {
+    if (known[i])
+      group->member_finished(members[i], archive);
+  }
+  if (group->is_decided())
+    return;
+  {
+    std::lock_guard<decltype(portfoliosMutex)> lockGuard(portfoliosMutex);
+    portfolios[parentID] = group;
+  }
+  for (size_t i = 0; i < members.size(); i++) {
+    if (known[i])
+      continue;
+    Scheduler::Job job{members[i], workspace, schema, tools[i], verificationRequest.get_tenant(), verificationRequest.get_priority(),
+                       verificationRequest.get_time_limit()};
+    job.group = group;
+    scheduler.submit(std::move(job));
+  }
+}
+
+void VerificationService::startSweep(Archive::ReportID parentID, const ToolKit::SharedTool& tool, Workspace::SharedWorkspace& workspace,
+                                     const RequestResponse::Request& verificationRequest, const std::vector<Archive::FileID>& inputFileIDs,
+                                     const String& schema, const String& automationPlan, std::vector<Strings>&& points, Strings&& labels) {
+  std::vector<Archive::ReportID> members;
+  std::vector<bool> known; // The point's verdict is already in the archive
+  for (const Strings& parameters : points) {
+    auto answer = archive.checkin_report(tool,
+                                         parameters,
+                                         inputFileIDs,
+                                         automationPlan,
+                                         getLocalAddress(),
+                                         std::count(schema.begin(), schema.end(), 'o'));
+    workspace->addReport(answer.second);
+    members.push_back(answer.second);
+    known.push_back(!answer.first && archive.borrow_report(answer.second)->is_valid());
+  }
+
+  auto group = std::make_shared<Portfolio::Sweep>(parentID, std::vector<Archive::ReportID>(members), std::move(labels),
+                                                  verificationRequest.get_sweep_until_definitive());
+  {
+    auto parent = archive.borrow_report(parentID);
+    parent->running = true;
+    parent->runningResult = "Sweeping " + std::to_string(members.size()) + " points.";
+  }
+  DEB("Sweep of report " << parentID << " runs " << members.size() << " points of " << tool->get_name());
+  for (size_t i = 0; i < members.size() && !group->is_decided(); i++) {
+    if (known[i])
+      group->member_finished(members[i], archive);
+  }
+  if (group->is_decided())
+    return;
+  {
+    std::lock_guard<decltype(portfoliosMutex)> lockGuard(portfoliosMutex);
+    portfolios[parentID] = group;
+  }
+  for (size_t i = 0; i < members.size(); i++) {
+    if (known[i])
+      continue;
+    Scheduler::Job job{members[i], workspace, schema, tool, verificationRequest.get_tenant(), verificationRequest.get_priority(),
+                       verificationRequest.get_time_limit()};
+    job.group = group;
+    scheduler.submit(std::move(job));
+  }
+}
+
+std::pair<bool, Archive::ReportID> VerificationService::startStep(const ToolKit::SharedTool& tool, Workspace::SharedWorkspace& workspace,
+                                                                  const RequestResponse::Request& verificationRequest,
+                                                                  const String& schema, const String& automationPlan) {
+  PendingStep step{0, tool, workspace, verificationRequest.get_parameters(), {}, schema, automationPlan,
+                   verificationRequest.get_tenant(), verificationRequest.get_priority(), verificationRequest.get_time_limit()};
+  Strings identity = step.parameters; // The step's report is told apart by the outputs it takes
+  std::vector<Archive::FileID> files;
+  for (const String& input : verificationRequest.get_input_names()) {
+    StepInput stepInput{false, 0, 0, 0};
+    try {
+      if (input.empty() || input[0] != '@') {
+        stepInput.file = std::stoul(input);
+        if (!workspace->hasFile(stepInput.file))
+          throw std::logic_error("");
+        files.push_back(stepInput.file);
+      }
+      else {
+        size_t colon = input.find(':');
+        if (colon == String::npos)
+          throw std::logic_error("");
+        stepInput.dependency = true;
+        stepInput.report = std::stoul(input.substr(1, colon - 1));
+        stepInput.output = std::stoul(input.substr(colon + 1));
+        if (!workspace->isReportAllowed(stepInput.report) || !archive.has_report(stepInput.report)
+            || stepInput.output >= archive.borrow_report(stepInput.report)->outputNames.size())
+          throw std::logic_error("");
+        identity.push_back(input);
+      }
+    }
+    catch (const std::logic_error& e) {
+      throw std::runtime_error("Invalid input file ID specified: " + input);
+    }
+    step.inputs.push_back(stepInput);
+  }
+  auto answer = archive.checkin_report(tool,
+                                       identity,
+                                       files,
+                                       automationPlan,
+                                       getLocalAddress(),
+                                       std::count(schema.begin(), schema.end(), 'o'));
+  workspace->addReport(answer.second);
+  {
+    auto report = archive.borrow_report(answer.second);
+    if (!answer.first && report->is_valid())
+      return {false, answer.second};
+    if (report->in_progress())
+      return {true, answer.second}; // The same step is already waiting or running
+    report->running = true;
+    report->runningResult = "Waiting for the reports it depends on.";
   }
+  DEB("Step of report " << answer.second << " waits for the reports it depends on");
+  step.reportID = answer.second;
+  {
+    std::lock_guard<decltype(stepsMutex)> lockGuard(stepsMutex);
+    pendingSteps.push_back(std::move(step));
+  }
+  requestDispatch(); // The dispatcher resolves the step if its inputs are there already
+  return {true, answer.second};
 }
 
-std::string VerificationService::getMonitoringOSLC(const Workspace::WorkspaceID& workspaceID, const Archive::ReportID& reportID) {
+void VerificationService::resolvePendingSteps() {
+  std::lock_guard<decltype(stepsMutex)> lockGuard(stepsMutex);
+  for (auto it = pendingSteps.begin(); it != pendingSteps.end(); ) {
+    PendingStep& step = *it;
+    std::vector<Archive::FileID> inputFileIDs;
+    String failure;
+    bool waiting = false;
+    for (StepInput& input : step.inputs) {
+      if (input.dependency) {
+        if (scheduler.is_queued(input.report)) {
+          waiting = true;
+          break;
+        }
+        String outputName;
+        {
+          auto report = archive.borrow_report(input.report);
+          if (report->in_progress()) {
+            waiting = true;
+            break;
+          }
+          auto output = report->outputFiles.find(input.output);
+          if (!report->is_valid())
+            failure = "Report n. " + std::to_string(input.report) + " it depends on did not finish.";
+          else if (output == report->outputFiles.end())
+            failure = "Report n. " + std::to_string(input.report) + " it depends on did not write "
+                      + report->outputNames[input.output] + ".";
+          else {
+            input.file = output->second;
+            outputName = report->outputNames[input.output];
+          }
+        }
+        if (!failure.empty())
+          break;
+        // The output becomes a file of the workspace, so that the step's run gets it like any other input:
+        step.workspace->checkinFile(archive, input.file, "step-" + std::to_string(input.report) + "-" + outputName);
+        input.dependency = false;
+      }
+      inputFileIDs.push_back(input.file);
+    }
+    if (waiting) {
+      ++it;
+      continue;
+    }
+    if (!failure.empty()) {
+      DEB("Step of report " << step.reportID << " failed: " << failure);
+      auto report = archive.borrow_report(step.reportID);
+      report->running = false;
+      report->runningResult = failure;
+      it = pendingSteps.erase(it);
+      continue;
+    }
+
+    // A step whose inputs did not change since it ran last is found in the archive:
+    auto member = archive.checkin_report(step.tool,
+                                         step.parameters,
+                                         inputFileIDs,
+                                         step.automationPlan,
+                                         getLocalAddress(),
+                                         std::count(step.schema.begin(), step.schema.end(), 'o'));
+    step.workspace->addReport(member.second);
+    bool known, busy;
+    {
+      auto report = archive.borrow_report(member.second);
+      known = report->is_valid();
+      busy = report->in_progress();
+    }
+    if (!known && (busy || scheduler.is_queued(member.second))) {
+      ++it; // The same step runs for another plan
+      continue;
+    }
+    auto group = std::make_shared<Portfolio::Step>(step.reportID, member.second);
+    if (known)
+      group->member_finished(member.second, archive);
+    else {
+      {
+        std::lock_guard<decltype(portfoliosMutex)> portfoliosGuard(portfoliosMutex);
+        portfolios[step.reportID] = group;
+      }
+      archive.borrow_report(step.reportID)->runningResult = "Running as report n. " + std::to_string(member.second) + ".";
+      Scheduler::Job job{member.second, step.workspace, step.schema, step.tool, step.tenant, step.priority, step.timeLimit};
+      job.group = group;
+      scheduler.submit(std::move(job));
+    }
+    DEB("Step of report " << step.reportID << (known ? " found in the archive as report " : " runs as report ") << member.second);
+    it = pendingSteps.erase(it);
+  }
+}
+
+std::string VerificationService::getMonitoringOSLC(Workspace::WorkspaceID workspaceID, const Archive::ReportID& reportID) {
   Workspace::SharedWorkspace workspace = workspaceManager.get(workspaceID);
       if (!workspace->isReportAllowed(reportID) || !archive.has_report(reportID))
         throw std::runtime_error("Error: Cannot access report.");
     //  executionWindow.update_stats();
       DEB("Accessing report " + std::to_string(reportID) + "\n");
-      return archive.borrow_report(reportID)->getMonitoringOSLC();
+      scheduler.show_position(reportID);
+      return archive.borrow_report(reportID)->getMonitoringOSLC(workspace->getDiskUsage());
 }
 
-void VerificationService::killTask(const Workspace::WorkspaceID& workspaceID, const Archive::ReportID& reportID) {
+void VerificationService::killTask(Workspace::WorkspaceID workspaceID, const Archive::ReportID& reportID) {
   Workspace::SharedWorkspace workspace = workspaceManager.get(workspaceID);
   // for example server was restarted and client still remembers the id and wants to kill it
   if (!workspace->isReportAllowed(reportID) || !archive.has_report(reportID))
     throw std::runtime_error("Error: The report id that should be killed cannot be accessed: " + std::to_string(reportID));
+  {
+    std::lock_guard<decltype(stepsMutex)> lockGuard(stepsMutex);
+    auto it = std::find_if(pendingSteps.begin(), pendingSteps.end(),
+                           [reportID] (const PendingStep& step) { return step.reportID == reportID; });
+    if (it != pendingSteps.end()) {
+      DEB("Removing the waiting step of report " << reportID);
+      pendingSteps.erase(it);
+      auto report = archive.borrow_report(reportID);
+      report->running = false;
+      report->runningResult = "Killed before it was started.";
+      return;
+    }
+  }
+  Portfolio::SharedGroup group;
+  {
+    std::lock_guard<decltype(portfoliosMutex)> lockGuard(portfoliosMutex);
+    auto it = portfolios.find(reportID);
+    if (it != portfolios.end())
+      group = it->second;
+  }
+  if (group) { // Kill all tools of the portfolio
+    for (Archive::ReportID member : group->get_members()) {
+      if (scheduler.cancel(member))
+        continue;
+      std::pair<bool, Nat> process;
+      {
+        auto report = archive.borrow_report(member);
+        process = {report->running, report->pid};
+      }
+      if (process.first)
+        executionWindow.kill_process(process.second);
+    }
+    return;
+  }
+  if (scheduler.cancel(reportID)) {
+    DEB("Removing report " << reportID << " from the queue");
+    archive.borrow_report(reportID)->runningResult = "Killed before it was started.";
+    return;
+  }
   Nat pid = archive.borrow_report(reportID)->pid;
   DEB("Killing process number \"" + std::to_string(pid) + "\"");
   executionWindow.kill_process(pid); // TODO: report.pid should be cleared to a SAFE value when the report finished running for WHATEVER reason
@@ -174,12 +652,12 @@ void VerificationService::killTask(const Workspace::WorkspaceID& workspaceID, co
 
 std::string VerificationService::getAvailabilityString() const {
   std::string result;
-  for (const std::string& category : toolKit.get_capabilities()) {
-    result += category + " " + toolKit.category_available(category) + "\n";
-    for (const String& tool : toolKit.get_tools(category)) {
-      result += " - " + tool + " " + (toolKit.get(tool).value().is_free() ? "yes" : "busy") + "\n";
-    }
+  for (const ToolKit::ToolKit::Availability& category : toolKit.get_availability()) {
+    result += category.category + " " + (category.free > 0 ? "yes" : "busy") + "\n";
+    for (const auto& tool : category.tools)
+      result += " - " + tool.first + " " + (tool.second ? "yes" : "busy") + "\n";
   }
+  result += "disk " + Workspace::DiskAccount::instance().to_string() + "\n";
   return result;
 }
 
@@ -19,14 +19,21 @@
 #include <atomic>
 #include <chrono>
 #include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 
 #include "Archive.h"
 #include "bbb.h"
 #include "ExecutionEngine.h"
+#include "Portfolio.h"
 #include "ToolKit.h"
 #include "RequestResponse.h"
+#include "Scheduler.h"
+#include "Timers.h"
 #include "Workspace.h"
 
 using namespace std::chrono_literals;
@@ -34,27 +41,34 @@ using namespace Basics;
 
 class VerificationService {
 public:
-  ExecutionEngine::ExecutionWindow executionWindow;
   Archive::Archive archive;
   ToolKit::ToolKit toolKit;
   Workspace::WorkspaceManager workspaceManager;
+  ExecutionEngine::ExecutionWindow executionWindow; // Runs hold reservations of tools, so they have to go before the toolKit
+  Scheduler::JobScheduler scheduler;
 
   Dur tick; ///time between collecting resource cons. statistics
   //Duration lifeSpan; //time for which stats are kept
-  std::atomic<bool> doObserve;
   uint previousNumberOfTasks;
-  std::thread observer;
+  Timers::TaskID observer; // observe() on the process-wide TimerService
+  Timers::TaskID dispatcher; // dispatch() on TimerService::background()
 
   VerificationService();
   VerificationService(ToolKit::ToolKit&& toolkit);
   ~VerificationService();
 
-  void observe();
+  /**
+   * One tick of monitoring: updates the statistics of the running tasks, and has the dispatcher start queued ones and waiting steps.
+   * Runs on the process-wide TimerService, so it does nothing that blocks for long.
+   * @return false if there is nothing to monitor; the observer parks until the dispatcher launches a run
+   */
+  bool observe();
 
   /**
    * Creates a new workspace on the server.
    * Throws std::runtime_error on failure.
-   * @param toolName The tool to reserve for the workspace.
+   * @param toolName The tool to be used in the workspace. The tool is not reserved, verifications wait in a queue until it is free.
+   *                 May also be a category, then the verifications race all tools of the category (portfolio).
    * @return First: ID of the workspace.<br/> Second: web URL root-relative path to the workspace
    */
   std::pair<Workspace::WorkspaceID, std::string> createWorkspace(const std::string& toolName);
@@ -63,24 +77,32 @@ public:
    * Destroys the specified workspace
    * @param workspaceID
    */
-  void destroyWorkspace(const Workspace::WorkspaceID& workspaceID);
+  void destroyWorkspace(Workspace::WorkspaceID workspaceID);
   
   /**
    * Adds a file to the archive and makes it available from given workspace.
-   * Throws std::runtime_error if workspace does not exist or if filePath points outside workspace
+   * Throws std::runtime_error if workspace does not exist or if filePath points outside workspace,
+   * Workspace::QuotaExceededError if the file would take the workspace over its disk quota
    * @param workspaceID
    * @param fileName Name of the file, including workspace-relative path (e.g. "easy/easy.c")
    * @param fileContent Content of the file to store
    * @return First: true if a new entry was created in the archive, false if an identical file was already stored in the archive.<br/>
    * Second: ID of the file in the archive
    */
-  std::pair<bool, Archive::FileID> addFile(const Workspace::WorkspaceID& workspaceID, const std::string& fileName, const std::string& fileContent);
+  std::pair<bool, Archive::FileID> addFile(Workspace::WorkspaceID workspaceID, const std::string& fileName, const std::string& fileContent);
   
   /**
-   * Starts verification based on the request. If there already is a <it>valid</it> report for the same verification request, no verification is started.
-   * Throws std::runtime_error if launching of the verification fails.
+   * Queues verification based on the request. If there already is a <it>valid</it> report for the same verification request, no verification is started.
+   * If the same verification is already queued or running, it is not started again.
+   * If the plan names a category instead of a tool, all usable tools of the category are raced on the task (see Portfolio::Group);
+   * every tool gets its own report and the requested report takes the first definitive verdict.
+   * The verification is launched as soon as the scheduler finds resources for it; until then the report shows its queue position.
+   * An input "@<reportID>:<k>" is the k-th output (see Archive::Report::outputNames) of an earlier report of the workspace,
+   * which makes the verification a step of a plan: it waits until the report it depends on finished and runs on its output
+   * (see Portfolio::Step). Steps that do not depend on each other run in parallel.
+   * Throws std::runtime_error if the request is invalid.
    * @param verificationRequest
-   * @return first: true if a new verification report was created and verification started. False if there already was a report for the verification request. <br/>
+   * @return first: true if the verification was queued or is in progress. False if there already was a valid report for the verification request. <br/>
    *         second: ID of the report for the request, be it a freshly created report or an existing one. Guaranteed to reference a report in the service's Archive.
    */
   std::pair<bool, Archive::ReportID> verify(const RequestResponse::Request& verificationRequest);
@@ -91,21 +113,105 @@ public:
    * @param reportID ID of the report to access
    * @return 
    */
-  std::string getMonitoringOSLC(const Workspace::WorkspaceID& workspaceID, const Archive::ReportID& reportID);
+  std::string getMonitoringOSLC(Workspace::WorkspaceID workspaceID, const Archive::ReportID& reportID);
   
   /**
-   * Kills a given report's running task. Throws std::runtime_error on error.
+   * Kills a given report's running task or removes it from the queue. Throws std::runtime_error on error.
    * @param workspaceID
    * @param reportID
    */
-  void killTask(const Workspace::WorkspaceID& workspaceID, const Archive::ReportID& reportID);
+  void killTask(Workspace::WorkspaceID workspaceID, const Archive::ReportID& reportID);
   
   /**
-   * Returns string with information on which categories of verification are supported by the server and which tools are available
+   * Returns string with information on which categories of verification are supported by the server and which tools are available,
+   * and the disk usage of the workspaces
    * @return 
    */
   std::string getAvailabilityString() const;
 private:
   static String getLocalAddress();
+
+  /**
+   * @return Names of the workspace directories of the runs the supervisor holds, kept by every service's workspace manager
+   */
+  static std::set<std::string> heldWorkspaceDirectories();
+
+  /**
+   * Takes over the runs the supervisor held when the server started (see Zygote::held()): restores their reports
+   * and their workspaces, and monitors them as if this server had started them. Done by the first service only.
+   */
+  void adoptHeldRuns();
+
+  /**
+   * Creates the member reports of a portfolio verification and queues them.
+   * Throws std::runtime_error if there is no usable tool in the category.
+   */
+  void startPortfolio(Archive::ReportID parentID, const String& category, Workspace::SharedWorkspace& workspace,
+                      const RequestResponse::Request& verificationRequest, const std::vector<Archive::FileID>& inputFileIDs,
+                      const String& schema, const String& automationPlan);
+
+  /**
+   * Creates the member reports of a parameter sweep, one per point, and queues them in the order of the points.
+   */
+  void startSweep(Archive::ReportID parentID, const ToolKit::SharedTool& tool, Workspace::SharedWorkspace& workspace,
+                  const RequestResponse::Request& verificationRequest, const std::vector<Archive::FileID>& inputFileIDs,
+                  const String& schema, const String& automationPlan, std::vector<Strings>&& points, Strings&& labels);
+
+  /**
+   * Checks in the report of a step with inputs from earlier reports and makes it wait for them.
+   */
+  std::pair<bool, Archive::ReportID> startStep(const ToolKit::SharedTool& tool, Workspace::SharedWorkspace& workspace,
+                                               const RequestResponse::Request& verificationRequest, const String& schema,
+                                               const String& automationPlan);
+
+  /**
+   * Starts the waiting steps whose inputs are known, fails the ones whose inputs will never be.
+   */
+  void resolvePendingSteps();
+
+  std::mutex portfoliosMutex;
+  std::map<Archive::ReportID, Portfolio::SharedGroup> portfolios; // Undecided portfolios, sweeps and steps by their report
+
+  /// An input of a step: a file of the workspace, or an output of an earlier report
+  struct StepInput {
+    bool dependency;
+    Archive::FileID file;     // The file, or the output once it is known
+    Archive::ReportID report; // The report the output is taken from
+    Nat output;               // Index of the output in the report's outputNames
+  };
+
+  /// A step waiting for the reports it depends on
+  struct PendingStep {
+    Archive::ReportID reportID;
+    ToolKit::SharedTool tool;
+    Workspace::SharedWorkspace workspace;
+    Strings parameters;
+    std::vector<StepInput> inputs;
+    String schema;
+    String automationPlan;
+    String tenant;
+    int priority;
+    Dur timeLimit;
+  };
+
+  std::mutex stepsMutex;
+  std::list<PendingStep> pendingSteps;
+
+  /**
+   * One round of the dispatcher: resolves the waiting steps and dispatches the queued verifications.
+   * Launches create run directories and send files to worker agents, so it runs on TimerService::background()
+   * rather than with observe().
+   */
+  void dispatch();
+
+  /// Has the dispatcher run once more
+  void requestDispatch();
+
+  /**
+   * Launches all queued verifications for which there are free resources, and wakes the observer.
+   * A verification that fails to launch gets the error written into its report. Only for the dispatcher.
+   */
+  void dispatchQueued();
+
 };
 
@@ -210,7 +210,7 @@ namespace VerifyService {
     if (request.workspace_cmd == "new") {
       try {
         auto answer = verificationService->createWorkspace(request.workspace_tool);
-        result = "Workspace successfully created.\n   id:" + answer.first + "\n   path:\"" + answer.second + "\"";
+        result = "Workspace successfully created.\n   id:" + Workspace::format_id(answer.first) + "\n   path:\"" + answer.second + "\"";
         // TODO: path should be relative to web root (check)
       }
       catch (const std::exception& err) {
@@ -221,7 +221,7 @@ namespace VerifyService {
     }
     else if (request.workspace_cmd == "destroy") {      
       verificationService->destroyWorkspace(request.workspaceID);
-      result = "Workspace " + request.workspaceID + " destroyed.";
+      result = "Workspace " + Workspace::format_id(request.workspaceID) + " destroyed.";
     }
   }  
 
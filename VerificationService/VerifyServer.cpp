@@ -22,10 +22,14 @@
 #include <proxygen/httpserver/RequestHandlerFactory.h>
 #include <unistd.h>
 
+#include "Affinity.h"
+#include "Remote.h"
+#include "RunHistory.h"
 #include "ToolKit.h"
 #include "ToolKitXMLFactory.h"
 #include "VerifyRequestHandler.h"
 #include "VerificationService.h"
+#include "Zygote.h"
 
 using namespace VerifyService;
 using namespace proxygen;
@@ -43,12 +47,33 @@ DEFINE_string(ip, "0.0.0.0", "IP/Hostname to bind to");
 DEFINE_int32(threads, 1, "Number of threads to listen on. Numbers <= 0 "
              "will use the number of cores on this machine.");
 DEFINE_string(toolkit_file, "toolkit.xml", "Configuration file with available verification tools");
+DEFINE_int32(reserved_cores, 1, "Number of CPU cores kept for the server's own threads. "
+             "Verification runs are pinned to the remaining cores.");
+DEFINE_bool(zygote, false, "Start verification processes from a small helper process forked at server start, "
+            "so that launch latency does not grow with the server's memory footprint.");
+DEFINE_string(supervisor, "", "Unix socket of the run supervisor. Verification processes are started by a supervisor that "
+              "outlives the server, a restarted server takes over the runs still in progress. Implies --zygote.");
+DEFINE_int32(worker_port, 0, "Port to accept worker agents (VerifyWorker) on. Verifications that do not fit into "
+             "this node run on the agents. 0 runs everything on this node.");
+DEFINE_string(worker_bind, "127.0.0.1", "Address to accept worker agents on, \"::\" for all addresses. "
+              "Agents on other hosts need it to be an address they reach this node at.");
+DEFINE_string(worker_secret_file, "worker.secret", "File with the secret worker agents introduce themselves with, "
+              "on its first line. Agents are given the same file.");
+DEFINE_int64(workspace_quota_mb, 0, "Disk space one workspace may take with its files and the outputs of its runs. "
+             "Uploads over the quota are refused, runs of a workspace over the quota are stopped. 0 for no quota.");
+DEFINE_int64(disk_quota_mb, 0, "Disk space all workspaces together may take. Uploads over the quota are refused, "
+             "runs still writing when it is exceeded are stopped. 0 for no quota.");
+DEFINE_string(run_history_file, "runHistory", "File the run times and peak memory of finished runs are kept in. "
+              "Queued verifications are ordered by what similar runs took. Empty to forget them on exit.");
+DEFINE_double(predicted_time_limit_factor, 0, "Verifications without a time limit are stopped after this many times "
+              "the run time similar runs took, but no sooner than after 10 minutes. 0 for no such limit.");
 
 class VerifyRequestHandlerFactory : public RequestHandlerFactory {
  public:
   void onServerStart(folly::EventBase* evb) noexcept override {
     ToolKit::ToolKit toolkit = ToolKit::ToolKitXMLFactory::create(FLAGS_toolkit_file);
     verificationService.reset(new VerificationService(std::move(toolkit)));
+    verificationService->scheduler.defaultTimeLimitFactor = std::max(0.0, FLAGS_predicted_time_limit_factor);
   }
 
   void onServerStop() noexcept override {
@@ -79,6 +104,19 @@ int main(int argc, char* argv[]) {
     CHECK(FLAGS_threads > 0);
   }
 
+  // Before any thread is started, so that all server threads inherit the binding:
+  Affinity::CoreAllocator::instance().reserve_for_server(std::max(0, FLAGS_reserved_cores));
+  RunHistory::RunHistory::instance().load(FLAGS_run_history_file);
+  Workspace::DiskAccount::instance().setQuotas(std::max<int64_t>(0, FLAGS_workspace_quota_mb) << 20,
+                                               std::max<int64_t>(0, FLAGS_disk_quota_mb) << 20);
+  if (!FLAGS_supervisor.empty())
+    Zygote::Zygote::start(FLAGS_supervisor); // Connects to the supervisor of an earlier server, or forks one
+  else if (FLAGS_zygote)
+    Zygote::Zygote::start(); // Forked while the server is still small; inherits the binding above
+  if (FLAGS_worker_port > 0)
+    Remote::WorkerPool::instance().listen(FLAGS_worker_bind, FLAGS_worker_port,
+                                          Remote::read_secret(FLAGS_worker_secret_file));
+
   HTTPServerOptions options;
   options.threads = static_cast<size_t>(FLAGS_threads);
   options.idleTimeout = std::chrono::milliseconds(60000);
@@ -0,0 +1,330 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   VerifyWorker.cpp
+ *
+ * Worker agent: connects to a VerifyServer started with --worker_port, advertises the tools of its toolkit file
+ * and its capacity, and runs the verifications the server assigns to it (see Remote.h for the protocol).
+ * Several agents may run on one host, e.g. for testing on localhost, each with its own scratch directory.
+ *
+ * Usage: VerifyWorker <server> [port] [toolkit file] [cores] [memory MB] [scratch directory]
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "bbb.h"
+#include "Launcher.h"
+#include "Monitor.h"
+#include "Remote.h"
+#include "ToolKit.h"
+#include "ToolKitXMLFactory.h"
+
+using namespace Basics;
+namespace filesystem = std::experimental::filesystem;
+
+namespace {
+
+/// A verification assigned to this agent
+struct AgentRun {
+  String directory;
+  std::set<String> inputs; // Run-relative paths of the files the server sent, not sent back
+  Launcher::Process process;
+  std::unique_ptr<Monitor::ProcessReader> reader;
+  std::streamoff outOffset = 0, errOffset = 0;
+  struct timespec partResultTime{0, 0};
+  off_t partResultSize = -1;
+};
+
+class Agent {
+public:
+  Agent(int fd, ToolKit::ToolKit& toolKit, const String& scratch, const String& secret, Nat cores, Nat memory);
+
+  /**
+   * Serves the server until the connection ends, then kills the runs that did not end
+   */
+  void serve();
+
+private:
+  void send(const String& type, const String& payload);
+  AgentRun& get_run(Nat id);
+  void receive_file(Nat id, const String& rest);
+  void start(Nat id, const String& rest);
+  void signal(Nat id, const String& rest);
+  void monitor();
+  /// @return false once the process ended and the run was reported
+  bool update(Nat id, AgentRun& run, const Monitor::HostSample& host);
+  void send_new_output(Nat id, const String& type, const String& fileName, std::streamoff& offset);
+  void send_file(Nat id, const String& directory, const String& path);
+  void end(Nat id, AgentRun& run, int status);
+
+  const int fd;
+  ToolKit::ToolKit& toolKit;
+  const String scratch;
+  std::mutex sendMutex;
+  std::mutex mutex;
+  std::map<Nat, AgentRun> runs;
+  std::atomic<bool> connected;
+  Monitor::HostSampler hostSampler;
+};
+
+Agent::Agent(int fd, ToolKit::ToolKit& toolKit, const String& scratch, const String& secret, Nat cores, Nat memory) :
+    fd(fd), toolKit(toolKit), scratch(scratch), connected(true) {
+  String hello = secret + "\n" + std::to_string(cores) + " " + std::to_string(memory) + "\n";
+  for (const String& category : toolKit.get_capabilities())
+    for (const String& tool : toolKit.get_tools(category))
+      hello += tool + "\n";
+  send("HELLO", hello);
+}
+
+void Agent::send(const String& type, const String& payload) {
+  std::lock_guard<decltype(sendMutex)> lockGuard(sendMutex);
+  Remote::write_message(fd, type, payload);
+}
+
+/// A run the agent hears of first gets a fresh directory
+AgentRun& Agent::get_run(Nat id) {
+  auto it = runs.find(id);
+  if (it != runs.end())
+    return it->second;
+  AgentRun& run = runs[id];
+  run.directory = scratch + "/" + std::to_string(id);
+  filesystem::remove_all(run.directory);
+  filesystem::create_directories(run.directory);
+  return run;
+}
+
+void Agent::receive_file(Nat id, const String& rest) {
+  size_t newline = rest.find('\n');
+  String path = rest.substr(0, newline);
+  if (newline == String::npos || !Remote::is_safe_path(path))
+    throw Remote::RemoteError("Malformed file of run " + std::to_string(id));
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  AgentRun& run = get_run(id);
+  filesystem::path target = filesystem::path(run.directory)/path;
+  filesystem::create_directories(target.parent_path());
+  std::ofstream file(target.string(), std::ios::binary | std::ios::trunc);
+  file.write(rest.data() + newline + 1, rest.size() - newline - 1);
+  run.inputs.insert(path);
+}
+
+/// The tool's path on this host replaces the server's, the arguments refer to files of the run's directory
+void Agent::start(Nat id, const String& rest) {
+  size_t newline = rest.find('\n');
+  String toolName = rest.substr(0, newline);
+  String arguments = (newline == String::npos ? String() : rest.substr(newline + 1));
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  AgentRun& run = get_run(id);
+  try {
+    auto tool = toolKit.get(toolName);
+    if (!tool)
+      throw Launcher::LaunchError("No tool " + toolName + " on this agent");
+    Launcher::Request request;
+    request.command = tool->get_path() + (arguments.empty() ? "" : " " + arguments);
+    request.workingDirectory = run.directory;
+    request.outFileName = run.directory + "/out";
+    request.errFileName = run.directory + "/err";
+    run.process = Launcher::spawn(request);
+    run.reader.reset(new Monitor::ProcessReader(run.process.pid()));
+    DEB("Run " << id << ": started \"" << request.command << "\", PID " << run.process.pid());
+  }
+  catch (const Launcher::LaunchError& e) {
+    DEB("Run " << id << ": " << e.what());
+    send("ERR", std::to_string(id) + "\n" + e.what() + "\n");
+    end(id, run, 127 << 8); // Wait status of exit code 127, as of a command that was not found
+    runs.erase(id);
+  }
+}
+
+void Agent::signal(Nat id, const String& rest) {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  auto it = runs.find(id);
+  if (it != runs.end() && it->second.reader)
+    it->second.process.kill(std::atoi(rest.c_str()));
+}
+
+void Agent::serve() {
+  std::thread monitorThread(&Agent::monitor, this);
+  try {
+    String type, payload, rest;
+    while (Remote::read_message(fd, type, payload)) {
+      Nat id = Remote::split_id(payload, rest);
+      if (type == "FILE")
+        receive_file(id, rest);
+      else if (type == "ASSIGN")
+        start(id, rest);
+      else if (type == "SIGNAL")
+        signal(id, rest);
+      else
+        DEB("Unknown message " << type);
+    }
+  }
+  catch (const std::exception& e) {
+    DEB("Connection to the server failed: " << e.what());
+  }
+  connected = false;
+  monitorThread.join();
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  for (auto& entry : runs) {
+    if (entry.second.reader) {
+      entry.second.process.kill(SIGKILL);
+      int status;
+      waitpid(entry.second.process.pid(), &status, 0);
+    }
+    filesystem::remove_all(entry.second.directory);
+  }
+  runs.clear();
+}
+
+/// Once per second, like the server's monitoring of its own runs
+void Agent::monitor() {
+  while (connected) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const Monitor::HostSample& host = hostSampler.sample();
+    try {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      for (auto it = runs.begin(); it != runs.end(); )
+        it = (!it->second.reader || update(it->first, it->second, host) ? std::next(it) : runs.erase(it));
+    }
+    catch (const Remote::RemoteError& e) {
+      DEB("Connection to the server failed: " << e.what());
+      shutdown(fd, SHUT_RDWR); // serve() ends
+      return;
+    }
+  }
+}
+
+bool Agent::update(Nat id, AgentRun& run, const Monitor::HostSample& host) {
+  Monitor::ProcessSample sample;
+  if (run.reader->sample(sample))
+    send("STATS", std::to_string(id) + "\n" + sample.state + " " + std::to_string(sample.utime) + " " + std::to_string(sample.stime)
+                  + " " + std::to_string(sample.vsize) + " " + std::to_string(sample.rss) + " " + std::to_string(host.totalTime)
+                  + " " + std::to_string(host.previousTotalTime) + " " + std::to_string(host.memFreeMB)
+                  + " " + std::to_string(host.memFreePercent));
+  send_new_output(id, "OUT", run.directory + "/out", run.outOffset);
+  send_new_output(id, "ERR", run.directory + "/err", run.errOffset);
+  struct stat info;
+  String partResult = run.directory + "/partVerResult.txt";
+  if (stat(partResult.c_str(), &info) == 0 && (info.st_size != run.partResultSize || info.st_mtim.tv_sec != run.partResultTime.tv_sec
+                                               || info.st_mtim.tv_nsec != run.partResultTime.tv_nsec)) {
+    run.partResultTime = info.st_mtim;
+    run.partResultSize = info.st_size;
+    send_file(id, run.directory, "partVerResult.txt");
+  }
+  int status;
+  pid_t result = waitpid(run.process.pid(), &status, WNOHANG);
+  if (result == 0)
+    return true;
+  if (result < 0)
+    status = 0; // Collected elsewhere, the status is lost
+  send_new_output(id, "OUT", run.directory + "/out", run.outOffset);
+  send_new_output(id, "ERR", run.directory + "/err", run.errOffset);
+  end(id, run, status);
+  return false;
+}
+
+void Agent::send_new_output(Nat id, const String& type, const String& fileName, std::streamoff& offset) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file.is_open())
+    return;
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size <= offset)
+    return;
+  String chunk(size - offset, '\0');
+  file.seekg(offset);
+  file.read(&chunk[0], chunk.size());
+  chunk.resize(file.gcount());
+  offset += chunk.size();
+  send(type, std::to_string(id) + "\n" + chunk);
+}
+
+void Agent::send_file(Nat id, const String& directory, const String& path) {
+  String content;
+  if (bbb::read_file(directory + "/" + path, content))
+    send("FILE", std::to_string(id) + "\n" + path + "\n" + content);
+}
+
+/// Every file the run created is sent back: the server picks the declared outputs among them
+void Agent::end(Nat id, AgentRun& run, int status) {
+  const filesystem::path directory(run.directory);
+  for (auto it = filesystem::recursive_directory_iterator(directory); it != filesystem::recursive_directory_iterator(); ++it) {
+    if (!filesystem::is_regular_file(it->status()))
+      continue;
+    String path = it->path().string().substr(directory.string().size() + 1);
+    if (path != "out" && path != "err" && !run.inputs.count(path))
+      send_file(id, run.directory, path);
+  }
+  send("EXIT", std::to_string(id) + "\n" + std::to_string(status));
+  DEB("Run " << id << " ended with status " << status);
+  std::error_code error;
+  filesystem::remove_all(directory, error);
+}
+
+Nat detect_memory() {
+  struct sysinfo info;
+  if (sysinfo(&info) != 0)
+    return 0;
+  return static_cast<unsigned long long>(info.totalram) * info.mem_unit / 100 * 90 >> 20;
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <server> [port] [toolkit file] [cores] [memory MB] [scratch directory] [secret file]\n";
+    return 1;
+  }
+  String server = argv[1];
+  int port = (argc > 2 ? std::atoi(argv[2]) : Remote::defaultPort);
+  String toolkitFile = (argc > 3 ? argv[3] : "toolkit.xml");
+  Nat cores = (argc > 4 ? std::strtoul(argv[4], nullptr, 10) : std::thread::hardware_concurrency());
+  Nat memory = (argc > 5 ? std::strtoul(argv[5], nullptr, 10) : detect_memory());
+  String scratch = (argc > 6 ? argv[6] : "./worker-runs-" + std::to_string(getpid()));
+  String secret;
+  try {
+    secret = Remote::read_secret(argc > 7 ? argv[7] : "worker.secret");
+  }
+  catch (const Remote::RemoteError& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  ToolKit::ToolKit toolKit = ToolKit::ToolKitXMLFactory::create(toolkitFile);
+  filesystem::create_directories(scratch);
+  scratch = filesystem::canonical(scratch).string();
+  for (;;) { // Reconnects, e.g. after a restart of the server
+    try {
+      Launcher::FileDescriptor connection(Remote::connect_to(server, port));
+      std::cerr << "Connected to " << server << ":" << port << " with " << cores << " cores and " << memory << " MB\n";
+      Agent agent(connection.fd, toolKit, scratch, secret, cores, memory);
+      agent.serve();
+      std::cerr << "Disconnected from " << server << ":" << port << "\n";
+    }
+    catch (const Remote::RemoteError& e) {
+      std::cerr << e.what() << "\n";
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+  }
+}
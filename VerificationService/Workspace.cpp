@@ -24,26 +24,182 @@
 #include "Workspace.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <random>
 #include <mutex>
 #include <set>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "bbb.h" // logging only please
 
 namespace Workspace {
 
-  Workspace::Workspace(const filesystem::path& webPath, const filesystem::path& canonicalPath, ToolKit::ToolReservation&& reservation) : 
+  namespace {
+    // See ioprio_set(2), glibc has no wrapper:
+    const int ioprioWhoProcess = 1;
+    const int ioprioClassIdle = 3;
+    const int ioprioClassShift = 13;
+  }
+
+  std::string format_id(WorkspaceID id) {
+    return std::to_string(id);
+  }
+
+  WorkspaceID parse_id(const std::string& text) {
+    if (text.empty() || text.size() > std::numeric_limits<WorkspaceID>::digits10 + 1 ||
+        !std::all_of(text.begin(), text.end(), [] (char c) { return c >= '0' && c <= '9'; }))
+      return invalidID;
+    errno = 0;
+    unsigned long long id = std::strtoull(text.c_str(), nullptr, 10);
+    return (errno == ERANGE ? invalidID : id);
+  }
+
+  DiskAccount& DiskAccount::instance() {
+    static DiskAccount account;
+    return account;
+  }
+
+  void DiskAccount::setQuotas(uint64_t workspaceQuota, uint64_t totalQuota) {
+    this->workspaceQuota = workspaceQuota;
+    this->totalQuota = totalQuota;
+  }
+
+  bool DiskAccount::exceeds(uint64_t workspaceUsage, uint64_t bytes) const {
+    return (workspaceQuota > 0 && workspaceUsage + bytes > workspaceQuota) || (totalQuota > 0 && usage + bytes > totalQuota);
+  }
+
+  std::string DiskAccount::to_string() const {
+    std::string result = std::to_string(getUsage() >> 20) + " MB used";
+    if (totalQuota > 0)
+      result += " of " + std::to_string(totalQuota >> 20) + " MB";
+    if (workspaceQuota > 0)
+      result += ", " + std::to_string(workspaceQuota >> 20) + " MB per workspace";
+    return result;
+  }
+
+  Reclaimer& Reclaimer::instance() {
+    static Reclaimer reclaimer;
+    return reclaimer;
+  }
+
+  Reclaimer::Reclaimer() : discarded(0), stopping(false), thread(&Reclaimer::serve, this) { }
+
+  Reclaimer::~Reclaimer() {
+    {
+      std::lock_guard<decltype(mutex)> lockGuard(mutex);
+      stopping = true; // The thread deletes what is pending, then returns
+    }
+    wakeUp.notify_all();
+    thread.join();
+  }
+
+  void Reclaimer::discard(const filesystem::path& directory, const filesystem::path& trash) {
+    std::error_code error;
+    filesystem::create_directories(trash, error);
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    filesystem::path target = trash/(directory.filename().string() + "." + std::to_string(getpid()) + "."
+                                     + std::to_string(++discarded));
+    filesystem::rename(directory, target, error);
+    if (!error) {
+      pending.push_back(target);
+      wakeUp.notify_one();
+      return;
+    }
+    if (!filesystem::exists(directory))
+      return;
+    DEB("Cannot move " << directory << " to the trash (" << error.message() << "), deleting it in place");
+    // Moved aside within its parent, which frees its place at once, and linked from the trash, so that the next
+    // server deletes it if this one does not get to it (see sweep()):
+    filesystem::path aside = directory.parent_path()/("." + target.filename().string());
+    filesystem::rename(directory, aside, error);
+    if (error) {
+      DEB("Cannot move " << directory << " aside (" << error.message() << "), deleting it now");
+      filesystem::remove_all(directory, error);
+      return;
+    }
+    pending.push_back(aside);
+    filesystem::create_symlink(filesystem::absolute(aside), target, error);
+    if (error) {
+      DEB("Cannot link " << aside << " from the trash (" << error.message() << "), a server ending before it is deleted leaves it");
+    }
+    else {
+      pending.push_back(target); // Deleted after the directory it links
+    }
+    wakeUp.notify_one();
+  }
+
+  void Reclaimer::sweep(const filesystem::path& trash) {
+    std::error_code error;
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    for (const filesystem::path& item : filesystem::directory_iterator(trash, error)) {
+      if (filesystem::is_symlink(item)) {
+        std::error_code linkError;
+        filesystem::path aside = filesystem::read_symlink(item, linkError); // See discard()
+        if (!linkError && aside.filename() == "." + item.filename().string())
+          pending.push_back(aside);
+      }
+      pending.push_back(item);
+    }
+    wakeUp.notify_one();
+  }
+
+  void Reclaimer::serve() {
+    prctl(PR_SET_NAME, "VerifyReclaimer");
+    pid_t thread = syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, thread, 19); // Per thread on Linux
+    if (syscall(SYS_ioprio_set, ioprioWhoProcess, thread, ioprioClassIdle << ioprioClassShift) != 0) {
+      DEB("Cannot lower the IO priority of the reclaimer: " << strerror(errno));
+    }
+    std::unique_lock<decltype(mutex)> lock(mutex);
+    for (;;) {
+      wakeUp.wait(lock, [this] () { return stopping || !pending.empty(); });
+      if (pending.empty())
+        return;
+      filesystem::path directory = std::move(pending.front());
+      pending.pop_front();
+      lock.unlock();
+      std::error_code error;
+      auto start = std::chrono::steady_clock::now();
+      auto removed = filesystem::remove_all(directory, error);
+      if (error) {
+        DEB("Cannot delete " << directory << ": " << error.message());
+      }
+      else {
+        DEB("Deleted " << directory << " (" << removed << " files) in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms");
+      }
+      lock.lock();
+    }
+  }
+
+  Workspace::Workspace(const filesystem::path& webPath, const filesystem::path& canonicalPath, const std::string& toolName) : 
           webPath(webPath),
           canonicalPath(canonicalPath),
-          toolReservation(std::move(reservation))
+          toolName(toolName),
+          diskUsage(0),
+          retained(false)
   {
     filesystem::create_directory(canonicalPath);
   }
 
   Workspace::~Workspace() {
     std::lock_guard<decltype(mutex)> lockGuard(mutex);
-    filesystem::remove_all(canonicalPath);
+    if (!retained)
+      Reclaimer::instance().discard(canonicalPath, canonicalPath.parent_path()/trashDirectory);
+    DiskAccount::instance().charge(-static_cast<int64_t>(diskUsage));
+  }
+
+  void Workspace::retainDirectory() {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    retained = true;
   }
   
   void Workspace::addReport(Archive::ReportID id) {
@@ -56,8 +212,29 @@ namespace Workspace {
     if (!isRelativePathWithinWorkspace(workspaceRelativePath))
       throw std::runtime_error("Attempted escape from workspace.");
     // TODO: will the path get created if it does not exist?
-    filesystem::copy_file(archive.get_file_path(fileID), canonicalPath/workspaceRelativePath, filesystem::copy_options::overwrite_existing); // TODO: create symlinks to save space?
+    // Copied aside and renamed, so that run directories linking the previous version keep it:
+    filesystem::path target = canonicalPath/workspaceRelativePath;
+    filesystem::path copy = target.string() + ".checkin";
+    filesystem::remove(copy); // Left read-only by a crash, it could not be overwritten
+    filesystem::copy_file(archive.get_file_path(fileID), copy); // TODO: create symlinks to save space?
+    // Run directories share the file's inode (see createRunDirectory()), a run writing into it fails rather than
+    // changing the input of the other runs:
+    filesystem::permissions(copy, filesystem::perms::remove_perms | filesystem::perms::owner_write
+                                  | filesystem::perms::group_write | filesystem::perms::others_write);
+    filesystem::rename(copy, target);
     files[fileID] = workspaceRelativePath;
+    uint64_t& charged = fileSizes[workspaceRelativePath]; // A file checked in under the same path replaced the previous one
+    uint64_t size = filesystem::file_size(target);
+    DiskAccount::instance().charge(static_cast<int64_t>(size) - static_cast<int64_t>(charged));
+    diskUsage += size - charged;
+    charged = size;
+  }
+
+  void Workspace::admitUpload(uint64_t bytes) const {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (DiskAccount::instance().exceeds(diskUsage, bytes))
+      throw QuotaExceededError("Disk quota exceeded, " + DiskAccount::instance().to_string()
+                               + ", the workspace takes " + std::to_string(diskUsage >> 20) + " MB.");
   }
 
   std::string Workspace::getWorkspaceRelativeFilePath(Archive::FileID id) const {
@@ -69,6 +246,59 @@ namespace Workspace {
     return canonicalPath.string() + "/" + getWorkspaceRelativeFilePath(id);
   }
 
+  std::string Workspace::createRunDirectory(Archive::ReportID id) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    filesystem::path directory = canonicalPath/runsDirectory/std::to_string(id);
+    if (filesystem::exists(directory))
+      Reclaimer::instance().discard(directory, canonicalPath.parent_path()/trashDirectory);
+    auto previous = runDiskUsage.find(id);
+    if (previous != runDiskUsage.end()) {
+      DiskAccount::instance().charge(-static_cast<int64_t>(previous->second));
+      diskUsage -= previous->second;
+      runDiskUsage.erase(previous);
+    }
+    filesystem::create_directories(directory);
+    for (const auto& file : files) {
+      filesystem::path link = directory/file.second;
+      filesystem::create_directories(link.parent_path());
+      std::error_code error;
+      filesystem::create_hard_link(canonicalPath/file.second, link, error);
+      if (error) // E.g. a file system without hard links
+        filesystem::copy_file(canonicalPath/file.second, link, filesystem::copy_options::overwrite_existing);
+    }
+    return directory.string();
+  }
+
+  void Workspace::setRunDiskUsage(Archive::ReportID id, uint64_t bytes) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    uint64_t& charged = runDiskUsage[id];
+    DiskAccount::instance().charge(static_cast<int64_t>(bytes) - static_cast<int64_t>(charged));
+    diskUsage += bytes - charged;
+    charged = bytes;
+  }
+
+  uint64_t Workspace::measureDirectory(const filesystem::path& directory) {
+    uint64_t result = 0;
+    std::error_code error;
+    for (filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+      struct stat info;
+      if (lstat(it->path().c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_nlink == 1)
+        result += info.st_size;
+    }
+    return result;
+  }
+
+  uint64_t Workspace::getDiskUsage() const {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    return diskUsage;
+  }
+
+  bool Workspace::isOverDiskQuota() const {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    uint64_t quota = DiskAccount::instance().getWorkspaceQuota();
+    return quota > 0 && diskUsage > quota;
+  }
+
   const std::string Workspace::getCanonicalPath() const {
     return canonicalPath;
   }
@@ -82,8 +312,8 @@ namespace Workspace {
     return webPath;
   }
 
-  const ToolKit::Tool& Workspace::getTool() const {
-    return toolReservation.getTool();
+  const std::string& Workspace::getToolName() const {
+    return toolName;
   }
 
   bool Workspace::isRelativePathWithinWorkspace(const filesystem::path& p) {
@@ -105,49 +335,66 @@ namespace Workspace {
 
   
   
-  WorkspaceManager::WorkspaceManager(const std::string& relativeWorkspaceRootPath) : 
+  WorkspaceManager::WorkspaceManager(const std::string& relativeWorkspaceRootPath, const std::set<std::string>& keep) : 
           wwwWorkspaceRootPath(relativeWorkspaceRootPath),
           canonicalWorkspaceRootPath(filesystem::absolute(relativeWorkspaceRootPath)),
-          workspacesExpirationMap(std::make_shared<WorkspacesExpirationMap>()),
+          workspacesExpirationMap(std::make_shared<WorkspacesExpirationMap>(std::chrono::seconds{1})),
           periodicExpirator(workspacesExpirationMap, std::chrono::seconds{5}, std::bind(&WorkspaceManager::onWorkspacesExpired, this, std::placeholders::_1))
   {
     if (!(is_directory(this->wwwWorkspaceRootPath) || create_directories(this->wwwWorkspaceRootPath))) {
       DEB("Unable to create workspaces dir");
       throw filesystem::filesystem_error("Unable to create workspaces dir", this->wwwWorkspaceRootPath, {});
     }
-    for (const filesystem::path& item : filesystem::directory_iterator(this->wwwWorkspaceRootPath)) {
-      if (is_directory(item) && item.filename().string().substr(0,9) == "workspace") {
-        remove_all(item); // Clean up in case application crashed
-      }
-    }
+    // Once per process, the managers of the other service threads must not discard the workspaces of the first one:
+    static std::once_flag cleanedUp;
+    std::call_once(cleanedUp, [&] () {
+        filesystem::path trash = canonicalWorkspaceRootPath/trashDirectory;
+        Reclaimer::instance().sweep(trash); // Left by an earlier server
+        for (const filesystem::path& item : filesystem::directory_iterator(this->wwwWorkspaceRootPath)) {
+          if (is_directory(item) && item.filename().string().substr(0,9) == "workspace" && keep.count(item.filename().string()) == 0) {
+            Reclaimer::instance().discard(canonicalWorkspaceRootPath/item.filename(), trash); // Clean up in case application crashed
+          }
+        }
+      });
   }
 
-  std::pair<WorkspaceID, SharedWorkspace> WorkspaceManager::create(ToolKit::ToolReservation&& toolReservation) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<size_t> dis(0, std::numeric_limits<unsigned long>::max());
+  std::pair<WorkspaceID, SharedWorkspace> WorkspaceManager::create(const std::string& toolName) {
+    static thread_local std::mt19937_64 gen(std::random_device{}()); // Every service thread has its own manager
     
     WorkspaceID id;
     do {
-      std::stringstream ss;
-      ss << dis(gen);
-      id = ss.str();
-    } while (workspacesExpirationMap->get(id)); // ensure id not used already
-    SharedWorkspace sw = std::make_shared<Workspace>(wwwWorkspaceRootPath/("workspace"+id), canonicalWorkspaceRootPath/("workspace"+id), std::move(toolReservation));
-        workspacesExpirationMap->insert(id, sw, sw->getMaxIdleTimeout());
+      id = gen();
+    } while (id == invalidID || workspacesExpirationMap->get(id)); // ensure id not used already
+    const std::string name = "workspace" + format_id(id);
+    SharedWorkspace sw = std::make_shared<Workspace>(wwwWorkspaceRootPath/name, canonicalWorkspaceRootPath/name, toolName);
+    workspacesExpirationMap->insert(id, sw, sw->getMaxIdleTimeout());
+    periodicExpirator.wake();
+    return {id, sw};
+  }
+
+  std::pair<WorkspaceID, SharedWorkspace> WorkspaceManager::adopt(const std::string& canonicalPath, const std::string& toolName) {
+    const std::string name = filesystem::path(canonicalPath).filename().string();
+    WorkspaceID id = (name.substr(0,9) == "workspace" ? parse_id(name.substr(9)) : invalidID);
+    if (id == invalidID)
+      throw WorkspaceNotFoundError("Not a workspace directory: " + canonicalPath);
+    std::experimental::optional<SharedWorkspace> existing = workspacesExpirationMap->get(id);
+    if (existing)
+      return {id, *existing};
+    SharedWorkspace sw = std::make_shared<Workspace>(wwwWorkspaceRootPath/name, canonicalWorkspaceRootPath/name, toolName);
+    workspacesExpirationMap->insert(id, sw, sw->getMaxIdleTimeout());
+    periodicExpirator.wake();
     return {id, sw};
   }
 
-  void WorkspaceManager::destroy(const WorkspaceID& id) {
+  void WorkspaceManager::destroy(WorkspaceID id) {
     workspacesExpirationMap->erase(id);
   }
 
-  std::shared_ptr<Workspace> WorkspaceManager::get(const WorkspaceID& id) {
-    std::experimental::optional<SharedWorkspace> optionalPtr = workspacesExpirationMap->get(id);
+  std::shared_ptr<Workspace> WorkspaceManager::get(WorkspaceID id) {
+    std::experimental::optional<SharedWorkspace> optionalPtr = workspacesExpirationMap->getAndKeepAlive(id);
     if (!optionalPtr) {
-      throw WorkspaceNotFoundError("Workspace does not exist: " + id);
+      throw WorkspaceNotFoundError("Workspace does not exist: " + format_id(id));
     }
-    workspacesExpirationMap->keepAlive(id, (*optionalPtr)->getMaxIdleTimeout());
     return *optionalPtr;
   }
   
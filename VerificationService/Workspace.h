@@ -22,10 +22,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <experimental/filesystem>
 #include <map>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 
 #include "ExpirationMap.hpp"
 #include "ToolKit.h"
@@ -36,13 +41,114 @@ namespace Workspace {
 
   namespace filesystem = std::experimental::filesystem;
 
-  using WorkspaceID = std::string;
+  /// Random, fixed width; clients see it in decimal (see format_id()), the directory of the workspace is "workspace<id>"
+  using WorkspaceID = uint64_t;
   using SharedWorkspace = std::shared_ptr<Workspace>;
 
+  /// Never given to a workspace, what parse_id() makes of a malformed ID
+  constexpr WorkspaceID invalidID = 0;
+
   class WorkspaceNotFoundError : public std::runtime_error {
   public:
     WorkspaceNotFoundError(const std::string& msg) : runtime_error(msg) { }
   };
+
+  /// An upload that would take a workspace, or all of them, over the disk quota
+  class QuotaExceededError : public std::runtime_error {
+  public:
+    QuotaExceededError(const std::string& msg) : runtime_error(msg) { }
+  };
+
+  std::string format_id(WorkspaceID id);
+
+  /**
+   * @param text Decimal ID, as sent by a client
+   * @return invalidID if the text is not an ID
+   */
+  WorkspaceID parse_id(const std::string& text);
+
+  /**
+   * Disk space taken by the workspaces of the process, against the quota of all workspaces together and that of each one.
+   * Workspaces charge their usage as it changes (uploaded files, outputs of runs), the directories are not walked.
+   * Process-wide, the service threads share the workspace root.
+   */
+  class DiskAccount {
+  public:
+    static DiskAccount& instance();
+
+    DiskAccount(const DiskAccount& other) = delete;
+    DiskAccount& operator=(const DiskAccount& other) = delete;
+
+    /**
+     * Set before the service threads start.
+     * @param workspaceQuota Bytes, 0 for no quota
+     * @param totalQuota Bytes, 0 for no quota
+     */
+    void setQuotas(uint64_t workspaceQuota, uint64_t totalQuota);
+    uint64_t getWorkspaceQuota() const { return workspaceQuota; }
+    uint64_t getTotalQuota() const { return totalQuota; }
+
+    uint64_t getUsage() const { return usage; }
+    void charge(int64_t bytes) { usage += bytes; }
+
+    /// @return true if a workspace with the usage, or all workspaces together, would be over quota with the bytes added
+    bool exceeds(uint64_t workspaceUsage, uint64_t bytes) const;
+    bool isOverTotalQuota() const { return totalQuota > 0 && usage > totalQuota; }
+
+    /// @return Usage and quotas in MB, as in the availability response
+    std::string to_string() const;
+
+  private:
+    DiskAccount() : workspaceQuota(0), totalQuota(0), usage(0) { }
+
+    uint64_t workspaceQuota;
+    uint64_t totalQuota;
+    std::atomic<uint64_t> usage;
+  };
+
+  /// Directory under the workspace root that discarded directories are moved to, see Reclaimer
+  constexpr const char* trashDirectory = ".trash";
+
+  /**
+   * Process-wide thread that deletes discarded directories in the background, at the lowest CPU and idle IO priority,
+   * so that deleting a large workspace does not hold up the thread that dropped it.
+   * A directory is discarded by renaming it into the trash directory, which takes it away from its place at once.
+   * The thread deletes all pending directories before the server ends; whatever is left in the trash
+   * after a crash is deleted by the next server (see sweep()).
+   */
+  class Reclaimer {
+  public:
+    static Reclaimer& instance();
+
+    Reclaimer(const Reclaimer& other) = delete;
+    Reclaimer& operator=(const Reclaimer& other) = delete;
+    ~Reclaimer();
+
+    /**
+     * Moves the directory into the trash directory and deletes it in the background.
+     * If it cannot be moved (e.g. the trash is on another file system), it is renamed within its parent directory
+     * and deleted there in the background; a symbolic link to it in the trash lets the next server find it.
+     * @param directory
+     * @param trash Created if it does not exist
+     */
+    void discard(const filesystem::path& directory, const filesystem::path& trash);
+
+    /**
+     * Deletes everything in the trash directory in the background, and the directories its symbolic links point to
+     */
+    void sweep(const filesystem::path& trash);
+
+  private:
+    Reclaimer();
+    void serve();
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<filesystem::path> pending;
+    unsigned long discarded; // Makes the names in the trash unique
+    bool stopping;
+    std::thread thread;
+  };
   
   class Workspace : public std::enable_shared_from_this<Workspace> {
   public:
@@ -50,9 +156,9 @@ namespace Workspace {
      * Creates workspace in the specified canonical path. WebPath will be used to access the workspace from other machines.
      * @param webPath
      * @param canonicalPath
-     * @param reservation
+     * @param toolName Name of the tool the workspace is created for
      */
-    Workspace(const filesystem::path& webPath, const filesystem::path& canonicalPath, ToolKit::ToolReservation&& reservation);
+    Workspace(const filesystem::path& webPath, const filesystem::path& canonicalPath, const std::string& toolName);
     Workspace(const Workspace& orig) = delete;
     Workspace(Workspace&& orig) = delete;
     
@@ -70,6 +176,12 @@ namespace Workspace {
      * @param fileContents
      */
     void checkinFile(const Archive::Archive& archive, Archive::FileID fileID, const std::string& workspacePath);
+
+    /**
+     * Refuses an upload of the size that would take the workspace, or all workspaces, over the disk quota.
+     * Throws QuotaExceededError.
+     */
+    void admitUpload(uint64_t bytes) const;
     
     /**
      * Gets the relative path to the file with given ID. If file does not exist, throws std::out_of_range
@@ -84,6 +196,35 @@ namespace Workspace {
      * @return 
      */
     std::string getCanonicalFilePath(Archive::FileID id) const;
+
+    /**
+     * Creates a scratch directory for one run of a report: the run's working directory, where it writes its outputs.
+     * The workspace's files are hard-linked into it under the same relative paths (copied if linking fails),
+     * so runs of the workspace can execute in parallel without overwriting each other's outputs. The links share
+     * one inode with the workspace's file; the files are read-only (see checkinFile()), so a run cannot change
+     * the inputs of the others, unless it runs as root, which write permissions do not stop.
+     * A directory left by a previous run of the same report is replaced, the old one is discarded (see Reclaimer).
+     * Throws filesystem::filesystem_error.
+     * @param id The report to run
+     * @return Full canonical path of the directory
+     */
+    std::string createRunDirectory(Archive::ReportID id);
+
+    /**
+     * Charges the disk usage of the run directory of the report, replacing what was charged for it before
+     */
+    void setRunDiskUsage(Archive::ReportID id, uint64_t bytes);
+
+    /**
+     * @return Bytes the files of the directory take, without files linked from elsewhere (e.g. the inputs in a run directory)
+     */
+    static uint64_t measureDirectory(const filesystem::path& directory);
+
+    /// @return Bytes charged to the workspace: its files and the directories of its runs
+    uint64_t getDiskUsage() const;
+
+    /// @return true if the workspace takes more than the quota of one workspace (see DiskAccount)
+    bool isOverDiskQuota() const;
     
     /**
      * Returns the full canonical filesystem path of the workspace directory
@@ -104,10 +245,10 @@ namespace Workspace {
     const std::string getWebPath() const;
     
     /**
-     * Returns reserved tool or throws ToolKit::ReservationError
+     * Returns name of the tool the workspace was created for
      * @return 
      */
-    const ToolKit::Tool& getTool() const;
+    const std::string& getToolName() const;
     
     /**
      * Checks if file with given ID is available in the workspace
@@ -122,6 +263,12 @@ namespace Workspace {
      * @return true if the report is allowed to be accessed. False if not.
      */
     bool isReportAllowed(Archive::ReportID id) const;
+
+    /**
+     * Keeps the workspace directory when the workspace is destroyed, for runs that outlive the server
+     * and are taken over by the next one (see Zygote::held())
+     */
+    void retainDirectory();
     
   private:
     /**
@@ -130,13 +277,19 @@ namespace Workspace {
      * @return 
      */
     bool isRelativePathWithinWorkspace(const filesystem::path& p);
+
+    static constexpr const char* runsDirectory = "runs"; // Scratch directories of runs, see createRunDirectory()
     
     mutable std::mutex mutex;
     const filesystem::path webPath; // root of the workspace relative to the www root
     const filesystem::path canonicalPath; // root of the workspace - absolute canonical path
-    ToolKit::ToolReservation toolReservation; // Reservation of the workspace's tool
+    const std::string toolName; // Tool the workspace was created for. Instances of the tool are reserved per run by the scheduler.
     std::set<Archive::ReportID> reports; // List of accessible report IDs
     std::map<Archive::FileID, filesystem::path> files; // Map of ArchiveIDs to filepaths within this workspace
+    std::map<filesystem::path, uint64_t> fileSizes; // Charged for the files checked in, by relative path
+    std::map<Archive::ReportID, uint64_t> runDiskUsage; // Charged for the run directories
+    uint64_t diskUsage; // Sum of the above, also charged to DiskAccount
+    bool retained; // The directory is not discarded with the workspace
   };
 
   
@@ -152,33 +305,45 @@ namespace Workspace {
     * @param workspaceRootPath Has to be a directory path. If it is not, or cannot be created, 
     * a std::experimantal::filesystem_exception will be thrown.
     * If the path does not exist, it will be created.
+    * The first manager of the process discards the workspace directories left by an earlier server and sweeps its trash (see Reclaimer).
+    * @param keep Names of workspace directories not to clean up, held by runs of an earlier server
     */
-    WorkspaceManager(const std::string& workspaceRootPath);
+    WorkspaceManager(const std::string& workspaceRootPath, const std::set<std::string>& keep = {});
     WorkspaceManager(const WorkspaceManager& other) = delete;
     WorkspaceManager(WorkspaceManager&& other) = delete;
     
     /**
-     * Creates a new workspace with the specified tool reserved. 
-     * @param toolReservation
+     * Creates a new workspace for the specified tool. 
+     * @param toolName
      * @return 
      */
-    std::pair<WorkspaceID, SharedWorkspace> create(ToolKit::ToolReservation&& toolReservation);
+    std::pair<WorkspaceID, SharedWorkspace> create(const std::string& toolName);
+
+    /**
+     * Takes over the directory of a workspace of an earlier server, with the files in it; the workspace keeps its ID.
+     * Files checked in by the earlier server are not known to the workspace (see hasFile()).
+     * @param canonicalPath The workspace directory, named "workspace<id>"
+     * @param toolName
+     * @return The workspace, also if it was taken over already
+     */
+    std::pair<WorkspaceID, SharedWorkspace> adopt(const std::string& canonicalPath, const std::string& toolName);
     
     /**
      * Destroys workspace (removes from manager, workspace will release resources when all shared_ptrs are destroyed)
      * @param id
      */
-    void destroy(const WorkspaceID& id);
+    void destroy(WorkspaceID id);
     
     /**
     * Get poiter to workspace if the workspace has not expired. If it has, a WorkspaceNotFoundError will be thrown
     * @param id
     * @return 
     */
-    std::shared_ptr<Workspace> get(const WorkspaceID& id);
+    std::shared_ptr<Workspace> get(WorkspaceID id);
 
   private:
-    using WorkspacesExpirationMap = ExpirationMap::ExpirationMap<WorkspaceID, SharedWorkspace>;
+    /// Every shard has its own lock and keeps the expiration of its workspaces with them, lookups of different workspaces rarely contend
+    using WorkspacesExpirationMap = ExpirationMap::ShardedExpirationMap<WorkspaceID, SharedWorkspace>;
     using SharedWorkspacesExpirationMap = std::shared_ptr<WorkspacesExpirationMap>;
     
     void onWorkspacesExpired(WorkspacesExpirationMap::ExpiredValues&& expiredWorkspacesIDs);
@@ -186,7 +351,7 @@ namespace Workspace {
     filesystem::path wwwWorkspaceRootPath; // TODO: path to the workspaces dir when accessed from other machines - make sure it is relative to www root
     filesystem::path canonicalWorkspaceRootPath; // canonical path to the root of workspaces
     SharedWorkspacesExpirationMap workspacesExpirationMap;
-    ExpirationMap::PeriodicExpirator<WorkspaceID, SharedWorkspace> periodicExpirator;
+    ExpirationMap::PeriodicExpirator<WorkspaceID, SharedWorkspace, WorkspacesExpirationMap> periodicExpirator;
   };
 
 } // namespace
\ No newline at end of file
@@ -277,6 +277,16 @@ String Xml::find_param_value_string(const Indices& params, const String& pName)
   return bbb::dequote(get_param_value(param));
 }
 
+/**
+ * Same as find_param_value_string, but returns defaultValue instead of throwing if the parameter is missing
+ */
+String Xml::find_param_value_string(const Indices& params, const String& pName, const String& defaultValue) const {
+  Index param = find_param(params, pName);
+  if (param < 0)
+    return defaultValue;
+  return bbb::dequote(get_param_value(param));
+}
+
 bool Xml::find_param_value_bool(const Indices& params, const String& pName) const {
   Index param = find_param(params, pName);
   assert_xml(param > -1);
@@ -288,6 +298,30 @@ bool Xml::find_param_value_bool(const Indices& params, const String& pName) cons
   assert_xml(false); // Invalid value for the bool parameter in XML
 }
 
+/**
+ * Same as find_param_value_bool, but returns defaultValue instead of throwing if the parameter is missing
+ */
+bool Xml::find_param_value_bool(const Indices& params, const String& pName, bool defaultValue) const {
+  if (find_param(params, pName) < 0)
+    return defaultValue;
+  return find_param_value_bool(params, pName);
+}
+
+/**
+ * Reads an optional unsigned integer parameter. Throws MalformedXMLException if the value is not a number.
+ * @return the parameter's value or defaultValue if the parameter is missing
+ */
+Nat Xml::find_param_value_nat(const Indices& params, const String& pName, Nat defaultValue) const {
+  Index param = find_param(params, pName);
+  if (param < 0)
+    return defaultValue;
+  std::string value = bbb::dequote(get_param_value(param));
+  char* end = nullptr;
+  unsigned long result = std::strtoul(value.c_str(), &end, 10);
+  assert_xml(!value.empty() && *end == '\0', "Invalid numeric value of parameter " + pName);
+  return result;
+}
+
 void Xml::find_params(const Indices& params, const String& pName, Indices& res) const {
   for (Nat i = 0; i < params.size(); i++) {
     if (parameter_name(params[i]).find(pName) != String::npos)
@@ -362,7 +362,10 @@ struct Xml {
   void find_items(const String& iName, Indices& finds) const;
   Index find_param(const Indices & params, const String & pName) const;
   String find_param_value_string(const Indices & params, const String & pName) const;
+  String find_param_value_string(const Indices & params, const String & pName, const String & defaultValue) const;
   bool find_param_value_bool(const Indices & params, const String & pName) const;
+  bool find_param_value_bool(const Indices & params, const String & pName, bool defaultValue) const;
+  Nat find_param_value_nat(const Indices & params, const String & pName, Nat defaultValue) const;
   void find_params(const Indices& params, const String& pName, Indices& res) const;
   void get_params(const Index item, Indices & res) const;
   String get_param_value(Index i) const { return tokens[parameters[i].value]; }
@@ -0,0 +1,552 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Zygote.cpp
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Zygote.h"
+
+namespace Zygote {
+
+namespace {
+
+std::shared_ptr<Zygote> helperInstance; // Set before the server starts its threads, read-only afterwards
+
+const size_t maxMessage = 64 * 1024;
+
+enum class MessageType : uint32_t { spawn, wait, list };
+
+/// Launch request: followed by cpuCount core numbers and stringCount NUL-terminated strings
+/// (executable, working directory, tag, arguments); the output descriptors travel as SCM_RIGHTS.
+/// Wait and list requests: only the header.
+struct RequestHeader {
+  MessageType type;
+  int32_t pid;
+  int32_t numaNode;
+  uint32_t cpuCount;
+  uint32_t stringCount;
+};
+
+/// Followed by the error message if result is -1, by result pairs of NUL-terminated process IDs and tags for list
+struct ReplyHeader {
+  int32_t result; // Launch: process ID or -1; wait: as waitpid; list: number of held processes
+  int32_t status;
+};
+
+bool send_message(int socket, const String& message, const int* fds, size_t fdCount) {
+  iovec io{const_cast<char*>(message.data()), message.size()};
+  msghdr header;
+  memset(&header, 0, sizeof(header));
+  header.msg_iov = &io;
+  header.msg_iovlen = 1;
+  char control[CMSG_SPACE(2 * sizeof(int))];
+  if (fdCount > 0) {
+    memset(control, 0, sizeof(control));
+    header.msg_control = control;
+    header.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+    cmsghdr* rights = CMSG_FIRSTHDR(&header);
+    rights->cmsg_level = SOL_SOCKET;
+    rights->cmsg_type = SCM_RIGHTS;
+    rights->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+    memcpy(CMSG_DATA(rights), fds, fdCount * sizeof(int));
+  }
+  ssize_t sent;
+  do {
+    sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent == static_cast<ssize_t>(message.size());
+}
+
+/// @return false if the other side closed the socket or the socket failed
+bool receive_message(int socket, String& message, int* fds, size_t& fdCount) {
+  message.resize(maxMessage);
+  iovec io{&message[0], message.size()};
+  msghdr header;
+  memset(&header, 0, sizeof(header));
+  header.msg_iov = &io;
+  header.msg_iovlen = 1;
+  char control[CMSG_SPACE(2 * sizeof(int))];
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+  ssize_t received;
+  do {
+    received = recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received <= 0)
+    return false;
+  message.resize(received);
+  fdCount = 0;
+  for (cmsghdr* c = CMSG_FIRSTHDR(&header); c; c = CMSG_NXTHDR(&header, c))
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+      size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < count; i++) {
+        int fd;
+        memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+        if (fdCount < 2)
+          fds[fdCount++] = fd;
+        else
+          close(fd);
+      }
+    }
+  return true;
+}
+
+template<typename T>
+void append(String& message, const T& value) {
+  message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+String reply(int32_t result, int32_t status, const String& error = "") {
+  String message;
+  append(message, ReplyHeader{result, status});
+  message += error;
+  return message;
+}
+
+/// Whether the process exists and is not a zombie waiting to be collected by its new parent
+bool is_alive(pid_t pid) {
+  if (::kill(pid, 0) != 0 && errno != EPERM)
+    return false;
+  Strings lines;
+  if (!bbb::read_file("/proc/" + std::to_string(pid) + "/stat", lines) || lines.empty())
+    return false;
+  size_t state = lines.back().rfind(')'); // The name of the process may contain spaces and parentheses
+  return state == String::npos || state + 2 >= lines.back().size() || lines.back()[state + 2] != 'Z';
+}
+
+/// Boot ID and start time of the process, empty if it does not exist. Tells the process apart from a later one
+/// that got the same process ID after the IDs wrapped or the machine rebooted.
+String process_identity(pid_t pid) {
+  Strings lines;
+  if (!bbb::read_file("/proc/" + std::to_string(pid) + "/stat", lines) || lines.empty())
+    return "";
+  size_t fields = lines.back().rfind(')'); // The name of the process may contain spaces and parentheses
+  if (fields == String::npos)
+    return "";
+  std::istringstream stat(lines.back().substr(fields + 1));
+  String startTime;
+  for (int field = 3; field <= 22 && stat >> startTime; field++) { } // Field 22: start time in clock ticks since boot
+  static const String bootID = [] {
+    Strings id;
+    bbb::read_file("/proc/sys/kernel/random/boot_id", id);
+    return (id.empty() ? String("-") : id.front());
+  }();
+  return (stat ? bootID + ":" + startTime : "");
+}
+
+/// Handles one launch request in the helper
+String launch(const String& message, int out, int err, int in, String& tag) {
+  RequestHeader header;
+  memcpy(&header, message.data(), sizeof(header));
+  size_t position = sizeof(header);
+  if (header.cpuCount > (message.size() - position) / sizeof(uint32_t))
+    return reply(-1, 0, "Malformed launch request");
+  Affinity::CpuIDs cpus;
+  for (uint32_t i = 0; i < header.cpuCount; i++, position += sizeof(uint32_t)) {
+    uint32_t cpu;
+    memcpy(&cpu, message.data() + position, sizeof(cpu));
+    cpus.push_back(cpu);
+  }
+  Strings strings;
+  while (position < message.size() && strings.size() < header.stringCount) {
+    size_t end = message.find('\0', position);
+    if (end == String::npos)
+      break;
+    strings.push_back(message.substr(position, end - position));
+    position = end + 1;
+  }
+  if (strings.size() < 4 || strings.size() != header.stringCount)
+    return reply(-1, 0, "Malformed launch request");
+  Affinity::CoreSet cores(std::move(cpus), header.numaNode, false);
+  String path = strings[0];
+  String workingDirectory = strings[1];
+  tag = strings[2];
+  Strings arguments(strings.begin() + 3, strings.end());
+  try {
+    return reply(Launcher::start(path, arguments, workingDirectory, in, out, err, &cores), 0);
+  }
+  catch (const Launcher::LaunchError& e) {
+    return reply(-1, 0, e.what());
+  }
+}
+
+/// @return -1 if nobody listens on the path
+int connect_unix(const String& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+}
+
+/// Tags must not contain newlines, a tag takes one line of the state file after the process ID and its identity
+struct Zygote::Holdings {
+  String statePath;
+  std::map<pid_t, String> tags;
+  std::map<pid_t, String> identities; // As of process_identity when started, checked before trusting the process ID again
+  std::set<pid_t> adopted; // Held by an earlier supervisor, not children of this one
+
+  void hold(pid_t pid, const String& tag) {
+    tags[pid] = tag;
+    identities[pid] = process_identity(pid);
+    save();
+  }
+
+  void release(pid_t pid) {
+    tags.erase(pid);
+    identities.erase(pid);
+    adopted.erase(pid);
+    save();
+  }
+
+  /// Whether an adopted process still runs; a process that reuses its ID after it ended does not count
+  bool adopted_alive(pid_t pid) const {
+    auto identity = identities.find(pid);
+    return identity != identities.end() && is_alive(pid) && process_identity(pid) == identity->second;
+  }
+
+  void load() {
+    Strings lines;
+    bbb::read_file(statePath, lines);
+    for (const String& line : lines) {
+      size_t first = line.find(' ');
+      size_t second = (first == String::npos ? String::npos : line.find(' ', first + 1));
+      pid_t pid = std::atoi(line.c_str());
+      if (second == String::npos || pid <= 0)
+        continue;
+      String identity = line.substr(first + 1, second - first - 1);
+      if (identity.empty() || !is_alive(pid) || process_identity(pid) != identity)
+        continue; // Ended while no supervisor ran, or the ID now belongs to an unrelated process
+      tags[pid] = line.substr(second + 1);
+      identities[pid] = identity;
+      adopted.insert(pid);
+    }
+    save();
+  }
+
+  /// Written aside and renamed, a crash leaves the previous state
+  void save() const {
+    String partial = statePath + ".part";
+    {
+      std::ofstream file(partial, std::ios::trunc);
+      for (const auto& entry : tags)
+        file << entry.first << " " << identities.at(entry.first) << " " << entry.second << "\n";
+    }
+    rename(partial.c_str(), statePath.c_str());
+  }
+};
+
+void Zygote::start(const String& supervisorPath) {
+  if (helperInstance)
+    return;
+  if (!supervisorPath.empty()) {
+    if (supervisorPath.size() >= sizeof(sockaddr_un::sun_path))
+      throw std::runtime_error("The supervisor socket path is too long: " + supervisorPath);
+    int socket = connect_unix(supervisorPath);
+    pid_t pid = -1;
+    if (socket < 0) { // No supervisor yet, or a stale socket of one that ended
+      unlink(supervisorPath.c_str());
+      int listener = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+      sockaddr_un address;
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      strncpy(address.sun_path, supervisorPath.c_str(), sizeof(address.sun_path) - 1);
+      // Only the server's user may connect, the supervisor starts processes for whoever does; set before anyone can connect
+      if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+          || chmod(supervisorPath.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listener, 4) != 0)
+        throw std::runtime_error("Cannot listen on " + supervisorPath + ": " + strerror(errno));
+      pid = fork();
+      if (pid < 0)
+        throw std::runtime_error(String("Cannot start the supervisor: ") + strerror(errno));
+      if (pid == 0)
+        supervise(listener, supervisorPath + ".state");
+      close(listener);
+      socket = connect_unix(supervisorPath);
+      if (socket < 0)
+        throw std::runtime_error("Cannot connect to the supervisor at " + supervisorPath + ": " + strerror(errno));
+    }
+    helperInstance.reset(new Zygote(socket, pid, true));
+    helperInstance->list_held();
+    DEB("Supervisor " << (pid > 0 ? "started, PID: " + std::to_string(pid) : String("of an earlier server connected"))
+        << ", holds " << helperInstance->held().size() << " processes");
+    return;
+  }
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+    throw std::runtime_error(String("Cannot create the zygote socket: ") + strerror(errno));
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(sockets[0]);
+    close(sockets[1]);
+    throw std::runtime_error(String("Cannot start the zygote: ") + strerror(errno));
+  }
+  if (pid == 0) {
+    close(sockets[0]);
+    serve(sockets[1]);
+  }
+  close(sockets[1]);
+  helperInstance.reset(new Zygote(sockets[0], pid, false));
+  DEB("Zygote started, PID: " << pid);
+}
+
+Zygote* Zygote::instance() {
+  return helperInstance.get();
+}
+
+Zygote::Zygote(int socket, pid_t helper, bool supervisor) :
+    socket(socket), helper(helper), lost(false), supervisor(supervisor), heldClaimed(false) { }
+
+/// Main loop of the helper; ends when the server closes its end of the socket.
+void Zygote::serve(int socket) {
+  prctl(PR_SET_NAME, "VerifyZygote");
+  signal(SIGINT, SIG_IGN); // Stopped with the server by the end of the socket, not by the terminal
+  int in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  serve_connection(socket, in, nullptr);
+  _exit(0);
+}
+
+/// Main loop of the supervisor; serves one server at a time and waits for the next one when the server ends.
+void Zygote::supervise(int listener, const String& statePath) {
+  prctl(PR_SET_NAME, "VerifySupervisor");
+  setsid(); // Signals to the server's process group or session do not reach the supervisor and its processes
+  signal(SIGINT, SIG_IGN);
+  signal(SIGHUP, SIG_IGN);
+  int in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  int null = open("/dev/null", O_RDWR);
+  for (int fd : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}) // Detached from the server's terminal or log
+    dup2(null, fd);
+  close(null);
+  Holdings holdings;
+  holdings.statePath = statePath;
+  holdings.load();
+  for (;;) {
+    int socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (socket < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      _exit(1);
+    }
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+    if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != geteuid()) { // Root connects whatever the mode
+      close(socket);
+      continue;
+    }
+    serve_connection(socket, in, &holdings);
+    close(socket);
+  }
+}
+
+/// @return When the server closed its end of the socket
+bool Zygote::serve_connection(int socket, int in, Holdings* holdings) {
+  String message;
+  for (;;) {
+    int fds[2];
+    size_t fdCount = 0;
+    if (!receive_message(socket, message, fds, fdCount))
+      return false;
+    String answer;
+    RequestHeader header;
+    if (message.size() < sizeof(header)) {
+      answer = reply(-1, 0, "Malformed request");
+    }
+    else {
+      memcpy(&header, message.data(), sizeof(header));
+      if (header.type == MessageType::spawn && fdCount == 2) {
+        String tag;
+        answer = launch(message, fds[0], fds[1], in, tag);
+        ReplyHeader result;
+        memcpy(&result, answer.data(), sizeof(result));
+        if (holdings && result.result > 0)
+          holdings->hold(result.result, tag);
+      }
+      else if (header.type == MessageType::wait) {
+        int status = 0;
+        pid_t result = waitpid(header.pid, &status, WNOHANG);
+        if (result < 0 && holdings && holdings->adopted.count(header.pid)) { // Not our child, its status is lost
+          result = (holdings->adopted_alive(header.pid) ? 0 : header.pid);
+          status = 0;
+        }
+        if (holdings && result == header.pid && holdings->tags.count(header.pid))
+          holdings->release(header.pid);
+        answer = reply(result, status);
+      }
+      else if (header.type == MessageType::list) {
+        String entries;
+        int32_t count = 0;
+        if (holdings)
+          for (const auto& entry : holdings->tags) {
+            String item = std::to_string(entry.first) + '\0' + entry.second + '\0';
+            if (sizeof(ReplyHeader) + entries.size() + item.size() > maxMessage)
+              break; // The rest stays unknown to the server, the processes run on
+            entries += item;
+            count++;
+          }
+        answer = reply(count, 0, entries);
+      }
+      else {
+        answer = reply(-1, 0, "Malformed request");
+      }
+    }
+    for (size_t i = 0; i < fdCount; i++)
+      close(fds[i]);
+    if (!send_message(socket, answer, nullptr, 0))
+      return false;
+  }
+}
+
+void Zygote::list_held() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  String message;
+  append(message, RequestHeader{MessageType::list, 0, -1, 0, 0});
+  pid_t count;
+  int status;
+  String entries;
+  if (!exchange_nomutex(message, nullptr, 0, count, status, entries))
+    return;
+  size_t position = 0;
+  for (pid_t i = 0; i < count; i++) {
+    size_t pidEnd = entries.find('\0', position);
+    size_t tagEnd = (pidEnd == String::npos ? String::npos : entries.find('\0', pidEnd + 1));
+    if (tagEnd == String::npos)
+      break;
+    heldProcesses.push_back({std::atoi(entries.c_str() + position), entries.substr(pidEnd + 1, tagEnd - pidEnd - 1)});
+    position = tagEnd + 1;
+  }
+}
+
+bool Zygote::claim_held() {
+  std::lock_guard<decltype(mutex)> lockGuard(mutex);
+  if (heldClaimed)
+    return false;
+  heldClaimed = true;
+  return true;
+}
+
+/// Sends a request and receives the reply. Returns false if the helper is gone.
+bool Zygote::exchange_nomutex(const String& message, const int* fds, size_t fdCount, pid_t& result, int& status, String& error) {
+  if (lost)
+    return false;
+  String answer;
+  int unexpected[2];
+  size_t unexpectedCount = 0;
+  if (!send_message(socket, message, fds, fdCount) || !receive_message(socket, answer, unexpected, unexpectedCount)
+      || answer.size() < sizeof(ReplyHeader)) {
+    helper_lost_nomutex();
+    return false;
+  }
+  for (size_t i = 0; i < unexpectedCount; i++)
+    close(unexpected[i]);
+  ReplyHeader header;
+  memcpy(&header, answer.data(), sizeof(header));
+  result = header.result;
+  status = header.status;
+  error = answer.substr(sizeof(header));
+  return true;
+}
+
+void Zygote::helper_lost_nomutex() {
+  DEB("The zygote (PID " << helper << ") is not responding, starting processes directly.");
+  lost = true;
+  close(socket);
+  socket = -1;
+  if (helper > 0)
+    waitpid(helper, nullptr, WNOHANG);
+}
+
+Launcher::Process Zygote::spawn(const Launcher::Request& request) {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (lost)
+      return Launcher::spawn(request);
+  }
+  String path;
+  Strings arguments;
+  Launcher::parse_command(request.command, path, arguments);
+  Launcher::FileDescriptor out(Launcher::open_output(request.outFileName));
+  Launcher::FileDescriptor err(Launcher::open_output(request.errFileName));
+
+  String message;
+  const Affinity::CpuIDs noCpus;
+  const Affinity::CpuIDs& cpus = (request.cores ? request.cores->get_cpus() : noCpus);
+  append(message, RequestHeader{MessageType::spawn, 0, request.cores ? request.cores->get_numa_node() : -1,
+                                static_cast<uint32_t>(cpus.size()), static_cast<uint32_t>(arguments.size() + 3)});
+  for (Nat cpu : cpus)
+    append(message, static_cast<uint32_t>(cpu));
+  message.append(path.c_str(), path.size() + 1);
+  message.append(request.workingDirectory.c_str(), request.workingDirectory.size() + 1);
+  message.append(request.tag.c_str(), request.tag.size() + 1);
+  for (const String& argument : arguments)
+    message.append(argument.c_str(), argument.size() + 1);
+  if (message.size() > maxMessage)
+    throw Launcher::LaunchError("Command too long for the zygote: " + request.command);
+
+  const int fds[2] = {out.fd, err.fd};
+  pid_t pid;
+  int status;
+  String error;
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    if (!exchange_nomutex(message, fds, 2, pid, status, error))
+      return Launcher::spawn(request);
+  }
+  if (pid <= 0)
+    throw Launcher::LaunchError(error);
+  return Launcher::Process(pid, shared_from_this());
+}
+
+pid_t Zygote::wait(pid_t pid, int* status) {
+  {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    String message;
+    append(message, RequestHeader{MessageType::wait, pid, -1, 0, 0});
+    pid_t result;
+    String error;
+    if (exchange_nomutex(message, nullptr, 0, result, *status, error))
+      return result;
+  }
+  // The helper is gone, its processes were adopted by init and their exit status is lost:
+  if (is_alive(pid))
+    return 0;
+  *status = 0;
+  return pid;
+}
+
+Launcher::Process spawn(const Launcher::Request& request) {
+  Zygote* zygote = Zygote::instance();
+  return (zygote ? zygote->spawn(request) : Launcher::spawn(request));
+}
+
+}
@@ -0,0 +1,114 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   Zygote.h
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/types.h>
+
+#include "bbb.h"
+#include "Launcher.h"
+
+namespace Zygote {
+
+using namespace Basics;
+
+/**
+ * Small helper process that starts verification processes on behalf of the server.
+ *
+ * The helper is forked once at server start, while the server is still small and single-threaded,
+ * and receives launch requests over a Unix socket: the resolved command, the working directory,
+ * the cores, and the already opened output files (passed as descriptors). Launch latency therefore
+ * does not depend on how large the server grew. The helper also collects the exit status of the
+ * processes it started, the server asks for it instead of calling waitpid.
+ *
+ * If the helper dies, processes are started directly by the server again.
+ *
+ * Started as a supervisor, the helper outlives the server: it leaves the server's session, listens on a Unix socket
+ * and holds its processes across restarts of the server. It keeps the tag of every process it holds in a state file
+ * next to the socket, and a restarted server connects to it again and takes over the processes by their tags
+ * (see held()). A supervisor that was restarted itself takes the processes of its state file that are still alive,
+ * their exit status is lost then.
+ */
+class Zygote : public Launcher::Reaper, public std::enable_shared_from_this<Zygote> {
+public:
+  /// A process the supervisor held when the server connected to it
+  struct HeldProcess {
+    pid_t pid;
+    String tag;
+  };
+
+  /**
+   * Forks the helper. Must be called before the server starts its threads.
+   * With a socket path, connects to the supervisor listening there, or forks one if there is none.
+   * Throws std::runtime_error if the helper cannot be started.
+   */
+  static void start(const String& supervisorPath = "");
+
+  /**
+   * @return The helper, nullptr if it was not started
+   */
+  static Zygote* instance();
+
+  Zygote(const Zygote& other) = delete;
+  Zygote& operator=(const Zygote& other) = delete;
+
+  /**
+   * Starts the process through the helper, or directly if the helper is not available any more.
+   * Throws Launcher::LaunchError.
+   */
+  Launcher::Process spawn(const Launcher::Request& request);
+
+  virtual pid_t wait(pid_t pid, int* status) override;
+
+  bool is_supervisor() const { return supervisor; }
+
+  /**
+   * @return Processes the supervisor held when the server connected, started by an earlier server
+   */
+  const std::vector<HeldProcess>& held() const { return heldProcesses; }
+
+  /**
+   * @return true for the first caller only, who takes over the held processes
+   */
+  bool claim_held();
+
+private:
+  Zygote(int socket, pid_t helper, bool supervisor);
+  [[noreturn]] static void serve(int socket);
+  [[noreturn]] static void supervise(int listener, const String& statePath);
+  struct Holdings; // The processes a supervisor holds and its state file
+  static bool serve_connection(int socket, int in, Holdings* holdings);
+  void list_held();
+  bool exchange_nomutex(const String& message, const int* fds, size_t fdCount, pid_t& result, int& status, String& error);
+  void helper_lost_nomutex();
+
+  std::mutex mutex;
+  int socket;
+  pid_t helper; // -1 for a supervisor started by an earlier server
+  bool lost;
+  const bool supervisor;
+  std::vector<HeldProcess> heldProcesses;
+  bool heldClaimed;
+};
+
+/**
+ * Starts the process through the helper if it was started, directly otherwise.
+ * Throws Launcher::LaunchError.
+ */
+Launcher::Process spawn(const Launcher::Request& request);
+
+}
@@ -17,6 +17,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <cassert>
 #include <fstream>
 #include <sstream>
@@ -66,7 +67,7 @@ template<typename T>
 struct UHash {
   using Pool = std::unordered_set<Hash>;
   
-  std::vector<T> store;
+  std::deque<T> store; // Elements never move once inserted, references to them stay valid
   std::unordered_map<Hash, Pool> index;
 
   Hash insert_unchecked(const T& value, Hash h) {
@@ -76,6 +77,20 @@ struct UHash {
     return id;
   }
 
+  /**
+   * Puts the value under a given ID, e.g. one it had in an earlier store. The IDs below it that are not used yet
+   * get copies of the filler, which are not indexed and so never found by insert().
+   * @return false if the ID is used already
+   */
+  bool restore(Hash id, const T& value, const T& filler) {
+    if (id < store.size())
+      return false;
+    while (store.size() < id)
+      store.push_back(filler);
+    insert_unchecked(value, value.hash());
+    return true;
+  }
+
   template<class... Args>
   Hash emplace(Hash h, Args&&... args) {
     Hash id = store.size();
@@ -0,0 +1,221 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   expirationBench.cpp
+ *
+ * The timing-wheel ExpirationMap and its sharded variant against the previous map (std::map of items
+ * with a std::multiset of expiration times, kept below as the baseline).
+ * Usage: expirationBench [items] [threads]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <experimental/optional>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ExpirationMap.hpp"
+
+namespace {
+
+using ExpirationMap::Duration;
+using ExpirationMap::TimePoint;
+
+/// The previous ExpirationMap, as it was
+template<typename K, typename V>
+class TreeExpirationMap {
+public:
+  using ExpiredValues = std::map<K, V>;
+
+  void insert(const K& key, const V& value, Duration duration) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    auto valIt = items.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value, times.end()));
+    keepAlive_nomutex(valIt.first, duration);
+  }
+
+  std::experimental::optional<V> get(const K& key) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    auto it = items.find(key);
+    if (it != items.end())
+      return std::experimental::make_optional(it->second.value);
+    return {};
+  }
+
+  bool keepAlive(const K& key, Duration dur) {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    return keepAlive_nomutex(items.find(key), dur);
+  }
+
+  const TimePoint getNextExpirationTime() {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    return times.empty() ? TimePoint::max() : times.begin()->expirationTime;
+  }
+
+  ExpiredValues pop_expired() {
+    std::lock_guard<decltype(mutex)> lockGuard(mutex);
+    ExpiredValues expired;
+    auto endIt = times.upper_bound({std::chrono::steady_clock::now(), {}});
+    for (auto it = times.begin(); it != endIt; ) {
+      const K& key = *(it->itemKey);
+      ++it;
+      auto itemIt = items.find(key);
+      expired.insert({key, std::move(itemIt->second.value)});
+      times.erase(itemIt->second.timeIt);
+      items.erase(itemIt);
+    }
+    return expired;
+  }
+
+private:
+  struct Time {
+    Time(const TimePoint& expirationTime, const K* itemKey) : expirationTime(expirationTime), itemKey(itemKey) {}
+    TimePoint expirationTime;
+    const K* itemKey;
+  };
+  struct TimeComparator {
+    bool operator()(const Time& lhs, const Time& rhs) const { return lhs.expirationTime < rhs.expirationTime; }
+  };
+  using Times = std::multiset<Time, TimeComparator>;
+  struct Value {
+    Value(const V& value, const typename Times::iterator& timeIt) : value(value), timeIt(timeIt) {}
+    V value;
+    typename Times::iterator timeIt;
+  };
+  using Items = std::map<K, Value>;
+
+  bool keepAlive_nomutex(typename Items::iterator itemIt, Duration dur) {
+    if (itemIt == items.end())
+      return false;
+    if (itemIt->second.timeIt != times.end())
+      times.erase(itemIt->second.timeIt);
+    itemIt->second.timeIt = times.emplace(std::chrono::steady_clock::now() + dur, &(itemIt->first));
+    return true;
+  }
+
+  std::mutex mutex;
+  Items items;
+  Times times;
+};
+
+const Duration idleTimeout = std::chrono::seconds{60};
+
+/// Operations per second
+double measure(size_t operations, const std::function<void()>& run) {
+  auto start = std::chrono::steady_clock::now();
+  run();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return operations / elapsed.count();
+}
+
+template<typename Map>
+void print_row(const std::string& name, Map& map, const std::vector<std::string>& keys, unsigned threads,
+               const std::function<void(Map&, const std::string&)>& touch, const std::function<void(Map&)>& poll) {
+  const size_t n = keys.size();
+  std::vector<std::string> shuffled(keys);
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+
+  double insert = measure(n, [&] () {
+      for (const std::string& key : keys)
+        map.insert(key, n, idleTimeout);
+    });
+  double keepAlive = measure(n, [&] () {
+      for (const std::string& key : shuffled)
+        map.keepAlive(key, idleTimeout + std::chrono::seconds{1});
+    });
+  double getTouch = measure(n, [&] () {
+      for (const std::string& key : shuffled)
+        touch(map, key);
+    });
+  const size_t polls = 1000;
+  double idle = measure(polls, [&] () { // The periodic expirator's wake-up when nothing expired
+      for (size_t i = 0; i < polls; i++)
+        poll(map);
+    });
+  const size_t concurrent = n * 4;
+  double parallel = measure(concurrent, [&] () {
+      std::vector<std::thread> workers;
+      for (unsigned t = 0; t < threads; t++)
+        workers.emplace_back([&, t] () {
+            for (size_t i = t; i < concurrent; i += threads)
+              touch(map, shuffled[i % n]);
+          });
+      for (std::thread& worker : workers)
+        worker.join();
+    });
+  std::cout << name << insert / 1e6 << "\t" << keepAlive / 1e6 << "\t" << getTouch / 1e6 << "\t"
+            << idle / 1e3 << "\t\t" << parallel / 1e6 << "\n";
+}
+
+/// Inserts the keys with a short timeout and measures popping them all once they expired
+template<typename Map>
+double measure_expiry(Map& map, const std::vector<std::string>& keys) {
+  const Duration shortTimeout = std::chrono::milliseconds{50};
+  for (const std::string& key : keys)
+    map.insert(key + "-short", 0, shortTimeout);
+  std::this_thread::sleep_for(shortTimeout + std::chrono::milliseconds{150});
+  size_t popped = 0;
+  double rate = measure(keys.size(), [&] () { popped = map.pop_expired().size(); });
+  if (popped != keys.size())
+    std::cerr << "Popped " << popped << " of " << keys.size() << " expired items\n";
+  return rate;
+}
+
+}
+
+int main(int argc, char** argv) {
+  size_t items = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000);
+  unsigned threads = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4);
+  if (items == 0 || threads == 0) {
+    std::cerr << "Usage: " << argv[0] << " [items] [threads]\n";
+    return 1;
+  }
+
+  std::vector<std::string> keys;
+  std::mt19937_64 generator(7);
+  for (size_t i = 0; i < items; i++)
+    keys.push_back(std::to_string(generator())); // Workspace IDs look like this
+
+  std::cout << items << " items, " << threads << " thread(s) for the concurrent get and keep-alive\n"
+            << "\t\tinsert\tkeep-alive\tget+keep-alive\tidle poll\tconcurrent\n"
+            << "\t\tM/s\tM/s\t\tM/s\t\tk/s\t\tM/s\n";
+
+  using Tree = TreeExpirationMap<std::string, size_t>;
+  using Wheel = ExpirationMap::ExpirationMap<std::string, size_t>;
+  using Sharded = ExpirationMap::ShardedExpirationMap<std::string, size_t>;
+  Tree tree;
+  Wheel wheel;
+  Sharded sharded;
+  // The tree needs two lookups for what WorkspaceManager::get() does, the wheel one.
+  // The tree's expirator looked at the nearest expiration before popping, the wheel's pops right away.
+  print_row<Tree>("Tree:\t\t", tree, keys, threads, [] (Tree& map, const std::string& key) {
+      if (map.get(key))
+        map.keepAlive(key, idleTimeout);
+    }, [] (Tree& map) {
+      if (map.getNextExpirationTime() <= std::chrono::steady_clock::now())
+        map.pop_expired();
+    });
+  print_row<Wheel>("Wheel:\t\t", wheel, keys, threads, [] (Wheel& map, const std::string& key) { map.getAndKeepAlive(key); },
+                   [] (Wheel& map) { map.pop_expired(); });
+  print_row<Sharded>("Sharded wheel:\t", sharded, keys, threads, [] (Sharded& map, const std::string& key) { map.getAndKeepAlive(key); },
+                     [] (Sharded& map) { map.pop_expired(); });
+
+  std::cout << "Popping " << items << " expired items: tree " << measure_expiry(tree, keys) / 1e6 << " M/s, wheel "
+            << measure_expiry(wheel, keys) / 1e6 << " M/s, sharded wheel " << measure_expiry(sharded, keys) / 1e6 << " M/s\n";
+  return 0;
+}
@@ -0,0 +1,52 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   remoteTest.cpp
+ *
+ * Connects a stand-in worker agent that advertises its tools the way VerifyWorker does (lowercase toolkit names)
+ * and checks that the server reserves it for a tool named in any case, and not for a tool it lacks.
+ * Usage: remoteTest [port]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+#include "Remote.h"
+
+namespace {
+
+bool check(const std::string& name, bool ok) {
+  std::cout << name << ": " << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+}
+
+int main(int argc, char** argv) {
+  int port = (argc > 1 ? std::atoi(argv[1]) : 16090 + getpid() % 1000);
+  const std::string secret = "remoteTest";
+  Remote::WorkerPool& pool = Remote::WorkerPool::instance();
+  pool.listen("127.0.0.1", port, secret);
+  int agent = Remote::connect_to("127.0.0.1", port);
+  Remote::write_message(agent, "HELLO", secret + "\n2 1024\ndivine\ncbmc\n");
+  for (int i = 0; i < 500 && pool.size() == 0; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  bool passed = check("agent connected", pool.size() == 1);
+  passed &= check("mixed-case tool", static_cast<bool>(pool.reserve("DIVINE", 1, 0)));
+  passed &= check("lowercase tool", static_cast<bool>(pool.reserve("cbmc", 1, 0)));
+  passed &= check("missing tool", !pool.reserve("Symbiotic", 1, 0));
+  close(agent);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,2 +1,2 @@
 #!/bin/bash
-while true; do sudo ./VerifyServer; echo -n "Crashed" >> info.txt; date >> info.txt; done
+while true; do sudo ./VerifyServer --supervisor=./supervisor.sock; echo -n "Crashed" >> info.txt; date >> info.txt; done
@@ -0,0 +1,118 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   solverPoolTest.cpp
+ *
+ * Answers SMT-LIB inputs that each set their logic and options with one session process of a stand-in solver
+ * that is as strict as z3: a second (set-logic) or a late (set-option :produce-models) is an error unless
+ * the session was reset in between. Every warm answer has to be the answer of a cold run.
+ * Then checks that a full pool turns a run away rather than starting another process, and that idle
+ * session processes are retired.
+ * Usage: solverPoolTest
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "SolverPool.h"
+
+namespace {
+
+namespace filesystem = std::experimental::filesystem;
+using Basics::String;
+
+const char* const standIn =
+  "logic=''; models=''; started=''\n"
+  "while IFS= read -r line; do\n"
+  "  case \"$line\" in\n"
+  "    '(set-logic '*) if [ -n \"$logic\" ]; then echo '(error \"the logic has already been set\")'; else logic=$line; fi ;;\n"
+  "    '(set-option :produce-models true)') if [ -n \"$started\" ]; then echo '(error \"cannot be modified after initialization\")'; else models=1; fi ;;\n"
+  "    '(assert '*) started=1 ;;\n"
+  "    '(check-sat)') started=1; if [ -n \"$logic\" ]; then echo sat; else echo '(error \"no logic\")'; fi ;;\n"
+  "    '(check-sat-using '*) sleep 1; echo sat ;;\n"
+  "    '(get-model)') if [ -n \"$models\" ]; then echo '(model)'; else echo '(error \"model generation not enabled\")'; fi ;;\n"
+  "    '(reset)') logic=''; models=''; started='' ;;\n"
+  "    '(echo \"'*) text=${line#(echo \\\"}; echo \"${text%\\\")}\" ;;\n"
+  "  esac\n"
+  "done\n";
+
+const char* const expected = "sat\n(model)\n";
+
+String read(const String& file) {
+  std::ifstream stream(file);
+  return String(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+Launcher::Process submit(const String& tool, const String& command, const ToolKit::SessionSettings& settings,
+                         const String& input, const String& content) {
+  std::ofstream(input) << content;
+  Launcher::Request request;
+  request.workingDirectory = filesystem::path(input).parent_path().string();
+  request.outFileName = input + ".out";
+  request.errFileName = input + ".err";
+  return SolverPool::Pool::instance().submit(tool, command, settings, {input}, request);
+}
+
+void wait_for(Launcher::Process& process) {
+  while (process.poll() == -2)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+bool check(const String& name, bool ok) {
+  std::cout << name << ": " << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+}
+
+int main() {
+  filesystem::path directory = filesystem::temp_directory_path() / ("solverPoolTest-" + std::to_string(getpid()));
+  filesystem::create_directories(directory);
+  std::ofstream(directory / "standIn.sh") << standIn;
+  ToolKit::SessionSettings settings;
+  settings.protocol = "smtlib";
+  String command = "/bin/sh " + (directory / "standIn.sh").string();
+
+  bool passed = true;
+  pid_t session = -1;
+  for (const char* logic : {"QF_LIA", "QF_BV"}) {
+    String input = (directory / (String(logic) + ".smt2")).string();
+    Launcher::Process process = submit("standIn", command, settings, input, "(set-logic " + String(logic) + ")\n"
+                                       "(set-option :produce-models true)\n(assert true)\n(check-sat)\n(get-model)\n");
+    wait_for(process);
+    String output = read(input + ".out");
+    bool warm = (session < 0 || process.pid() == session);
+    session = process.pid();
+    if (!check(logic, output == expected && warm)) {
+      std::cout << "  expected the answer of a cold run in the same session, got (session " << process.pid() << "):\n" << output;
+      passed = false;
+    }
+  }
+
+  ToolKit::SessionSettings capped = settings;
+  capped.maxProcesses = 1;
+  capped.idleTimeout = 0;
+  String slow = "(set-logic QF_LIA)\n(check-sat-using smt)\n";
+  Launcher::Process busy = submit("capped", command, capped, (directory / "busy.smt2").string(), slow);
+  Launcher::Process turnedAway = submit("capped", command, capped, (directory / "turnedAway.smt2").string(), slow);
+  passed &= check("full pool turns a run away", busy.pid() > 0 && turnedAway.pid() == -1);
+  wait_for(busy);
+  SolverPool::Pool::instance().retire_idle();
+  Launcher::Process fresh = submit("capped", command, capped, (directory / "fresh.smt2").string(), slow);
+  passed &= check("idle session retired", fresh.pid() > 0 && fresh.pid() != busy.pid());
+  wait_for(fresh);
+  filesystem::remove_all(directory);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
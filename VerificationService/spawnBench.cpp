@@ -0,0 +1,120 @@
+//+*****************************************************************************
+//                         Honeywell Proprietary
+// This document and all information and expression contained herein are the
+// property of Honeywell International Inc., are loaned in confidence, and
+// may not, in whole or in part, be used, duplicated or disclosed for any
+// purpose without prior written permission of Honeywell International Inc.
+//               This document is an unpublished work.
+//
+// Copyright (C) 2026 Honeywell International Inc. All rights reserved.
+//+*****************************************************************************
+/*
+ * File:   spawnBench.cpp
+ *
+ * Spawn rate of the Launcher and the Zygote against subprocess::Popen (fork + exec).
+ * Usage: spawnBench [spawns] [ballast MB] [threads]
+ * The ballast is touched memory that makes the parent as large as a busy server; the cost of fork grows
+ * with it, the cost of the Launcher and the Zygote should not.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <experimental/filesystem>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Launcher.h"
+#include "Zygote.h"
+#include "subprocess.hpp"
+
+namespace {
+
+const char* const command = "/bin/true";
+
+Launcher::Request make_request(const std::string& directory) {
+  Launcher::Request request;
+  request.command = command;
+  request.workingDirectory = directory;
+  request.outFileName = directory + "/spawnBench-out";
+  request.errFileName = directory + "/spawnBench-err";
+  return request;
+}
+
+void wait_for(Launcher::Process& process) {
+  while (process.poll() == -2)
+    std::this_thread::yield();
+}
+
+void spawn_with_launcher(const std::string& directory) {
+  Launcher::Process process = Launcher::spawn(make_request(directory));
+  wait_for(process);
+}
+
+void spawn_with_zygote(const std::string& directory) {
+  Launcher::Process process = Zygote::Zygote::instance()->spawn(make_request(directory));
+  wait_for(process);
+}
+
+void spawn_with_popen(const std::string& directory) {
+  std::string outFileName = directory + "/spawnBench-out";
+  std::string errFileName = directory + "/spawnBench-err";
+  subprocess::Popen process(command, subprocess::cwd{directory},
+                            subprocess::output{outFileName.c_str()}, subprocess::error{errFileName.c_str()});
+  process.wait();
+}
+
+/// Spawns per second
+double measure(const std::function<void(const std::string&)>& spawn, unsigned spawns, unsigned threads, const std::string& directory) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++)
+    workers.emplace_back([&, t] () {
+        std::string workerDirectory = directory + "/spawnBench-" + std::to_string(t);
+        for (unsigned i = t; i < spawns; i += threads)
+          spawn(workerDirectory);
+      });
+  for (std::thread& worker : workers)
+    worker.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return spawns / elapsed.count();
+}
+
+}
+
+int main(int argc, char** argv) {
+  unsigned spawns = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000);
+  size_t ballastMB = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0);
+  unsigned threads = (argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1);
+  if (spawns == 0 || threads == 0) {
+    std::cerr << "Usage: " << argv[0] << " [spawns] [ballast MB] [threads]\n";
+    return 1;
+  }
+
+  Zygote::Zygote::start(); // Before the ballast, as the server starts it before it grows
+
+  std::vector<char> ballast(ballastMB << 20);
+  std::memset(ballast.data(), 1, ballast.size()); // Resident, so fork has to copy its page tables
+
+  std::string directory = "/tmp";
+  for (unsigned t = 0; t < threads; t++)
+    std::experimental::filesystem::create_directories(directory + "/spawnBench-" + std::to_string(t));
+
+  std::cout << "Spawning " << command << " " << spawns << " times from " << threads << " thread(s) with "
+            << ballastMB << " MB of ballast\n";
+  try {
+    double launcher = measure(spawn_with_launcher, spawns, threads, directory);
+    double zygote = measure(spawn_with_zygote, spawns, threads, directory);
+    double popen = measure(spawn_with_popen, spawns, threads, directory);
+    std::cout << "Launcher: " << launcher << " spawns/s (" << launcher / popen << "x)\n"
+              << "Zygote:   " << zygote << " spawns/s (" << zygote / popen << "x)\n"
+              << "Popen:    " << popen << " spawns/s\n";
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}